@@ -9,30 +9,50 @@
 #include "arithmcodec.h"
 #include "arithmdecoder.h"
 #include "arithmencoder.h"
+#include "pipeline.h"
+#include "fdstream.h"
 
 #include <iostream>
 #include <map>
 #include <string>
 #include <vector>
-#include <fstream>
 #include <limits>
 #include <stdexcept>
 
 const unsigned int NUM_SYMBOLS = std::numeric_limits<unsigned char>::max() + 2;		// 0..255 + 1 for ending symbol
 
+/// Data models, stored in low 4 bits of third header byte
+enum ModelType
+{
+	MODEL_ADAPTIVE = 0,
+	MODEL_STATIC = 1,
+	MODEL_POWER_OF_TWO = 2,
+	MODEL_SEMI_ADAPTIVE = 3
+};
+
+/// Interval precision (ArithmeticPrecision) is stored in high 4 bits of third header byte
+const unsigned PRECISION_SHIFT = 4;
+
 void printUsage() {
-	std::cout << "ac [-s] INPUT OUTPUT\n"
-		<< "ac -d INPUT OUTPUT\n\n"
+	std::cout << "ac [-s|-f|-m] [-w] [-p] INPUT OUTPUT\n"
+		<< "ac -d [-p] INPUT OUTPUT\n\n"
+		<< "INPUT or OUTPUT can be - for standard input or output\n\n"
 		<< "    -s    Use static instead of adaptive data model\n"
-		<< "    -d    Decompression instead compression\n";
+		<< "    -f    Use adaptive data model with power of two total frequency, faster coding\n"
+		<< "    -m    Use semi-adaptive data model, rebuilt periodically from symbol counts\n"
+		<< "    -w    Use 64bit interval instead of 32bit one\n"
+		<< "    -d    Decompression instead compression\n"
+		<< "    -p    Pipelined mode, read and write in background threads\n";
 }
 
-void compressAdaptive(std::istream& in, std::ostream& out) {
-	const char* header = "AC\x00";
-	out.write(header, 3);
+/// Total frequency bits of power of two data model, wider interval allows finer frequencies
+unsigned powerOfTwoTotalBits(ArithmeticPrecision precision) {
+	return precision == AC_PRECISION_64 ? 24 : 16;
+}
 
-	ArithmeticEncoder encoder(std::make_shared<BitStreamWriter>(&out));
-	AdaptiveDataModel dataModel(NUM_SYMBOLS);
+template <size_t N>
+void compressAdaptive(std::istream& in, std::ostream& out, DataModel& dataModel) {
+	BasicArithmeticEncoder<N> encoder(std::make_shared<BitStreamWriter>(&out));
 	for (;;) {
 		int c = in.get();
 		if (c == std::char_traits<char>::eof()) {
@@ -44,10 +64,8 @@ void compressAdaptive(std::istream& in, std::ostream& out) {
 	}
 }
 
+template <size_t N>
 void compressStaticly(std::istream& in, std::ostream& out) {
-	const char* header = "AC\x01";
-	out.write(header, 3);
-
 	std::vector<unsigned> freqs(NUM_SYMBOLS);
 	std::vector<unsigned char> data;
 
@@ -64,7 +82,7 @@ void compressStaticly(std::istream& in, std::ostream& out) {
 		out.write(reinterpret_cast<const char*>(&freq), sizeof(freq));
 	}
 
-	ArithmeticEncoder encoder(std::make_shared<BitStreamWriter>(&out));
+	BasicArithmeticEncoder<N> encoder(std::make_shared<BitStreamWriter>(&out));
 	StaticDataModel dataModel(freqs);
 	for (auto c : data) {
 		encoder.encode(c, &dataModel);
@@ -72,9 +90,9 @@ void compressStaticly(std::istream& in, std::ostream& out) {
 	encoder.encode(NUM_SYMBOLS - 1, &dataModel);	// encode last symbol
 }
 
-void decompressAdaptive(std::istream& in, std::ostream& out) {
-	AdaptiveDataModel dataModel(NUM_SYMBOLS);
-	ArithmeticDecoder decoder(std::make_shared<BitStreamReader>(&in));
+template <size_t N>
+void decompressAdaptive(std::istream& in, std::ostream& out, DataModel& dataModel) {
+	BasicArithmeticDecoder<N> decoder(std::make_shared<BitStreamReader>(&in));
 	for (;;) {
 		auto symbol = decoder.decode(&dataModel);
 
@@ -89,6 +107,7 @@ void decompressAdaptive(std::istream& in, std::ostream& out) {
 	}
 }
 
+template <size_t N>
 void decompressStaticly(std::istream& in, std::ostream& out) {
 	// read frequencies that we need to for static data model
 	std::vector<unsigned> freqs(NUM_SYMBOLS);
@@ -97,18 +116,41 @@ void decompressStaticly(std::istream& in, std::ostream& out) {
 	}
 
 	StaticDataModel dataModel(freqs);
-	ArithmeticDecoder decoder(std::make_shared<BitStreamReader>(&in));
-	for (;;) {
-		auto symbol = decoder.decode(&dataModel);
+	decompressAdaptive<N>(in, out, dataModel);
+}
 
-		if (symbol >= NUM_SYMBOLS)
-			throw std::runtime_error("Read bad symbol value. Symbols are expected to be 1 byte long.");
+template <size_t N>
+void compress(std::istream& in, std::ostream& out, ModelType model, ArithmeticPrecision precision) {
+	const char header[3] = { 'A', 'C', static_cast<char>(model | (precision << PRECISION_SHIFT)) };
+	out.write(header, 3);
 
-		// on ending symbol exit loop
-		if (symbol == NUM_SYMBOLS - 1)
-			break;
+	if (model == MODEL_STATIC) {
+		compressStaticly<N>(in, out);
+	} else if (model == MODEL_POWER_OF_TWO) {
+		PowerOfTwoDataModel dataModel(NUM_SYMBOLS, powerOfTwoTotalBits(precision));
+		compressAdaptive<N>(in, out, dataModel);
+	} else if (model == MODEL_SEMI_ADAPTIVE) {
+		SemiAdaptiveDataModel dataModel(NUM_SYMBOLS);
+		compressAdaptive<N>(in, out, dataModel);
+	} else {
+		AdaptiveDataModel dataModel(NUM_SYMBOLS);
+		compressAdaptive<N>(in, out, dataModel);
+	}
+}
 
-		out << static_cast<char>(symbol);
+template <size_t N>
+void decompress(std::istream& in, std::ostream& out, ModelType model, ArithmeticPrecision precision) {
+	if (model == MODEL_STATIC) {
+		decompressStaticly<N>(in, out);
+	} else if (model == MODEL_POWER_OF_TWO) {
+		PowerOfTwoDataModel dataModel(NUM_SYMBOLS, powerOfTwoTotalBits(precision));
+		decompressAdaptive<N>(in, out, dataModel);
+	} else if (model == MODEL_SEMI_ADAPTIVE) {
+		SemiAdaptiveDataModel dataModel(NUM_SYMBOLS);
+		decompressAdaptive<N>(in, out, dataModel);
+	} else {
+		AdaptiveDataModel dataModel(NUM_SYMBOLS);
+		decompressAdaptive<N>(in, out, dataModel);
 	}
 }
 
@@ -118,18 +160,42 @@ void decompress(std::istream& in, std::ostream& out) {
 	if (header[0] != 'A' || header[1] != 'C')
 		throw std::runtime_error("Bad input header magic string.");
 
-	if (header[2] == '\x00')
-		decompressAdaptive(in, out);
-	else if (header[2] == '\x01')
-		decompressStaticly(in, out);
+	auto model = static_cast<unsigned char>(header[2]) & ((1U << PRECISION_SHIFT) - 1);
+	auto precision = static_cast<unsigned char>(header[2]) >> PRECISION_SHIFT;
+	if (model > MODEL_SEMI_ADAPTIVE)
+		throw std::runtime_error("Invalid header value.");
+
+	if (precision == AC_PRECISION_32)
+		decompress<sizeof(uint32_t)>(in, out, static_cast<ModelType>(model), AC_PRECISION_32);
+	else if (precision == AC_PRECISION_64)
+		decompress<sizeof(uint64_t)>(in, out, static_cast<ModelType>(model), AC_PRECISION_64);
 	else
 		throw std::runtime_error("Invalid header value.");
 }
 
+void run(std::istream& in, std::ostream& out, OptionsMap& options) {
+	if (options["d"].isPresent) {
+		decompress(in, out);
+	} else {
+		ModelType model = MODEL_ADAPTIVE;
+		if (options["s"].isPresent)
+			model = MODEL_STATIC;
+		else if (options["f"].isPresent)
+			model = MODEL_POWER_OF_TWO;
+		else if (options["m"].isPresent)
+			model = MODEL_SEMI_ADAPTIVE;
+
+		if (options["w"].isPresent)
+			compress<sizeof(uint64_t)>(in, out, model, AC_PRECISION_64);
+		else
+			compress<sizeof(uint32_t)>(in, out, model, AC_PRECISION_32);
+	}
+}
+
 int main(int argc, char* argv[]) {
 	std::string input, output;
 	OptionsMap options = create_map<OptionsMap::key_type, OptionsMap::mapped_type>
-		("d", Option())("s", Option());
+		("d", Option())("s", Option())("f", Option())("w", Option())("m", Option())("p", Option());
 	try {
 		auto lefovers = parseCmdline(argc, argv, options);
 		if (lefovers.size() != 2)
@@ -142,27 +208,28 @@ int main(int argc, char* argv[]) {
 		return 2;
 	}
 
-	std::ifstream ifile(input.c_str(), std::ios_base::binary);
-	if (!ifile) {
+	auto ifile = openInputStream(input);
+	if (!*ifile) {
 		std::cerr << "Error: Unable to open input file: " << input << std::endl;
 		return 1;
 	}
 
-	std::ofstream ofile(output.c_str(), std::ios_base::binary);
-	if (!ofile) {
+	auto ofile = openOutputStream(output);
+	if (!*ofile) {
 		std::cerr << "Error: Unable to open output file: " << output << std::endl;
 		return 1;
 	}
 
 	try {
-		if (options["d"].isPresent) {
-			decompress(ifile, ofile);
-		} else {
-			if (options["s"].isPresent)
-				compressStaticly(ifile, ofile);
-			else
-				compressAdaptive(ifile, ofile);
-		}
+		if (options["p"].isPresent) {
+			IoPipeline pipeline(*ifile, *ofile);
+			run(pipeline.input(), pipeline.output(), options);
+			pipeline.finish();
+		} else
+			run(*ifile, *ofile, options);
+
+		if (!ofile->flush())
+			throw std::runtime_error("Unable to write output file: " + output);
 	} catch (std::exception& e) {
 		std::cerr << "Error: " << e.what() << std::endl;
 		return 1;
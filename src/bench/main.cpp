@@ -0,0 +1,234 @@
+/**
+ * @file main.cpp
+ *
+ * Measures coding speed of data models used by arithmetic coder
+ * and speed and ratio of LZW compression levels.
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "arithmcodec.h"
+#include "arithmdecoder.h"
+#include "arithmencoder.h"
+#include "lzwblock.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned BYTE_SYMBOLS = 257;
+const size_t SAMPLE_SIZE = 1 << 20;
+/// Bytes of input compressed by every level
+const size_t LEVEL_SAMPLE_SIZE = 16 << 20;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Result
+{
+	double encodeNs;		/// nanoseconds per symbol
+	double decodeNs;
+	size_t size;
+};
+
+/// Symbols with roughly geometric distribution, similar to text bytes
+std::vector<unsigned> syntheticSample(unsigned numSymbols, size_t count) {
+	std::vector<unsigned> symbols(count);
+	srand(1);
+	for (auto& symbol : symbols) {
+		double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+		symbol = static_cast<unsigned>(-std::log(u) * numSymbols / 16) % (numSymbols - 1);
+	}
+	return symbols;
+}
+
+std::vector<unsigned> fileSample(const char* path) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		throw std::runtime_error(std::string("Unable to open file: ") + path);
+
+	std::vector<unsigned> symbols;
+	int c;
+	while (symbols.size() < SAMPLE_SIZE && (c = in.get()) != std::char_traits<char>::eof())
+		symbols.push_back(static_cast<unsigned char>(c));
+	return symbols;
+}
+
+double nsPerSymbol(Clock::duration time, size_t count) {
+	return std::chrono::duration<double, std::nano>(time).count() / count;
+}
+
+template <size_t N, typename Model>
+Result measure(const std::vector<unsigned>& symbols, Model encodeModel, Model decodeModel) {
+	Result result;
+	std::ostringstream oss;
+
+	auto start = Clock::now();
+	{
+		BasicArithmeticEncoder<N> encoder(std::make_shared<BitStreamWriter>(&oss));
+		for (auto symbol : symbols)
+			encoder.encode(symbol, &encodeModel);
+		encoder.encode(static_cast<unsigned>(encodeModel.size() - 1), &encodeModel);
+	}
+	result.encodeNs = nsPerSymbol(Clock::now() - start, symbols.size());
+	result.size = oss.str().size();
+
+	std::istringstream iss(oss.str());
+	start = Clock::now();
+	BasicArithmeticDecoder<N> decoder(std::make_shared<BitStreamReader>(&iss));
+	for (auto symbol : symbols) {
+		if (decoder.decode(&decodeModel) != symbol)
+			throw std::runtime_error("Decoded symbol differs.");
+	}
+	result.decodeNs = nsPerSymbol(Clock::now() - start, symbols.size());
+	return result;
+}
+
+void printResult(const char* name, const Result& result) {
+	std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(12) << result.encodeNs << std::setw(12) << result.decodeNs
+		<< std::setw(12) << result.size << "\n";
+}
+
+void benchmark(const char* title, const std::vector<unsigned>& symbols, unsigned numSymbols, unsigned totalBits) {
+	// frequencies of static model are taken from whole sample
+	std::vector<unsigned> counts(numSymbols);
+	for (auto symbol : symbols)
+		counts[symbol]++;
+	counts.back() = 1;
+
+	std::cout << title << ", " << symbols.size() << " symbols of " << numSymbols << "\n"
+		<< std::left << std::setw(24) << "model" << std::right << std::setw(12) << "enc ns/sym"
+		<< std::setw(12) << "dec ns/sym" << std::setw(12) << "bytes" << "\n";
+	printResult("AdaptiveDataModel", measure<4>(symbols, AdaptiveDataModel(numSymbols), AdaptiveDataModel(numSymbols)));
+	printResult("PowerOfTwoDataModel", measure<4>(symbols,
+		PowerOfTwoDataModel(numSymbols, totalBits), PowerOfTwoDataModel(numSymbols, totalBits)));
+	printResult("StaticDataModel", measure<4>(symbols, StaticDataModel(counts), StaticDataModel(counts)));
+	printResult("SemiAdaptiveDataModel", measure<4>(symbols,
+		SemiAdaptiveDataModel(numSymbols), SemiAdaptiveDataModel(numSymbols)));
+	printResult("AdaptiveDataModel 64", measure<8>(symbols, AdaptiveDataModel(numSymbols), AdaptiveDataModel(numSymbols)));
+	printResult("PowerOfTwoDataModel 64", measure<8>(symbols,
+		PowerOfTwoDataModel(numSymbols, totalBits), PowerOfTwoDataModel(numSymbols, totalBits)));
+	std::cout << "\n";
+}
+
+/// Words with roughly geometric frequencies separated by spaces and line breaks
+std::string syntheticText(size_t size) {
+	const unsigned WORDS = 4096;
+	std::vector<std::string> words(WORDS);
+	srand(1);
+	for (auto& word : words) {
+		word.resize(2 + rand() % 8);
+		for (auto& c : word)
+			c = static_cast<char>('a' + rand() % 26);
+	}
+
+	std::string text;
+	text.reserve(size + 16);
+	for (auto symbol : syntheticSample(WORDS, size / 4)) {
+		text += words[symbol];
+		text += rand() % 12 == 0 ? '\n' : ' ';
+		if (text.size() >= size)
+			break;
+	}
+	text.resize(std::min(text.size(), size));
+	return text;
+}
+
+std::string fileText(const char* path, size_t size) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		throw std::runtime_error(std::string("Unable to open file: ") + path);
+
+	std::string text(size, '\0');
+	in.read(&text[0], static_cast<std::streamsize>(size));
+	text.resize(static_cast<size_t>(in.gcount()));
+	return text;
+}
+
+double mibPerSecond(Clock::duration time, size_t size) {
+	return size / std::chrono::duration<double>(time).count() / (1 << 20);
+}
+
+/// Prints table of levels in format of lzwLevel documentation
+void benchmarkLevels(const char* title, const std::string& data) {
+	std::cout << title << ", " << data.size() << " bytes\n"
+		<< "| level | method             | block     | reset width | threads | dedup     | compress    | decompress   | ratio |\n"
+		<< "|-------|--------------------|-----------|-------------|---------|-----------|-------------|--------------|-------|\n";
+	for (int level = LzwLevel::MIN; level <= LzwLevel::MAX; ++level) {
+		auto& settings = lzwLevel(level);
+		std::ostringstream coded;
+
+		auto start = Clock::now();
+		{
+			LzwBlockWriter writer(&coded, settings);
+			writer.write(data.data(), data.size());
+			writer.close();
+		}
+		auto compressSpeed = mibPerSecond(Clock::now() - start, data.size());
+
+		std::istringstream iss(coded.str());
+		std::ostringstream decoded;
+		start = Clock::now();
+		decompressLzwStream(iss, decoded);
+		auto decompressSpeed = mibPerSecond(Clock::now() - start, data.size());
+		if (decoded.str() != data)
+			throw std::runtime_error("Decoded data differ.");
+
+		std::ostringstream block;
+		block << (settings.blockSize >> 10) << " KiB";
+		std::ostringstream dedup;
+		if (settings.dedupWindow != 0)
+			dedup << (settings.dedupWindow >> 20) << " MiB";
+		else
+			dedup << "-";
+		const char* methods[] = { "variable", "arithmetic", "huffman", "bittree", "arithmetic-pow2",
+			"arithmetic-64", "arithmetic-pow2-64" };
+		std::cout << std::fixed << std::setprecision(1)
+			<< "| " << std::left << std::setw(5) << level
+			<< " | " << std::setw(18) << (settings.method == LZW_METHOD_AUTO ? "auto" : methods[settings.method])
+			<< " | " << std::setw(9) << block.str()
+			<< " | " << std::setw(11) << settings.resetWidth
+			<< " | " << std::setw(7) << settings.threads
+			<< " | " << std::setw(9) << dedup.str() << std::right
+			<< " | " << std::setw(5) << compressSpeed << " MiB/s"
+			<< " | " << std::setw(6) << decompressSpeed << " MiB/s"
+			<< " | " << std::setprecision(3) << std::setw(5)
+			<< static_cast<double>(coded.str().size()) / data.size() << " |\n";
+	}
+	std::cout << "\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+	try {
+		if (argc > 1 && std::strcmp(argv[1], "--levels") == 0) {
+			if (argc > 2)
+				benchmarkLevels(argv[2], fileText(argv[2], LEVEL_SAMPLE_SIZE));
+			else
+				benchmarkLevels("synthetic text", syntheticText(LEVEL_SAMPLE_SIZE));
+		} else if (argc > 1) {
+			benchmark(argv[1], fileSample(argv[1]), BYTE_SYMBOLS, 16);
+		} else {
+			benchmark("bytes", syntheticSample(BYTE_SYMBOLS, SAMPLE_SIZE), BYTE_SYMBOLS, 16);
+			// update of AdaptiveDataModel is linear in alphabet size, so large alphabet gets smaller sample
+			benchmark("12 bit LZW codes", syntheticSample(1 << 12, SAMPLE_SIZE / 8), 1 << 12, 20);
+		}
+	} catch (std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -21,7 +21,117 @@ void StaticDataModel::computeCumulativeFreqs(const std::vector<unsigned>& freqs)
 					f /= 2;
 			}
 			computeCumulativeFreqs(newFreqs);
-			break;
+			return;
 		}
 	}
+
+	lookup.build(cumulativeFreqs);
+}
+
+const unsigned SymbolLookupTable::MIN_TABLE_BITS;
+const unsigned SymbolLookupTable::MAX_TABLE_BITS;
+
+void SymbolLookupTable::build(const std::vector<unsigned>& cumulativeFreqs) {
+	if (cumulativeFreqs.empty() || cumulativeFreqs.back() == 0) {
+		table.assign(1, 0);
+		shift = 0;
+		return;
+	}
+
+	// about one bucket per symbol so scans are short
+	unsigned tableBits = MIN_TABLE_BITS;
+	while (tableBits < MAX_TABLE_BITS && (1U << tableBits) < cumulativeFreqs.size())
+		tableBits++;
+
+	unsigned total = cumulativeFreqs.back();
+	shift = 0;
+	while (((total - 1) >> shift) >= (1U << tableBits))
+		shift++;
+
+	table.resize(((total - 1) >> shift) + 1);
+	unsigned symbol = 0;
+	for (size_t bucket = 0; bucket < table.size(); ++bucket) {
+		auto bucketStart = static_cast<unsigned>(bucket << shift);
+		while (cumulativeFreqs[symbol] <= bucketStart)
+			symbol++;
+		table[bucket] = symbol;
+	}
+}
+
+const size_t SemiAdaptiveDataModel::DEFAULT_REBUILD_INTERVAL;
+const size_t SemiAdaptiveDataModel::MIN_REBUILD_INTERVAL;
+
+SemiAdaptiveDataModel::SemiAdaptiveDataModel(std::size_t numSymbols, std::size_t rebuildInterval)
+	: counts(numSymbols), maxInterval(std::max(rebuildInterval, MIN_REBUILD_INTERVAL)) {
+	reset();
+}
+
+void SemiAdaptiveDataModel::reset() {
+	std::fill(counts.begin(), counts.end(), 1);
+	interval = MIN_REBUILD_INTERVAL;
+	rebuild();
+}
+
+void SemiAdaptiveDataModel::rebuild() {
+	// counts are kept in range where their sum doesn't overflow, older statistics fade out
+	if (cumulativeFreqs.size() == counts.size() && cumulativeFreqs.back() > MAX_FREQ / 2) {
+		for (auto& count : counts)
+			count = (count + 1) / 2;
+	}
+	computeCumulativeFreqs(counts);
+
+	untilRebuild = interval;
+	interval = std::min(interval * 2, maxInterval);
+}
+
+const uint32_t PowerOfTwoDataModel::COUNT_INCREMENT;
+const uint64_t PowerOfTwoDataModel::MAX_TOTAL_COUNT;
+const size_t PowerOfTwoDataModel::MIN_RESCALE_INTERVAL;
+
+PowerOfTwoDataModel::PowerOfTwoDataModel(std::size_t numSymbols, unsigned totalBits)
+	: counts(numSymbols), cumulativeFreqs(numSymbols), bits(totalBits),
+	// recomputation is linear in alphabet size, large alphabets are recomputed less often but still
+	// often enough to follow changing statistics of LZW codes
+	maxRescaleInterval(std::max<std::size_t>(numSymbols / 64, 1024)) {
+	assert(numSymbols > 0 && numSymbols < (1U << totalBits));
+	reset();
+}
+
+void PowerOfTwoDataModel::reset() {
+	std::fill(counts.begin(), counts.end(), 1);
+	totalCount = counts.size();
+	rescaleInterval = MIN_RESCALE_INTERVAL;
+	rescale();
+}
+
+void PowerOfTwoDataModel::rescale() {
+	if (totalCount > MAX_TOTAL_COUNT) {
+		totalCount = 0;
+		for (auto& count : counts) {
+			count = (count + 1) / 2;
+			totalCount += count;
+		}
+	}
+
+	// every symbol gets at least 1, the rest is split by counts
+	uint64_t total = uint64_t(1) << bits;
+	uint64_t spare = total - counts.size();
+	// fixed point reciprocal of total count, so loop doesn't divide
+	uint64_t factor = (spare << 32) / totalCount;
+	unsigned cumulative = 0;
+	size_t mostFrequent = 0;
+	for (size_t i = 0; i < counts.size(); ++i) {
+		cumulative += static_cast<unsigned>(1 + ((counts[i] * factor) >> 32));
+		cumulativeFreqs[i] = cumulative;
+		if (counts[i] > counts[mostFrequent])
+			mostFrequent = i;
+	}
+
+	// rounding remainder goes to most frequent symbol so total is exact
+	unsigned remainder = static_cast<unsigned>(total - cumulative);
+	for (size_t i = mostFrequent; i < counts.size(); ++i)
+		cumulativeFreqs[i] += remainder;
+
+	untilRescale = rescaleInterval;
+	rescaleInterval = std::min(rescaleInterval * 2, maxRescaleInterval);
 }
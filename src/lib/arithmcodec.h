@@ -20,10 +20,76 @@ class DataModel
 public:
 	static const uint32_t MAX_FREQ = (1U << 29) - 1U;
 
-	~DataModel() {}
+	virtual ~DataModel() {}
 
 	virtual unsigned getCumulativeFreq(unsigned symbol) const = 0;
 	virtual std::size_t size() const = 0;
+
+	/**
+	 * Total frequency is 1 << totalBits() when model keeps it at power of two,
+	 * coders then scale interval by shift instead of division.
+	 * @return number of bits of total frequency or 0 when total is arbitrary
+	 */
+	virtual unsigned totalBits() const {
+		return 0;
+	}
+
+	/**
+	 * Finds symbol i where cumFreq(i-1) <= cumulativeFreq < cumFreq(i).
+	 */
+	virtual unsigned findSymbol(unsigned cumulativeFreq) const {
+		for (size_t i = 0; i < size(); ++i) {
+			auto lowerBound = i != 0 ? getCumulativeFreq(i - 1) : 0U;
+			auto upperBound = getCumulativeFreq(i);
+			if (lowerBound <= cumulativeFreq && cumulativeFreq < upperBound)
+				return i;
+		}
+		return 0;
+	}
+
+	/**
+	 * Updates model after symbol was coded, static models do nothing.
+	 */
+	virtual void update(unsigned) { }
+
+	/**
+	 * Resets model to initial state.
+	 */
+	virtual void reset() { }
+};
+
+/**
+ * Lookup table from cumulative frequency to symbol.
+ * Cumulative frequencies are split to buckets by their high bits and every bucket
+ * knows its first symbol, so symbol is found by one lookup and short forward scan.
+ */
+class SymbolLookupTable
+{
+public:
+	static const unsigned MIN_TABLE_BITS = 12;
+	static const unsigned MAX_TABLE_BITS = 16;
+
+	SymbolLookupTable() : shift(0) {}
+
+	/**
+	 * Builds table for cumulative frequencies, it has to be rebuilt when they change.
+	 */
+	void build(const std::vector<unsigned>& cumulativeFreqs);
+
+	/**
+	 * Finds symbol i where cumFreq(i-1) <= cumulativeFreq < cumFreq(i).
+	 * @param cumulativeFreqs the same frequencies table was built from
+	 */
+	unsigned find(const std::vector<unsigned>& cumulativeFreqs, unsigned cumulativeFreq) const {
+		assert((cumulativeFreq >> shift) < table.size());
+		unsigned symbol = table[cumulativeFreq >> shift];
+		while (cumulativeFreqs[symbol] <= cumulativeFreq)
+			symbol++;
+		return symbol;
+	}
+private:
+	std::vector<unsigned> table;	/// first symbol of every bucket
+	unsigned shift;					/// cumulative frequency >> shift is bucket index
 };
 
 /**
@@ -64,10 +130,16 @@ public:
 	virtual std::size_t size() const {
 		return cumulativeFreqs.size();
 	}
+
+	virtual unsigned findSymbol(unsigned cumulativeFreq) const {
+		return lookup.find(cumulativeFreqs, cumulativeFreq);
+	}
 protected:
+	/// Computes cumulative frequencies and rebuilds lookup table
 	void computeCumulativeFreqs(const std::vector<unsigned>& freqs);
 
 	std::vector<unsigned> cumulativeFreqs;
+	SymbolLookupTable lookup;
 };
 
 /**
@@ -103,6 +175,16 @@ public:
 		std::generate(cumulativeFreqs.begin(), cumulativeFreqs.end(), [&counter] () { return counter++; });
 	}
 
+	/// Frequencies change with every symbol so lookup table is not used
+	virtual unsigned findSymbol(unsigned cumulativeFreq) const {
+		return static_cast<unsigned>(std::upper_bound(cumulativeFreqs.begin(), cumulativeFreqs.end(), cumulativeFreq)
+			- cumulativeFreqs.begin());
+	}
+
+	virtual void update(unsigned symbol) {
+		incSymbolFreq(symbol);
+	}
+
 	/**
 	 * Add frequency to symbol.
 	 * @param symbol symbol position in frequencies table
@@ -131,6 +213,104 @@ public:
 	}
 };
 
+/**
+ * Semi-adaptive data model.
+ * Symbol counts are collected online, but frequencies used for coding are static between
+ * rebuilds. Rebuild period starts short so model learns quickly and doubles up to maximum,
+ * so decoding mostly runs at speed of static model with its lookup table.
+ */
+class SemiAdaptiveDataModel : public StaticDataModel
+{
+public:
+	static const size_t DEFAULT_REBUILD_INTERVAL = 4096;
+
+	/**
+	 * Creates new data model with all symbols equally probable.
+	 * @param numSymbols number of symbols
+	 * @param rebuildInterval maximum number of symbols between rebuilds
+	 */
+	explicit SemiAdaptiveDataModel(std::size_t numSymbols, std::size_t rebuildInterval = DEFAULT_REBUILD_INTERVAL);
+
+	virtual void update(unsigned symbol) {
+		counts[symbol]++;
+		if (--untilRebuild == 0)
+			rebuild();
+	}
+
+	virtual void reset();
+private:
+	static const size_t MIN_REBUILD_INTERVAL = 32;
+
+	/// Computes frequencies from counts collected so far
+	void rebuild();
+
+	std::vector<unsigned> counts;
+	std::size_t interval;
+	std::size_t maxInterval;
+	std::size_t untilRebuild;
+};
+
+/**
+ * Adaptive data model with total frequency kept at power of two.
+ * Symbol counts are updated online, but coding uses frequencies quantized so that
+ * they sum to exactly 1 << totalBits. Quantized frequencies are recomputed
+ * periodically, first often so model adapts quickly and then less often
+ * so recomputation cost is spread over many symbols.
+ */
+class PowerOfTwoDataModel : public DataModel
+{
+public:
+	/**
+	 * Creates new data model with all symbols equally probable.
+	 * @param numSymbols number of symbols
+	 * @param totalBits total frequency is 1 << totalBits, it has to be larger than numSymbols
+	 */
+	PowerOfTwoDataModel(std::size_t numSymbols, unsigned totalBits);
+
+	virtual unsigned getCumulativeFreq(unsigned symbol) const {
+		assert(symbol < cumulativeFreqs.size());
+		return cumulativeFreqs[symbol];
+	}
+
+	virtual std::size_t size() const {
+		return counts.size();
+	}
+
+	virtual unsigned totalBits() const {
+		return bits;
+	}
+
+	virtual unsigned findSymbol(unsigned cumulativeFreq) const {
+		return static_cast<unsigned>(std::upper_bound(cumulativeFreqs.begin(), cumulativeFreqs.end(), cumulativeFreq)
+			- cumulativeFreqs.begin());
+	}
+
+	virtual void update(unsigned symbol) {
+		counts[symbol] += COUNT_INCREMENT;
+		totalCount += COUNT_INCREMENT;
+		if (--untilRescale == 0)
+			rescale();
+	}
+
+	virtual void reset();
+private:
+	static const uint32_t COUNT_INCREMENT = 32;
+	/// Counts are halved when their total exceeds this
+	static const uint64_t MAX_TOTAL_COUNT = 1U << 28;
+	static const size_t MIN_RESCALE_INTERVAL = 32;
+
+	/// Recomputes quantized frequencies from counts
+	void rescale();
+
+	std::vector<uint32_t> counts;
+	std::vector<unsigned> cumulativeFreqs;
+	uint64_t totalCount;
+	unsigned bits;
+	std::size_t rescaleInterval;
+	std::size_t maxRescaleInterval;
+	std::size_t untilRescale;
+};
+
 template <size_t N>
 struct TypeWithSize
 {
@@ -143,6 +323,7 @@ struct TypeWithSize<4>
 {
 	typedef uint32_t Uint;
 	typedef int32_t Int;
+	typedef uint64_t WideUint;		/// holds product of two Uints
 };
 
 template <>
@@ -150,6 +331,7 @@ struct TypeWithSize<8>
 {
 	typedef uint64_t Uint;
 	typedef int64_t Int;
+	typedef unsigned __int128 WideUint;
 };
 
 inline bool getBit(unsigned value, size_t n) {
@@ -165,11 +347,13 @@ class IntervalTraits
 {
 public:
 	typedef typename TypeWithSize<N>::Uint ValueType;
+	/// Type for product of interval range and frequency
+	typedef typename TypeWithSize<N>::WideUint WideType;
 
 	/// Number of bits we use. -1 is because without it overflow could occur
 	static const size_t BITS = N * CHAR_BIT - 1;
 	/// Max interval value
-	static const ValueType MAX = (1U << BITS) - 1U;
+	static const ValueType MAX = (ValueType(1) << BITS) - 1U;
 	/// Quarter of maximum interval value
 	static const ValueType QUARTER = MAX / 4U + 1;
 	/// Half of maximum interval value
@@ -178,4 +362,19 @@ public:
 	static const ValueType THREE_QUARTERS = 3*QUARTER;
 };
 
+template <size_t N> const size_t IntervalTraits<N>::BITS;
+template <size_t N> const typename IntervalTraits<N>::ValueType IntervalTraits<N>::MAX;
+template <size_t N> const typename IntervalTraits<N>::ValueType IntervalTraits<N>::QUARTER;
+template <size_t N> const typename IntervalTraits<N>::ValueType IntervalTraits<N>::HALF;
+template <size_t N> const typename IntervalTraits<N>::ValueType IntervalTraits<N>::THREE_QUARTERS;
+
+/**
+ * Interval precision of arithmetic coder, stored in stream headers.
+ */
+enum ArithmeticPrecision
+{
+	AC_PRECISION_32 = 0,		///< 31 bit interval in 32 bit state
+	AC_PRECISION_64 = 1			///< 63 bit interval in 64 bit state, products use 128 bit multiply
+};
+
 #endif // !ARITHMCODEC_H
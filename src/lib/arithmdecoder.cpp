@@ -7,7 +7,8 @@
 
 #include "arithmdecoder.h"
 
-ArithmeticDecoder::ArithmeticDecoder(std::shared_ptr<BitStreamReader>& bsr) : bitStreamReader(bsr),
+template <size_t N>
+BasicArithmeticDecoder<N>::BasicArithmeticDecoder(std::shared_ptr<BitStreamReader> bsr) : bitStreamReader(bsr),
 	intervalLow(0), intervalHigh(IntervalTraitsType::MAX)  {
 		
 	// read first IntervalTraitsType::BITS from data to value
@@ -16,7 +17,8 @@ ArithmeticDecoder::ArithmeticDecoder(std::shared_ptr<BitStreamReader>& bsr) : bi
 		readBit();
 }
 
-void ArithmeticDecoder::reset() {
+template <size_t N>
+void BasicArithmeticDecoder<N>::reset() {
 	intervalLow = 0;
 	intervalHigh = IntervalTraitsType::MAX;
 
@@ -26,44 +28,48 @@ void ArithmeticDecoder::reset() {
 		readBit();
 }
 
-void ArithmeticDecoder::readBit() {
-	bool bit;
-	try {
-		bit = bitStreamReader->readBit();
-	} catch (std::exception&) {
-		bit = false;		// on data end we append zero bit
-	}
-
+template <size_t N>
+void BasicArithmeticDecoder<N>::readBit() {
+	// on data end we append zero bits
 	value <<= 1;
-	if (bit)
+	if (bitStreamReader->readBitPadded())
 		value += 1;
 }
 
-unsigned ArithmeticDecoder::decode(DataModel* dataModel) {
-	uint64_t range = intervalHigh - intervalLow + 1;
-	auto scale = dataModel->getCumulativeFreq(dataModel->size() - 1);
-	auto cumulativeFreq = ((value - intervalLow + 1) * scale - 1) / range;
-
-	unsigned symbol = 0;
-	// find i where cumuliveFreqs[i-1] < cumulativeFreq < cumulativeFreqs[i]
-	for (size_t i = 0; i < dataModel->size(); ++i) {
-		auto lowerBound = i != 0 ? dataModel->getCumulativeFreq(i - 1) : 0U;
-		auto upperBound = dataModel->getCumulativeFreq(i);
-		if (lowerBound <= cumulativeFreq && cumulativeFreq < upperBound) {
-			symbol = i;
-			break;
-		}
-	}
+template <size_t N>
+unsigned BasicArithmeticDecoder<N>::decode(DataModel* dataModel) {
+	ValueType range = intervalHigh - intervalLow + 1;
+	unsigned symbol;
+
+	if (auto bits = dataModel->totalBits()) {
+		// total frequency is power of two, interval is split to equal steps
+		// so only finding step of value needs division
+		auto step = range >> bits;
+		auto cumulativeFreq = (value - intervalLow) / step;
+		symbol = dataModel->findSymbol(static_cast<unsigned>(std::min<ValueType>(cumulativeFreq, (ValueType(1) << bits) - 1)));
+
+		// last symbol also takes rest of interval which steps don't cover
+		if (symbol + 1 != dataModel->size())
+			intervalHigh = intervalLow + step * dataModel->getCumulativeFreq(symbol) - 1;
+		if (symbol != 0)
+			intervalLow += step * dataModel->getCumulativeFreq(symbol - 1);
+	} else {
+		auto scale = dataModel->getCumulativeFreq(dataModel->size() - 1);
+		auto cumulativeFreq = (WideType(value - intervalLow + 1) * scale - 1) / range;
+
+		// find i where cumuliveFreqs[i-1] < cumulativeFreq < cumulativeFreqs[i]
+		symbol = dataModel->findSymbol(static_cast<unsigned>(cumulativeFreq));
 
-	// compute new interval bounds
+		// compute new interval bounds
 
-	// interval upper bound is
-	intervalHigh = intervalLow + (range * dataModel->getCumulativeFreq(symbol)) / scale - 1;
+		// interval upper bound is
+		intervalHigh = intervalLow + static_cast<ValueType>((WideType(range) * dataModel->getCumulativeFreq(symbol)) / scale) - 1;
 
-	// interval lower bound is computed as low + (r * cumFreq(i-1)) / s and cumFreq(-1) == 0 so
-	// if symbol == 0 then interval lower bound is not modified 
-	if (symbol != 0) {
-		intervalLow += (range * dataModel->getCumulativeFreq(symbol - 1)) / scale;
+		// interval lower bound is computed as low + (r * cumFreq(i-1)) / s and cumFreq(-1) == 0 so
+		// if symbol == 0 then interval lower bound is not modified 
+		if (symbol != 0) {
+			intervalLow += static_cast<ValueType>((WideType(range) * dataModel->getCumulativeFreq(symbol - 1)) / scale);
+		}
 	}
 
 	// enlarge interval and get bits from data
@@ -78,7 +84,7 @@ unsigned ArithmeticDecoder::decode(DataModel* dataModel) {
 			intervalHigh -= IntervalTraitsType::HALF;
 			value -= IntervalTraitsType::HALF;
 		// interval is in middle of possible range
-		} else if (intervalLow >= IntervalTraitsType::QUARTER && intervalHigh <= IntervalTraitsType::THREE_QUARTERS) {
+		} else if (intervalLow >= IntervalTraitsType::QUARTER && intervalHigh < IntervalTraitsType::THREE_QUARTERS) {
 			intervalLow -= IntervalTraitsType::QUARTER;
 			intervalHigh -= IntervalTraitsType::QUARTER;
 			value -= IntervalTraitsType::QUARTER;
@@ -92,9 +98,70 @@ unsigned ArithmeticDecoder::decode(DataModel* dataModel) {
 	}
 
 	// on adaptive data model we increase symbol frequency
-	auto adaptiveModel = dynamic_cast<AdaptiveDataModel*>(dataModel);
-	if (adaptiveModel != nullptr)
-		adaptiveModel->incSymbolFreq(symbol);
+	dataModel->update(symbol);
+
+	return symbol;
+}
+
+template class BasicArithmeticDecoder<sizeof(uint32_t)>;
+
+const uint64_t BasicArithmeticDecoder<sizeof(uint64_t)>::TOP;
+
+BasicArithmeticDecoder<sizeof(uint64_t)>::BasicArithmeticDecoder(std::shared_ptr<BitStreamReader> bsr)
+	: bitStreamReader(bsr) {
+	reset();
+}
+
+void BasicArithmeticDecoder<sizeof(uint64_t)>::reset() {
+	range = UINT64_MAX;
+	// first byte is always zero cache of encoder, it is shifted out by the others
+	code = 0;
+	for (size_t i = 0; i < sizeof(uint64_t) + 1; ++i)
+		code = (code << CHAR_BIT) | readByte();
+}
+
+uint8_t BasicArithmeticDecoder<sizeof(uint64_t)>::readByte() {
+	size_t byte;
+	if (bitStreamReader->readBits(CHAR_BIT, byte))
+		return static_cast<uint8_t>(byte);
+
+	// less than byte is left, the rest are padding bits
+	byte = 0;
+	for (unsigned i = 0; i < CHAR_BIT; ++i) {
+		if (bitStreamReader->readBitPadded())
+			byte |= size_t(1) << i;
+	}
+	return static_cast<uint8_t>(byte);
+}
+
+unsigned BasicArithmeticDecoder<sizeof(uint64_t)>::decode(DataModel* dataModel) {
+	unsigned symbol;
+	uint64_t step;
+	if (auto bits = dataModel->totalBits()) {
+		step = range >> bits;
+		symbol = dataModel->findSymbol(static_cast<unsigned>(std::min<uint64_t>(code / step, (uint64_t(1) << bits) - 1)));
+	} else {
+		uint64_t scale = dataModel->getCumulativeFreq(dataModel->size() - 1);
+		step = range / scale;
+		symbol = dataModel->findSymbol(static_cast<unsigned>(std::min<uint64_t>(code / step, scale - 1)));
+	}
+
+	uint64_t lowFreq = symbol != 0 ? dataModel->getCumulativeFreq(symbol - 1) : 0;
+	auto removed = step * lowFreq;
+	code -= removed;
+	// last symbol also takes rest of interval which steps don't cover
+	if (symbol + 1 != dataModel->size())
+		range = step * (dataModel->getCumulativeFreq(symbol) - lowFreq);
+	else
+		range -= removed;
+
+	while (range < TOP) {
+		range <<= CHAR_BIT;
+		code = (code << CHAR_BIT) | readByte();
+	}
+
+	// on adaptive data model we increase symbol frequency
+	dataModel->update(symbol);
 
 	return symbol;
-}
\ No newline at end of file
+}
@@ -13,28 +13,85 @@
 
 #include <memory>
 
-class ArithmeticDecoder
+/**
+ * Decoder for data written by BasicArithmeticEncoder with the same N.
+ */
+template <size_t N>
+class BasicArithmeticDecoder
 {
 public:
-	explicit ArithmeticDecoder(std::shared_ptr<BitStreamReader>& bsr);
+	explicit BasicArithmeticDecoder(std::shared_ptr<BitStreamReader> bsr);
 
 	void reset();
 
 	unsigned decode(DataModel* dataModel);
 
+	/**
+	 * True when decoder has read all its value bits past end of data,
+	 * so decoded symbols don't come from stream anymore (truncated stream).
+	 */
+	bool exhausted() const {
+		return bitStreamReader->paddingBits() > IntervalTraitsType::BITS;
+	}
+
 	std::shared_ptr<BitStreamReader> reader() {
 		return bitStreamReader;
 	}
 private:
-	typedef IntervalTraits<sizeof(uint32_t)> IntervalTraitsType;
+	typedef IntervalTraits<N> IntervalTraitsType;
+	typedef typename IntervalTraitsType::ValueType ValueType;
+	typedef typename IntervalTraitsType::WideType WideType;
 
 	void readBit();
 
 	std::shared_ptr<BitStreamReader> bitStreamReader;
 
-	uint64_t intervalLow;			/// lower interval bound
-	uint64_t intervalHigh;			/// upper interval bound
-	uint64_t value;
+	ValueType intervalLow;			/// lower interval bound
+	ValueType intervalHigh;			/// upper interval bound
+	ValueType value;
 };
 
+/**
+ * Decoder for data written by 64bit range coder BasicArithmeticEncoder, reads whole bytes.
+ */
+template <>
+class BasicArithmeticDecoder<sizeof(uint64_t)>
+{
+public:
+	explicit BasicArithmeticDecoder(std::shared_ptr<BitStreamReader> bsr);
+
+	void reset();
+
+	unsigned decode(DataModel* dataModel);
+
+	/**
+	 * True when decoder has read all its value bytes past end of data,
+	 * so decoded symbols don't come from stream anymore (truncated stream).
+	 */
+	bool exhausted() const {
+		return bitStreamReader->paddingBits() > sizeof(uint64_t) * CHAR_BIT;
+	}
+
+	std::shared_ptr<BitStreamReader> reader() {
+		return bitStreamReader;
+	}
+private:
+	static const uint64_t TOP = uint64_t(1) << 56;
+
+	/// Next byte of stream, zero bits are appended after its end
+	uint8_t readByte();
+
+	std::shared_ptr<BitStreamReader> bitStreamReader;
+
+	uint64_t range;			/// interval width
+	uint64_t code;			/// value of stream relative to interval low bound
+};
+
+/// 32bit arithmetic decoder
+typedef BasicArithmeticDecoder<sizeof(uint32_t)> ArithmeticDecoder;
+/// 64bit arithmetic decoder
+typedef BasicArithmeticDecoder<sizeof(uint64_t)> ArithmeticDecoder64;
+
+extern template class BasicArithmeticDecoder<sizeof(uint32_t)>;
+
 #endif // !ARITHMDECODER_H
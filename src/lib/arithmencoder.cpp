@@ -1,5 +1,5 @@
 /**
- * @file arithmencoder.h
+ * @file arithmencoder.cpp
  *
  * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
  * @date 2013
@@ -7,10 +7,12 @@
 
 #include "arithmencoder.h"
 
-ArithmeticEncoder::ArithmeticEncoder(std::shared_ptr<BitStreamWriter>& bsw) : bitStreamWriter(bsw), 
+template <size_t N>
+BasicArithmeticEncoder<N>::BasicArithmeticEncoder(std::shared_ptr<BitStreamWriter> bsw) : bitStreamWriter(bsw), 
 	intervalLow(0), intervalHigh(IntervalTraitsType::MAX), counter(0), closed(false) { }
 
-void ArithmeticEncoder::close() {
+template <size_t N>
+void BasicArithmeticEncoder<N>::close() {
 	if (!closed) {
 		counter++;
 		if (intervalLow < IntervalTraitsType::QUARTER) {
@@ -24,7 +26,8 @@ void ArithmeticEncoder::close() {
 	closed = true;
 }
 
-void ArithmeticEncoder::reset() {
+template <size_t N>
+void BasicArithmeticEncoder<N>::reset() {
 	close();
 
 	intervalLow = 0;
@@ -33,25 +36,38 @@ void ArithmeticEncoder::reset() {
 	closed = false;
 }
 
-void ArithmeticEncoder::encodeIntervalChange(bool flag) {
+template <size_t N>
+void BasicArithmeticEncoder<N>::encodeIntervalChange(bool flag) {
 	bitStreamWriter->writeBit(flag);
 	// handle third case, we use relation that (C3)^k C1 = C1 (C2)^k
 	for (; counter > 0; --counter)
 		bitStreamWriter->writeBit(!flag);
 }
 
-void ArithmeticEncoder::encode(unsigned symbol, DataModel* dataModel) {
+template <size_t N>
+void BasicArithmeticEncoder<N>::encode(unsigned symbol, DataModel* dataModel) {
 	// compute helper value
 	auto range = intervalHigh - intervalLow + 1;
-	auto scale = dataModel->getCumulativeFreq(dataModel->size() - 1);
 
-	// interval upper bound
-	intervalHigh = intervalLow + (range * dataModel->getCumulativeFreq(symbol)) / scale - 1;
-
-	// interval lower bound is computed as low + (r * cumFreq(i-1)) / s and cumFreq(-1) == 0 so
-	// if symbol == 0 then interval lower bound is not modified 
-	if (symbol != 0) {
-		intervalLow += (range * dataModel->getCumulativeFreq(symbol - 1)) / scale;
+	if (auto bits = dataModel->totalBits()) {
+		// total frequency is power of two, interval is split to equal steps without division
+		auto step = range >> bits;
+		// last symbol also takes rest of interval which steps don't cover
+		if (symbol + 1 != dataModel->size())
+			intervalHigh = intervalLow + step * dataModel->getCumulativeFreq(symbol) - 1;
+		if (symbol != 0)
+			intervalLow += step * dataModel->getCumulativeFreq(symbol - 1);
+	} else {
+		auto scale = dataModel->getCumulativeFreq(dataModel->size() - 1);
+
+		// interval upper bound
+		intervalHigh = intervalLow + static_cast<ValueType>((WideType(range) * dataModel->getCumulativeFreq(symbol)) / scale) - 1;
+
+		// interval lower bound is computed as low + (r * cumFreq(i-1)) / s and cumFreq(-1) == 0 so
+		// if symbol == 0 then interval lower bound is not modified 
+		if (symbol != 0) {
+			intervalLow += static_cast<ValueType>((WideType(range) * dataModel->getCumulativeFreq(symbol - 1)) / scale);
+		}
 	}
 
 	// enlarge interval and send info about it to output
@@ -94,7 +110,75 @@ void ArithmeticEncoder::encode(unsigned symbol, DataModel* dataModel) {
 	}
 
 	// on adaptive data model we increase symbol frequency
-	auto adaptiveModel = dynamic_cast<AdaptiveDataModel*>(dataModel);
-	if (adaptiveModel != nullptr)
-		adaptiveModel->incSymbolFreq(symbol);
+	dataModel->update(symbol);
+}
+
+template class BasicArithmeticEncoder<sizeof(uint32_t)>;
+
+const uint64_t BasicArithmeticEncoder<sizeof(uint64_t)>::TOP;
+
+BasicArithmeticEncoder<sizeof(uint64_t)>::BasicArithmeticEncoder(std::shared_ptr<BitStreamWriter> bsw)
+	: bitStreamWriter(bsw), low(0), range(UINT64_MAX), cache(0), pending(0), carry(false), closed(false) { }
+
+void BasicArithmeticEncoder<sizeof(uint64_t)>::close() {
+	if (!closed) {
+		// cache and all bytes of low bound, so decoder finds value in interval
+		for (size_t i = 0; i < sizeof(uint64_t) + 1; ++i)
+			shiftLow();
+		bitStreamWriter->flush();
+	}
+	closed = true;
+}
+
+void BasicArithmeticEncoder<sizeof(uint64_t)>::reset() {
+	close();
+
+	low = 0;
+	range = UINT64_MAX;
+	cache = 0;
+	pending = 0;
+	carry = false;
+	closed = false;
+}
+
+void BasicArithmeticEncoder<sizeof(uint64_t)>::shiftLow() {
+	auto top = static_cast<uint8_t>(low >> 56);
+	// 0xFF byte would change by carry, so it waits with cache
+	if (top != 0xFF || carry) {
+		auto add = static_cast<uint8_t>(carry ? 1 : 0);
+		bitStreamWriter->writeBits(static_cast<uint8_t>(cache + add), CHAR_BIT);
+		for (; pending > 0; --pending)
+			bitStreamWriter->writeBits(static_cast<uint8_t>(0xFF + add), CHAR_BIT);
+		cache = top;
+	} else
+		pending++;
+
+	low <<= CHAR_BIT;
+	carry = false;
+}
+
+void BasicArithmeticEncoder<sizeof(uint64_t)>::encode(unsigned symbol, DataModel* dataModel) {
+	auto bits = dataModel->totalBits();
+	auto step = bits ? range >> bits : range / dataModel->getCumulativeFreq(dataModel->size() - 1);
+
+	uint64_t lowFreq = symbol != 0 ? dataModel->getCumulativeFreq(symbol - 1) : 0;
+	auto added = step * lowFreq;
+	low += added;
+	// interval low bound shrinks less than its width, so it overflows at most once between shifts
+	if (low < added)
+		carry = true;
+
+	// last symbol also takes rest of interval which steps don't cover
+	if (symbol + 1 != dataModel->size())
+		range = step * (dataModel->getCumulativeFreq(symbol) - lowFreq);
+	else
+		range -= added;
+
+	while (range < TOP) {
+		range <<= CHAR_BIT;
+		shiftLow();
+	}
+
+	// on adaptive data model we increase symbol frequency
+	dataModel->update(symbol);
 }
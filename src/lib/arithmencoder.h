@@ -15,16 +15,17 @@
 
 /**
  * Encoder for arithmetic coding.
- * 32bit integer implementation.
+ * Integer implementation with interval of N bytes, see IntervalTraits.
  * @see http://phoenix.inf.upol.cz/esf/ucebni/komprese.pdf
  */
-class ArithmeticEncoder
+template <size_t N>
+class BasicArithmeticEncoder
 {
 public:
 	/// Ctor
-	explicit ArithmeticEncoder(std::shared_ptr<BitStreamWriter>& bsw);
+	explicit BasicArithmeticEncoder(std::shared_ptr<BitStreamWriter> bsw);
 
-	~ArithmeticEncoder() {
+	~BasicArithmeticEncoder() {
 		close();
 	}
 
@@ -49,14 +50,16 @@ public:
 		return bitStreamWriter;
 	}
 private:
-	typedef IntervalTraits<sizeof(uint32_t)> IntervalTraitsType;
+	typedef IntervalTraits<N> IntervalTraitsType;
+	typedef typename IntervalTraitsType::ValueType ValueType;
+	typedef typename IntervalTraitsType::WideType WideType;
 
 	void encodeIntervalChange(bool flag);
 
 	std::shared_ptr<BitStreamWriter> bitStreamWriter;
 
-	uint64_t intervalLow;			/// lower interval bound
-	uint64_t intervalHigh;			/// upper interval bound
+	ValueType intervalLow;			/// lower interval bound
+	ValueType intervalHigh;			/// upper interval bound
 	/// counter that counts how many times in row was interval enlarged from
 	/// middle possible range
 	std::size_t counter;
@@ -64,4 +67,61 @@ private:
 	bool closed;
 };
 
+/**
+ * 64bit arithmetic encoder, range coder renormalizing by whole bytes.
+ * Interval is kept at least 2^56 wide, so byte is shifted out only after about 8 bits
+ * are coded instead of testing interval after every bit. Carry of interval low bound
+ * is propagated to last byte and run of 0xFF bytes which are held back for it.
+ */
+template <>
+class BasicArithmeticEncoder<sizeof(uint64_t)>
+{
+public:
+	explicit BasicArithmeticEncoder(std::shared_ptr<BitStreamWriter> bsw);
+
+	~BasicArithmeticEncoder() {
+		close();
+	}
+
+	void reset();
+
+	/**
+	 * Finishes encoding, writing all bytes of interval low bound.
+	 */
+	void close();
+
+	/**
+	 * Encodes given symbol with data model.
+	 * @param symbol symbol from dataModel to encode
+	 * @param dataModel data model with frequencies
+	 */
+	void encode(unsigned symbol, DataModel* dataModel);
+
+	std::shared_ptr<BitStreamWriter> writer() {
+		return bitStreamWriter;
+	}
+private:
+	/// Interval is renormalized when it is narrower
+	static const uint64_t TOP = uint64_t(1) << 56;
+
+	/// Moves top byte of low bound to held back bytes, writes those which carry can't change
+	void shiftLow();
+
+	std::shared_ptr<BitStreamWriter> bitStreamWriter;
+
+	uint64_t low;			/// lower interval bound
+	uint64_t range;			/// interval width
+	uint8_t cache;			/// last byte which may still be changed by carry
+	std::size_t pending;	/// number of 0xFF bytes following cache
+	bool carry;				/// low bound overflowed since last shift
+	bool closed;
+};
+
+/// 32bit arithmetic encoder
+typedef BasicArithmeticEncoder<sizeof(uint32_t)> ArithmeticEncoder;
+/// 64bit arithmetic encoder, total frequency of data model can be larger without loss of precision
+typedef BasicArithmeticEncoder<sizeof(uint64_t)> ArithmeticEncoder64;
+
+extern template class BasicArithmeticEncoder<sizeof(uint32_t)>;
+
 #endif // !ARITHMENCODER_H
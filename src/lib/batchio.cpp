@@ -0,0 +1,387 @@
+/**
+ * @file batchio.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "batchio.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#ifdef MUL13_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#endif // MUL13_HAVE_IO_URING
+
+void StreamBatchFileIo::readFiles(const std::vector<std::string>& paths, std::vector<std::string>& contents) {
+	contents.resize(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i) {
+		std::ifstream file(paths[i].c_str(), std::ios_base::binary);
+		if (!file)
+			throw std::runtime_error("Unable to open input file: " + paths[i]);
+
+		file.seekg(0, std::ios_base::end);
+		auto size = static_cast<size_t>(file.tellg());
+		file.seekg(0, std::ios_base::beg);
+
+		contents[i].resize(size);
+		if (size > 0 && !file.read(&contents[i][0], size))
+			throw std::runtime_error("Unable to read input file: " + paths[i]);
+	}
+}
+
+void StreamBatchFileIo::writeFiles(const std::vector<std::string>& paths, const std::vector<std::string>& contents) {
+	for (size_t i = 0; i < paths.size(); ++i) {
+		std::ofstream file(paths[i].c_str(), std::ios_base::binary);
+		if (!file || !file.write(contents[i].data(), contents[i].size()))
+			throw std::runtime_error("Unable to write output file: " + paths[i]);
+	}
+}
+
+#ifdef MUL13_HAVE_IO_URING
+
+/**
+ * Batch I/O using Linux io_uring.
+ * Every file goes through open, read or write chunks and close, each step is one
+ * submission. Up to queue depth files are processed at once, each owning one
+ * buffer registered with the kernel.
+ */
+class UringBatchFileIo : public IBatchFileIo
+{
+public:
+	static const size_t CHUNK_SIZE = 1 << 17;
+
+	/// @throws std::runtime_error when io_uring can't be used
+	explicit UringBatchFileIo(unsigned queueDepth);
+	~UringBatchFileIo() {
+		release();
+	}
+
+	virtual void readFiles(const std::vector<std::string>& paths, std::vector<std::string>& contents) {
+		contents.assign(paths.size(), std::string());
+		run(paths, &contents, nullptr);
+	}
+
+	virtual void writeFiles(const std::vector<std::string>& paths, const std::vector<std::string>& contents) {
+		run(paths, nullptr, &contents);
+	}
+
+	virtual const char* name() const {
+		return "io_uring";
+	}
+private:
+	enum SlotState { SLOT_IDLE, SLOT_OPENING, SLOT_TRANSFER, SLOT_CLOSING };
+
+	struct Slot
+	{
+		Slot() : state(SLOT_IDLE), job(0), fd(-1), offset(0) { }
+
+		SlotState state;
+		size_t job;			/// index of file processed by slot
+		int fd;
+		uint64_t offset;
+	};
+
+	void run(const std::vector<std::string>& paths, std::vector<std::string>* contents, const std::vector<std::string>* data);
+	void handleCompletion(size_t slotIndex, int res);
+	void submitTransfer(size_t slotIndex);
+	void submitClose(size_t slotIndex);
+	void fail(size_t slotIndex, const char* what, int err);
+	void release();
+
+	io_uring_sqe* nextSqe(size_t slotIndex, uint8_t opcode, int fd);
+	void enter(unsigned minComplete);
+
+	int ringFd;
+	unsigned depth;
+	bool fixedBuffers;
+
+	void* sqRing;
+	void* cqRing;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	io_uring_sqe* sqes;
+	size_t sqesSize;
+
+	unsigned* sqTail;
+	unsigned* sqMask;
+	unsigned* sqArray;
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned* cqMask;
+	io_uring_cqe* cqes;
+	unsigned toSubmit;
+
+	std::vector<char> buffers;		/// CHUNK_SIZE buffer for every slot
+	std::vector<Slot> slots;
+
+	// state of current batch
+	const std::vector<std::string>* paths;
+	std::vector<std::string>* contents;
+	const std::vector<std::string>* data;
+	std::string error;
+};
+
+UringBatchFileIo::UringBatchFileIo(unsigned queueDepth)
+	: ringFd(-1), depth(std::max(queueDepth, 1U)), fixedBuffers(false), sqRing(MAP_FAILED), cqRing(MAP_FAILED),
+	sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), toSubmit(0) {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+	ringFd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+	if (ringFd < 0)
+		throw std::runtime_error("io_uring_setup failed");
+
+	// we need openat and close ops, read and write are older
+	std::vector<char> probeBuffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+	auto probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+	if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) < 0
+		|| probe->last_op < IORING_OP_CLOSE
+		|| !(probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED)
+		|| !(probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED)) {
+		release();
+		throw std::runtime_error("io_uring doesn't support required operations");
+	}
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMmap)
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	cqRing = singleMmap ? sqRing
+		: mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+	if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+		release();
+		throw std::runtime_error("Unable to map io_uring rings");
+	}
+
+	auto sq = static_cast<char*>(sqRing);
+	sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	auto cq = static_cast<char*>(cqRing);
+	cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	// kernel may give us more entries than requested but we use only depth of them
+	depth = std::min(depth, params.sq_entries);
+	slots.resize(depth);
+	buffers.resize(depth * CHUNK_SIZE);
+
+	// registered buffers save page pinning on every transfer, when registration
+	// fails (i.e. low memlock limit) plain read and write are used
+	std::vector<iovec> iovecs(depth);
+	for (unsigned i = 0; i < depth; ++i) {
+		iovecs[i].iov_base = &buffers[i * CHUNK_SIZE];
+		iovecs[i].iov_len = CHUNK_SIZE;
+	}
+	fixedBuffers = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), depth) == 0;
+}
+
+void UringBatchFileIo::release() {
+	if (sqes != MAP_FAILED)
+		munmap(sqes, sqesSize);
+	if (cqRing != MAP_FAILED && cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+	if (sqRing != MAP_FAILED)
+		munmap(sqRing, sqRingSize);
+	if (ringFd >= 0)
+		close(ringFd);
+	sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	sqRing = cqRing = MAP_FAILED;
+	ringFd = -1;
+}
+
+io_uring_sqe* UringBatchFileIo::nextSqe(size_t slotIndex, uint8_t opcode, int fd) {
+	// every slot has at most one operation in flight so submission ring can't overflow
+	unsigned tail = *sqTail;
+	unsigned index = tail & *sqMask;
+	io_uring_sqe* sqe = &sqes[index];
+	std::memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = slotIndex;
+	sqArray[index] = index;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+	toSubmit++;
+	return sqe;
+}
+
+void UringBatchFileIo::enter(unsigned minComplete) {
+	while (toSubmit > 0 || minComplete > 0) {
+		int ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0));
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+		}
+		toSubmit -= std::min(toSubmit, static_cast<unsigned>(ret));
+		minComplete = 0;
+	}
+}
+
+void UringBatchFileIo::run(const std::vector<std::string>& paths, std::vector<std::string>* contents,
+		const std::vector<std::string>* data) {
+	this->paths = &paths;
+	this->contents = contents;
+	this->data = data;
+	error.clear();
+
+	size_t nextJob = 0;
+	size_t active = 0;
+	auto startJob = [&] (size_t slotIndex) {
+		auto& slot = slots[slotIndex];
+		slot.job = nextJob++;
+		slot.offset = 0;
+		slot.state = SLOT_OPENING;
+
+		int flags = contents != nullptr ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+		auto sqe = nextSqe(slotIndex, IORING_OP_OPENAT, AT_FDCWD);
+		sqe->addr = reinterpret_cast<uint64_t>(paths[slot.job].c_str());
+		sqe->len = 0666;
+		sqe->open_flags = flags | O_CLOEXEC;
+	};
+
+	for (size_t i = 0; i < slots.size() && nextJob < paths.size(); ++i, ++active)
+		startJob(i);
+
+	while (active > 0) {
+		enter(1);
+
+		unsigned head = *cqHead;
+		unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head) {
+			const io_uring_cqe& cqe = cqes[head & *cqMask];
+			auto slotIndex = static_cast<size_t>(cqe.user_data);
+			handleCompletion(slotIndex, cqe.res);
+
+			if (slots[slotIndex].state == SLOT_IDLE) {
+				// stop taking new files after first error, only finish those in flight
+				if (nextJob < paths.size() && error.empty())
+					startJob(slotIndex);
+				else
+					active--;
+			}
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	if (!error.empty())
+		throw std::runtime_error(error);
+}
+
+void UringBatchFileIo::handleCompletion(size_t slotIndex, int res) {
+	auto& slot = slots[slotIndex];
+	switch (slot.state) {
+	case SLOT_OPENING:
+		if (res < 0) {
+			fail(slotIndex, "Unable to open file: ", -res);
+			slot.state = SLOT_IDLE;
+			return;
+		}
+		slot.fd = res;
+		slot.state = SLOT_TRANSFER;
+		submitTransfer(slotIndex);
+		break;
+	case SLOT_TRANSFER:
+		if (res < 0) {
+			fail(slotIndex, "Unable to transfer file data: ", -res);
+			submitClose(slotIndex);
+		} else if (contents != nullptr) {
+			// reading, zero means end of file
+			if (res == 0) {
+				submitClose(slotIndex);
+				return;
+			}
+			(*contents)[slot.job].append(&buffers[slotIndex * CHUNK_SIZE], res);
+			slot.offset += res;
+			submitTransfer(slotIndex);
+		} else if (res == 0) {
+			fail(slotIndex, "Unable to transfer file data: ", EIO);
+			submitClose(slotIndex);
+		} else {
+			slot.offset += res;
+			submitTransfer(slotIndex);
+		}
+		break;
+	case SLOT_CLOSING:
+		slot.fd = -1;
+		slot.state = SLOT_IDLE;
+		break;
+	case SLOT_IDLE:
+		break;
+	}
+}
+
+void UringBatchFileIo::submitTransfer(size_t slotIndex) {
+	auto& slot = slots[slotIndex];
+	char* buffer = &buffers[slotIndex * CHUNK_SIZE];
+	size_t length = CHUNK_SIZE;
+
+	if (data != nullptr) {
+		const std::string& content = (*data)[slot.job];
+		if (slot.offset >= content.size()) {
+			submitClose(slotIndex);
+			return;
+		}
+		length = std::min(length, static_cast<size_t>(content.size() - slot.offset));
+		std::memcpy(buffer, content.data() + slot.offset, length);
+	}
+
+	uint8_t opcode;
+	if (data != nullptr)
+		opcode = fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+	else
+		opcode = fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+
+	auto sqe = nextSqe(slotIndex, opcode, slot.fd);
+	sqe->addr = reinterpret_cast<uint64_t>(buffer);
+	sqe->len = static_cast<uint32_t>(length);
+	sqe->off = slot.offset;
+	if (fixedBuffers)
+		sqe->buf_index = static_cast<uint16_t>(slotIndex);
+}
+
+void UringBatchFileIo::submitClose(size_t slotIndex) {
+	slots[slotIndex].state = SLOT_CLOSING;
+	nextSqe(slotIndex, IORING_OP_CLOSE, slots[slotIndex].fd);
+}
+
+void UringBatchFileIo::fail(size_t slotIndex, const char* what, int err) {
+	if (error.empty())
+		error = what + (*paths)[slots[slotIndex].job] + " (" + std::strerror(err) + ")";
+}
+
+#endif // MUL13_HAVE_IO_URING
+
+std::unique_ptr<IBatchFileIo> createBatchFileIo(bool useUring, unsigned queueDepth) {
+#ifdef MUL13_HAVE_IO_URING
+	if (useUring) {
+		try {
+			return std::unique_ptr<IBatchFileIo>(new UringBatchFileIo(queueDepth));
+		} catch (std::runtime_error&) {
+			// kernel without io_uring or it's forbidden, use streams
+		}
+	}
+#else
+	(void)useUring;
+	(void)queueDepth;
+#endif // MUL13_HAVE_IO_URING
+
+	return std::unique_ptr<IBatchFileIo>(new StreamBatchFileIo());
+}
@@ -0,0 +1,68 @@
+/**
+ * @file batchio.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Interface for reading and writing whole content of many files at once.
+ * Implementations may overlap I/O of individual files.
+ */
+class IBatchFileIo
+{
+public:
+	virtual ~IBatchFileIo() { }
+
+	/**
+	 * Reads whole content of files.
+	 * @param paths files to read
+	 * @retval contents content of each file in order of paths
+	 * @throws std::runtime_error when some file can't be read
+	 */
+	virtual void readFiles(const std::vector<std::string>& paths, std::vector<std::string>& contents) = 0;
+
+	/**
+	 * Creates or truncates files and writes contents to them.
+	 * @param paths files to write
+	 * @param contents content of each file in order of paths
+	 * @throws std::runtime_error when some file can't be written
+	 */
+	virtual void writeFiles(const std::vector<std::string>& paths, const std::vector<std::string>& contents) = 0;
+
+	/// Name of backend
+	virtual const char* name() const = 0;
+};
+
+/**
+ * Portable implementation using stl file streams, one file after another.
+ */
+class StreamBatchFileIo : public IBatchFileIo
+{
+public:
+	virtual void readFiles(const std::vector<std::string>& paths, std::vector<std::string>& contents);
+
+	virtual void writeFiles(const std::vector<std::string>& paths, const std::vector<std::string>& contents);
+
+	virtual const char* name() const {
+		return "streams";
+	}
+};
+
+/**
+ * Creates batch I/O backend.
+ * When io_uring is requested but not compiled in or not supported by running kernel,
+ * StreamBatchFileIo is returned instead.
+ * @param useUring prefer Linux io_uring backend
+ * @param queueDepth maximal number of files with I/O in flight
+ */
+std::unique_ptr<IBatchFileIo> createBatchFileIo(bool useUring, unsigned queueDepth);
+
+#endif // !BATCH_IO_H
@@ -0,0 +1,224 @@
+/**
+ * @file bitpack.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "bitpack.h"
+
+#include <cassert>
+#include <cstring>
+
+#if !defined(MUL13_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define BITPACK_X86
+#include <immintrin.h>
+#endif
+
+namespace bitpack {
+
+namespace {
+
+inline uint64_t load64(const uint8_t* p) {
+	uint64_t value;
+	std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap64(value);
+#endif
+	return value;
+}
+
+inline void store64(uint8_t* p, uint64_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap64(value);
+#endif
+	std::memcpy(p, &value, sizeof(value));
+}
+
+/// ORs n bits of value to buffer, n is at most 64
+inline void orBits(uint8_t* data, size_t bitPos, uint64_t value, unsigned n) {
+	uint8_t* p = data + (bitPos >> 3);
+	unsigned shift = bitPos & 7;
+	store64(p, load64(p) | (value << shift));
+	// bits shifted out of 64 bit word
+	if (shift != 0 && n + shift > 64)
+		p[8] |= static_cast<uint8_t>(value >> (64 - shift));
+}
+
+void unpackScalar(const uint8_t* data, size_t bitPos, unsigned width, size_t count, uint32_t* codes) {
+	const uint64_t mask = (uint64_t(1) << width) - 1;
+	for (size_t i = 0; i < count; ++i, bitPos += width)
+		codes[i] = static_cast<uint32_t>((load64(data + (bitPos >> 3)) >> (bitPos & 7)) & mask);
+}
+
+void packScalar(const uint32_t* codes, size_t count, unsigned width, uint8_t* data, size_t bitPos) {
+	const uint32_t mask = static_cast<uint32_t>((uint64_t(1) << width) - 1);
+	for (size_t i = 0; i < count; ++i, bitPos += width)
+		orBits(data, bitPos, codes[i] & mask, width);
+}
+
+void reverseScalar(uint8_t* data, size_t size) {
+	static uint8_t table[256];
+	static bool initialized = false;
+	if (!initialized) {
+		for (unsigned b = 0; b < 256; ++b) {
+			unsigned r = 0;
+			for (unsigned i = 0; i < 8; ++i)
+				r |= ((b >> i) & 1) << (7 - i);
+			table[b] = static_cast<uint8_t>(r);
+		}
+		initialized = true;
+	}
+
+	for (size_t i = 0; i < size; ++i)
+		data[i] = table[data[i]];
+}
+
+#ifdef BITPACK_X86
+
+__attribute__((target("avx2")))
+void unpackAvx2(const uint8_t* data, size_t bitPos, unsigned width, size_t count, uint32_t* codes) {
+	if (width > 24) {
+		unpackScalar(data, bitPos, width, count, codes);
+		return;
+	}
+
+	const __m256i mask = _mm256_set1_epi32(static_cast<int>((1U << width) - 1));
+	const __m256i seven = _mm256_set1_epi32(7);
+	// bit offsets of 8 codes relative to byte where first of them starts
+	const __m256i laneOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+		_mm256_set1_epi32(static_cast<int>(width)));
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8, bitPos += 8 * width) {
+		auto base = reinterpret_cast<const int*>(data + (bitPos >> 3));
+		auto offsets = _mm256_add_epi32(laneOffsets, _mm256_set1_epi32(static_cast<int>(bitPos & 7)));
+		// every code fits to 32 bits loaded from its first byte
+		auto words = _mm256_i32gather_epi32(base, _mm256_srli_epi32(offsets, 3), 1);
+		words = _mm256_srlv_epi32(words, _mm256_and_si256(offsets, seven));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), _mm256_and_si256(words, mask));
+	}
+	unpackScalar(data, bitPos, width, count - i, codes + i);
+}
+
+__attribute__((target("avx2")))
+void packAvx2(const uint32_t* codes, size_t count, unsigned width, uint8_t* data, size_t bitPos) {
+	if (width > 16) {
+		packScalar(codes, count, width, data, bitPos);
+		return;
+	}
+
+	const __m256i mask = _mm256_set1_epi32(static_cast<int>((1U << width) - 1));
+	const __m256i low32 = _mm256_set1_epi64x(0xFFFFFFFF);
+	const __m128i shift1 = _mm_cvtsi32_si128(static_cast<int>(width));
+	const __m128i shift2 = _mm_cvtsi32_si128(static_cast<int>(2 * width));
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8, bitPos += 8 * width) {
+		auto v = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + i)), mask);
+		// join pairs of codes in 64 bit lanes
+		auto pairs = _mm256_or_si256(_mm256_and_si256(v, low32), _mm256_sll_epi64(_mm256_srli_epi64(v, 32), shift1));
+		// join pairs of pairs, lanes 0 and 1 then have 4 codes each
+		auto even = _mm256_permute4x64_epi64(pairs, _MM_SHUFFLE(2, 0, 2, 0));
+		auto odd = _mm256_permute4x64_epi64(pairs, _MM_SHUFFLE(3, 1, 3, 1));
+		auto quads = _mm256_or_si256(even, _mm256_sll_epi64(odd, shift2));
+
+		orBits(data, bitPos, static_cast<uint64_t>(_mm256_extract_epi64(quads, 0)), 4 * width);
+		orBits(data, bitPos + 4 * width, static_cast<uint64_t>(_mm256_extract_epi64(quads, 1)), 4 * width);
+	}
+	packScalar(codes + i, count - i, width, data, bitPos);
+}
+
+__attribute__((target("avx2")))
+void reverseAvx2(uint8_t* data, size_t size) {
+	// bit reversed nibbles, low nibble goes to high one
+	const __m256i reversedLow = _mm256_setr_epi8(
+		0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+		0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0);
+	const __m256i reversedHigh = _mm256_setr_epi8(
+		0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+		0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		auto low = _mm256_shuffle_epi8(reversedLow, _mm256_and_si256(v, nibble));
+		auto high = _mm256_shuffle_epi8(reversedHigh, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), _mm256_or_si256(low, high));
+	}
+	reverseScalar(data + i, size - i);
+}
+
+__attribute__((target("ssse3")))
+void reverseSsse3(uint8_t* data, size_t size) {
+	const __m128i reversedLow = _mm_setr_epi8(
+		0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0);
+	const __m128i reversedHigh = _mm_setr_epi8(
+		0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		auto low = _mm_shuffle_epi8(reversedLow, _mm_and_si128(v, nibble));
+		auto high = _mm_shuffle_epi8(reversedHigh, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_or_si128(low, high));
+	}
+	reverseScalar(data + i, size - i);
+}
+
+#endif // BITPACK_X86
+
+struct Kernels
+{
+	void (*unpack)(const uint8_t*, size_t, unsigned, size_t, uint32_t*);
+	void (*pack)(const uint32_t*, size_t, unsigned, uint8_t*, size_t);
+	void (*reverse)(uint8_t*, size_t);
+	const char* name;
+};
+
+Kernels selectKernels() {
+	Kernels kernels = { unpackScalar, packScalar, reverseScalar, "scalar" };
+	// make sure table is built before kernels are used from more threads
+	uint8_t byte = 0;
+	reverseScalar(&byte, 1);
+#ifdef BITPACK_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		kernels.unpack = unpackAvx2;
+		kernels.pack = packAvx2;
+		kernels.reverse = reverseAvx2;
+		kernels.name = "avx2";
+	} else if (__builtin_cpu_supports("ssse3"))
+		kernels.reverse = reverseSsse3;
+#endif // BITPACK_X86
+	return kernels;
+}
+
+const Kernels& kernels() {
+	static const Kernels selected = selectKernels();
+	return selected;
+}
+
+}
+
+void unpackCodes(const uint8_t* data, size_t bitPos, unsigned width, size_t count, uint32_t* codes) {
+	assert(width > 0 && width <= MAX_WIDTH);
+	kernels().unpack(data, bitPos, width, count, codes);
+}
+
+void packCodes(const uint32_t* codes, size_t count, unsigned width, uint8_t* data, size_t bitPos) {
+	assert(width > 0 && width <= MAX_WIDTH);
+	kernels().pack(codes, count, width, data, bitPos);
+}
+
+void reverseBitsInBytes(uint8_t* data, size_t size) {
+	kernels().reverse(data, size);
+}
+
+const char* kernelName() {
+	return kernels().name;
+}
+
+}
@@ -0,0 +1,62 @@
+/**
+ * @file bitpack.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef BIT_PACK_H
+#define BIT_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Kernels packing and unpacking runs of codes with same bit width.
+ *
+ * Packed buffers are LSB first, bit i of buffer is bit (i % 8) of byte i / 8 and
+ * codes are stored from their LSB. Bit streams are MSB first, so buffers are
+ * converted by reverseBitsInBytes when they are read from or written to stream.
+ *
+ * Kernels use AVX2 when CPU supports it, otherwise scalar code is used.
+ */
+namespace bitpack {
+
+/// Number of bytes after end of data kernels may read or write, buffers must have them
+const size_t PADDING = 32;
+
+/// Maximum code width supported by kernels
+const unsigned MAX_WIDTH = 24;
+
+/**
+ * Unpacks codes from buffer.
+ * @param data packed buffer
+ * @param bitPos position of first code in bits
+ * @param width code width in bits
+ * @param count number of codes
+ * @retval codes unpacked codes
+ */
+void unpackCodes(const uint8_t* data, size_t bitPos, unsigned width, size_t count, uint32_t* codes);
+
+/**
+ * Packs codes to buffer.
+ * Bits are OR-ed into buffer so it has to be zeroed from bitPos on.
+ * @param codes codes to pack, only width lowest bits of each are used
+ * @param count number of codes
+ * @param width code width in bits
+ * @param data packed buffer
+ * @param bitPos position of first code in bits
+ */
+void packCodes(const uint32_t* codes, size_t count, unsigned width, uint8_t* data, size_t bitPos);
+
+/**
+ * Reverses bit order in every byte, converts between packed buffer and bit stream.
+ */
+void reverseBitsInBytes(uint8_t* data, size_t size);
+
+/// Name of kernels in use, "avx2" or "scalar"
+const char* kernelName();
+
+}
+
+#endif // !BIT_PACK_H
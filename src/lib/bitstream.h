@@ -13,19 +13,36 @@
 #include <stdexcept>
 #include <cassert>
 #include <climits>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "bitpack.h"
+
+// bit streams report end of data by return value, exceptions are used only for
+// real stream errors and only when compiled with exceptions enabled
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define BITSTREAM_THROW(what) throw std::runtime_error(what)
+#else
+#define BITSTREAM_THROW(what) ((void)0)
+#endif
 
 /**
  * Reader for individual bits from stl streams.
+ * Stream is read ahead in large chunks, so reader has to be the last one reading it.
  */
 class BitStreamReader
 {
 public:
+	/// Size of read ahead buffer in bytes
+	static const size_t BUFFER_SIZE = 1 << 16;
+
 	/**
 	 * Constructs new reader from stream.
 	 * @param stream pointer to stl istream, its caller responsibility 
 	 *        that object is not destroyed while this instance is alive
 	 */
-	explicit BitStreamReader(std::istream* stream) {
+	explicit BitStreamReader(std::istream* stream) : buffer(BUFFER_SIZE + bitpack::PADDING) {
 		reset(stream);
 	}
 
@@ -34,63 +51,168 @@ public:
 	 * @param stream new istream to read from
 	 */
 	void reset(std::istream* stream) {
-		byte = 0;
-		mask = 0;
+		bitPos = 0;
+		bitEnd = 0;
+		padding = 0;
+		ended = false;
+		error = false;
 		this->stream = stream;
 	}
 
 	/**
 	 * Read single bit from stream.
-	 * @return true if read bit set false otherwise
-	 * @throws std::runtime_error when unable to read from stream
+	 * @retval bit read bit
+	 * @return true on success, false at end of stream or on stream error
+	 * @throws std::runtime_error on stream error when exceptions are enabled
 	 */
-	bool readBit() {
-		if (mask == 0) {
-			if (!stream->read(reinterpret_cast<char*>(&byte), 1))
-				throw std::runtime_error("Unable to read from stream!");
-			mask = 0x80;
-		}
+	bool readBit(bool& bit) {
+		if (bitPos == bitEnd && !fill(1))
+			return false;
 
-		bool bit = !!(byte & mask);
-		mask >>= 1;
-		return bit;
+		bit = !!((buffer[bitPos >> 3] >> (bitPos & 7)) & 1);
+		bitPos++;
+		return true;
+	}
+
+	/**
+	 * Read single bit, after end of stream zero bits are returned.
+	 * Number of such padding bits is counted, see {@link paddingBits}.
+	 * @return read bit
+	 */
+	bool readBitPadded() {
+		bool bit;
+		if (readBit(bit))
+			return bit;
+
+		padding++;
+		return false;
 	}
 
 	/**
 	 * Reads n bits from stream.
 	 * @param n number of bits that will be read to result.
-	 * @return bits read. Bits are stored here starting from LSB
-	 * @throws std::runtime_error when unable to read from stream
+	 * @retval bits bits read. Bits are stored here starting from LSB
+	 * @return true on success, false when stream ended before n bits were read
+	 * @throws std::runtime_error on stream error when exceptions are enabled
 	 */
-	size_t readBits(size_t n) {
+	bool readBits(size_t n, size_t& bits) {
 		assert(n <= sizeof(size_t) * CHAR_BIT);
 
-		size_t result = 0;
-		for (size_t i = 0; i < n; ++i) {
-			if (readBit())
-				result |= 1 << i;
+		if (n == 0 || n > bitpack::MAX_WIDTH) {
+			size_t result = 0;
+			for (size_t i = 0; i < n; ++i) {
+				bool bit;
+				if (!readBit(bit))
+					return false;
+				if (bit)
+					result |= size_t(1) << i;
+			}
+			bits = result;
+			return true;
 		}
-		return result;
+
+		uint32_t code;
+		if (peekCodes(static_cast<unsigned>(n), 1, &code) == 0)
+			return false;
+		skipBits(n);
+		bits = code;
+		return true;
+	}
+
+	/**
+	 * Unpacks codes of same width without consuming them.
+	 * @param width code width, at most bitpack::MAX_WIDTH
+	 * @param count number of codes, at most BUFFER_SIZE bytes of them
+	 * @retval codes unpacked codes
+	 * @return number of codes unpacked, less than count only at end of stream
+	 * @throws std::runtime_error on stream error when exceptions are enabled
+	 */
+	size_t peekCodes(unsigned width, size_t count, uint32_t* codes) {
+		assert(count * width <= (BUFFER_SIZE - 1) * CHAR_BIT);
+
+		fill(count * width);
+		size_t available = (bitEnd - bitPos) / width;
+		if (available < count)
+			count = available;
+		bitpack::unpackCodes(buffer.data(), bitPos, width, count, codes);
+		return count;
+	}
+
+	/**
+	 * Consumes bits unpacked by peekCodes.
+	 */
+	void skipBits(size_t n) {
+		assert(n <= bitEnd - bitPos);
+		bitPos += n;
+	}
+
+	/// Number of zero bits returned by readBitPadded after end of stream
+	size_t paddingBits() const {
+		return padding;
+	}
+
+	/// True when reading stopped because of stream error, not end of data
+	bool failed() const {
+		return error;
 	}
 private:
+	/// Makes sure that buffer has n bits unless stream ends first
+	bool fill(size_t n) {
+		if (bitEnd - bitPos >= n)
+			return true;
+		if (ended)
+			return false;
+
+		// move unread bytes to front of buffer
+		size_t first = bitPos >> 3;
+		size_t last = bitEnd >> 3;
+		std::memmove(buffer.data(), buffer.data() + first, last - first);
+		bitPos -= first << 3;
+		bitEnd -= first << 3;
+		last -= first;
+
+		stream->read(reinterpret_cast<char*>(buffer.data() + last), BUFFER_SIZE - last);
+		auto count = static_cast<size_t>(stream->gcount());
+		if (!*stream) {
+			ended = true;
+			if (stream->bad()) {
+				error = true;
+				BITSTREAM_THROW("Unable to read from stream!");
+			}
+		}
+
+		// stream is MSB first, buffer LSB first
+		bitpack::reverseBitsInBytes(buffer.data() + last, count);
+		bitEnd += count << 3;
+		return bitEnd - bitPos >= n;
+	}
+
 	std::istream* stream;
 
-	uint8_t byte;		/// buffer for current byte
-	uint8_t mask;
+	std::vector<uint8_t> buffer;	/// read ahead bytes, bit order reversed
+	size_t bitPos;		/// position of next bit in buffer
+	size_t bitEnd;		/// number of valid bits in buffer
+	size_t padding;		/// number of bits read after end of stream
+	bool ended;
+	bool error;
 };
 
 /**
  * Writer for individual bits to stl streams.
+ * Bits are collected in buffer which is written to stream when full or on flush.
  */
 class BitStreamWriter
 {
 public:
+	/// Size of write buffer in bytes
+	static const size_t BUFFER_SIZE = 1 << 16;
+
 	/**
 	 * Constructs new writer for stream.
 	 * @param stream pointer to stl ostream, its caller responsibility 
 	 *        that object is not destroyed while this instance is alive
 	 */
-	explicit BitStreamWriter(std::ostream* stream) {
+	explicit BitStreamWriter(std::ostream* stream) : buffer(BUFFER_SIZE + bitpack::PADDING) {
 		reset(stream);
 	}
 
@@ -100,13 +222,17 @@ public:
 
 	/**
 	 * Flushes internal writing buffer.
+	 * Last byte is padded by zero bits. Stream errors are not reported here,
+	 * caller checks stream state.
 	 */
 	void flush() {
-		// when we have something in buffer, write whole byte to stream
-		if (mask != 0x80) {
-			stream->put(byte);
-			byte = 0;
-			mask = 0x80;
+		// when we have something in buffer, write it with last incomplete byte
+		size_t size = (bitPos + 7) >> 3;
+		if (size > 0) {
+			bitpack::reverseBitsInBytes(buffer.data(), size);
+			stream->write(reinterpret_cast<const char*>(buffer.data()), size);
+			std::memset(buffer.data(), 0, size);
+			bitPos = 0;
 		}
 	}
 
@@ -115,47 +241,80 @@ public:
 	 * @param stream new ostream to write to
 	 */
 	void reset(std::ostream* stream) {
-		byte = 0;
-		mask = 0x80;
+		std::fill(buffer.begin(), buffer.end(), 0);
+		bitPos = 0;
 		this->stream = stream;
 	}
 
 	/**
 	 * Writes single bit to stream.
 	 * @param bit true if new bit should be set, false otherwise
-	 * @throws std::runtime_error when failed to write to stream
+	 * @throws std::runtime_error when failed to write to stream and exceptions are enabled
 	 */
 	void writeBit(bool bit) {
 		// set bit if we should
 		if (bit)
-			byte |= mask;
+			buffer[bitPos >> 3] |= static_cast<uint8_t>(1 << (bitPos & 7));
 
-		mask >>= 1;
-		if (mask == 0) {
-			if (!stream->put(byte))
-				throw std::runtime_error("Unable to put byte into stream!");
-
-			byte = 0;
-			mask = 0x80;
-		}
+		if (++bitPos >= BUFFER_SIZE * CHAR_BIT)
+			writeFullBytes();
 	}
 
 	/**
 	 * Write n bits to stream.
 	 * @param bits buffer with bits to write
 	 * @param n number of bits that will be put to stream, starting from LSB.
-	 * @throws std::runtime_error when failed to write to stream
+	 * @throws std::runtime_error when failed to write to stream and exceptions are enabled
 	 */
 	void writeBits(size_t bits, size_t n) {
-		for (size_t i = 0; i < n; ++i) {
-			writeBit((bits & (1 << i)) != 0);
+		if (n == 0 || n > bitpack::MAX_WIDTH) {
+			for (size_t i = 0; i < n; ++i)
+				writeBit((bits & (size_t(1) << i)) != 0);
+			return;
 		}
+
+		auto code = static_cast<uint32_t>(bits);
+		packCodes(static_cast<unsigned>(n), &code, 1);
+	}
+
+	/**
+	 * Writes codes of same width.
+	 * @param width code width, at most bitpack::MAX_WIDTH
+	 * @param codes codes to write, only width lowest bits of each are used
+	 * @param count number of codes, at most BUFFER_SIZE / 2 bytes of them
+	 * @throws std::runtime_error when failed to write to stream and exceptions are enabled
+	 */
+	void packCodes(unsigned width, const uint32_t* codes, size_t count) {
+		assert(count * width <= BUFFER_SIZE / 2 * CHAR_BIT);
+
+		if (bitPos + count * width > BUFFER_SIZE * CHAR_BIT)
+			writeFullBytes();
+		bitpack::packCodes(codes, count, width, buffer.data(), bitPos);
+		bitPos += count * width;
+		// full buffer is written now, writeBit relies on bitPos being below its end
+		if (bitPos >= BUFFER_SIZE * CHAR_BIT)
+			writeFullBytes();
 	}
 private:
+	/// Writes all complete bytes, incomplete last byte stays in buffer
+	void writeFullBytes() {
+		size_t size = bitPos >> 3;
+		uint8_t last = buffer[size];
+
+		bitpack::reverseBitsInBytes(buffer.data(), size);
+		bool written = !!stream->write(reinterpret_cast<const char*>(buffer.data()), size);
+		std::memset(buffer.data(), 0, size + 1);
+		buffer[0] = last;
+		bitPos &= 7;
+
+		if (!written)
+			BITSTREAM_THROW("Unable to put byte into stream!");
+	}
+
 	std::ostream* stream;
 
-	uint8_t byte;
-	uint8_t mask;
+	std::vector<uint8_t> buffer;	/// collected bits, bit order reversed
+	size_t bitPos;		/// position of next bit in buffer
 };
 
 #endif // !BITSTREAM_H
@@ -0,0 +1,42 @@
+/**
+ * @file byteorder.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include <iostream>
+#include <stdexcept>
+#include <climits>
+
+/**
+ * Writes unsigned integer to stream in little endian byte order.
+ */
+template <typename T>
+void writeLittleEndian(std::ostream& stream, T value) {
+	char bytes[sizeof(T)];
+	for (size_t i = 0; i < sizeof(T); ++i)
+		bytes[i] = static_cast<char>((value >> (CHAR_BIT * i)) & 0xFF);
+	stream.write(bytes, sizeof(T));
+}
+
+/**
+ * Reads unsigned integer stored in little endian byte order from stream.
+ * @throws std::runtime_error when stream ends before whole value is read
+ */
+template <typename T>
+T readLittleEndian(std::istream& stream) {
+	unsigned char bytes[sizeof(T)];
+	if (!stream.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+		throw std::runtime_error("Unexpected end of stream");
+
+	T value = 0;
+	for (size_t i = 0; i < sizeof(T); ++i)
+		value |= static_cast<T>(bytes[i]) << (CHAR_BIT * i);
+	return value;
+}
+
+#endif // !BYTE_ORDER_H
@@ -0,0 +1,111 @@
+/**
+ * @file bytescan.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "bytescan.h"
+
+#include <cstring>
+
+#if !defined(MUL13_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define BYTESCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace bytescan {
+
+namespace {
+
+size_t runLengthScalar(const uint8_t* data, size_t size) {
+	if (size == 0)
+		return 0;
+
+	// whole words are compared with first byte repeated
+	uint64_t pattern = data[0] * UINT64_C(0x0101010101010101);
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		if (word != pattern)
+			break;
+	}
+	while (i < size && data[i] == data[0])
+		++i;
+	return i;
+}
+
+#ifdef BYTESCAN_X86
+
+__attribute__((target("avx2")))
+size_t runLengthAvx2(const uint8_t* data, size_t size) {
+	if (size == 0)
+		return 0;
+
+	const __m256i pattern = _mm256_set1_epi8(static_cast<char>(data[0]));
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern)));
+		if (mask != UINT32_MAX)
+			return i + static_cast<size_t>(__builtin_ctz(~mask));
+	}
+	while (i < size && data[i] == data[0])
+		++i;
+	return i;
+}
+
+#endif // BYTESCAN_X86
+
+struct Kernels
+{
+	size_t (*runLength)(const uint8_t*, size_t);
+	const char* name;
+};
+
+Kernels selectKernels() {
+	Kernels kernels = { runLengthScalar, "scalar" };
+#ifdef BYTESCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		kernels.runLength = runLengthAvx2;
+		kernels.name = "avx2";
+	}
+#endif // BYTESCAN_X86
+	return kernels;
+}
+
+const Kernels& kernels() {
+	static const Kernels selected = selectKernels();
+	return selected;
+}
+
+}
+
+size_t runLength(const uint8_t* data, size_t size) {
+	return kernels().runLength(data, size);
+}
+
+size_t findRun(const uint8_t* data, size_t size, size_t probe, size_t& length) {
+	for (size_t position = 0; position + probe <= size; position += probe) {
+		// ends of probe differ in almost all data which isn't run
+		auto byte = data[position];
+		if (data[position + probe - 1] != byte || runLength(data + position, probe) < probe)
+			continue;
+
+		// probe before wasn't whole run, so run starts less than probe back
+		size_t start = position;
+		while (start > 0 && data[start - 1] == byte)
+			--start;
+		length = position - start + runLength(data + position, size - position);
+		return start;
+	}
+	return size;
+}
+
+const char* kernelName() {
+	return kernels().name;
+}
+
+}
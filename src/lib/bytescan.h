@@ -0,0 +1,41 @@
+/**
+ * @file bytescan.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Kernels scanning data for runs of one byte value.
+ * Kernels use AVX2 when CPU supports it, otherwise 8 bytes are compared at once.
+ */
+namespace bytescan {
+
+/**
+ * Length of run of bytes equal to first one.
+ * @return number of bytes from start equal to data[0], at most size, 0 for empty data
+ */
+size_t runLength(const uint8_t* data, size_t size);
+
+/**
+ * Finds first run of one byte value. Only runs covering whole probe at offset multiple
+ * of probe are found, so runs of at least 2 * probe bytes are never missed and most of
+ * data is rejected by comparing two bytes per probe.
+ * @param probe length of probed part of data
+ * @retval length length of found run, at least probe
+ * @return offset of found run, size when there is none
+ */
+size_t findRun(const uint8_t* data, size_t size, size_t probe, size_t& length);
+
+/// Name of kernels in use, "avx2" or "scalar"
+const char* kernelName();
+
+}
+
+#endif // !BYTE_SCAN_H
@@ -0,0 +1,225 @@
+/**
+ * @file fdstream.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "fdstream.h"
+
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+#define write _write
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+namespace {
+
+const int STDIN_FD = 0;
+const int STDOUT_FD = 1;
+/// Largest read or write of one call, count of system call may be only 32bit
+const std::size_t MAX_TRANSFER = 1 << 30;
+
+/**
+ * Stream owning its stream buffer.
+ */
+template <class Stream, class Buffer>
+class OwningStream : public Stream
+{
+public:
+	explicit OwningStream(int fd) : Stream(nullptr), buffer(fd) {
+		this->rdbuf(&buffer);
+	}
+private:
+	Buffer buffer;
+};
+
+}
+
+std::size_t FdInputBuf::readSome(char* s, std::size_t n) {
+	for (;;) {
+		auto ret = read(fd, s, static_cast<unsigned>(std::min(n, MAX_TRANSFER)));
+		if (ret >= 0)
+			return static_cast<std::size_t>(ret);
+		// error isn't end of input, istream sets badbit when buffer throws
+		if (errno != EINTR)
+			throw std::runtime_error(std::string("FdInputBuf: unable to read: ") + std::strerror(errno));
+	}
+}
+
+FdInputBuf::int_type FdInputBuf::underflow() {
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	auto n = readSome(buffer.data(), buffer.size());
+	if (n == 0)
+		return traits_type::eof();
+
+	setg(buffer.data(), buffer.data(), buffer.data() + n);
+	return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize FdInputBuf::xsgetn(char* s, std::streamsize n) {
+	std::streamsize total = 0;
+	while (total < n) {
+		// serve buffered data first
+		auto buffered = egptr() - gptr();
+		if (buffered > 0) {
+			auto count = std::min<std::streamsize>(buffered, n - total);
+			std::memcpy(s + total, gptr(), static_cast<std::size_t>(count));
+			gbump(static_cast<int>(count));
+			total += count;
+			continue;
+		}
+
+		// large requests go directly to caller memory
+		if (n - total >= static_cast<std::streamsize>(buffer.size())) {
+			auto count = readSome(s + total, static_cast<std::size_t>(n - total));
+			if (count == 0)
+				break;
+			total += count;
+		} else if (traits_type::eq_int_type(underflow(), traits_type::eof()))
+			break;
+	}
+	return total;
+}
+
+bool FdOutputBuf::writeAll(const char* s, std::size_t n) {
+	while (n > 0) {
+		auto ret = write(fd, s, static_cast<unsigned>(std::min(n, MAX_TRANSFER)));
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		s += ret;
+		n -= static_cast<std::size_t>(ret);
+	}
+	return true;
+}
+
+int FdOutputBuf::sync() {
+	auto n = static_cast<std::size_t>(pptr() - pbase());
+	setp(buffer.data(), buffer.data() + buffer.size());
+	return writeAll(buffer.data(), n) ? 0 : -1;
+}
+
+FdOutputBuf::int_type FdOutputBuf::overflow(int_type c) {
+	if (sync() != 0)
+		return traits_type::eof();
+
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+		return sputc(traits_type::to_char_type(c));
+	return traits_type::not_eof(c);
+}
+
+std::streamsize FdOutputBuf::xsputn(const char* s, std::streamsize n) {
+	// small writes are buffered
+	if (n < epptr() - pptr()) {
+		std::memcpy(pptr(), s, static_cast<std::size_t>(n));
+		pbump(static_cast<int>(n));
+		return n;
+	}
+
+	if (sync() != 0 || !writeAll(s, static_cast<std::size_t>(n)))
+		return 0;
+	return n;
+}
+
+std::unique_ptr<std::istream> openInputStream(const std::string& path) {
+	if (path == "-") {
+#ifdef _WIN32
+		_setmode(STDIN_FD, _O_BINARY);
+#endif // _WIN32
+		return std::unique_ptr<std::istream>(new OwningStream<std::istream, FdInputBuf>(STDIN_FD));
+	}
+	return std::unique_ptr<std::istream>(new std::ifstream(path.c_str(), std::ios_base::binary));
+}
+
+std::unique_ptr<std::ostream> openOutputStream(const std::string& path) {
+	if (path == "-") {
+#ifdef _WIN32
+		_setmode(STDOUT_FD, _O_BINARY);
+#endif // _WIN32
+		return std::unique_ptr<std::ostream>(new OwningStream<std::ostream, FdOutputBuf>(STDOUT_FD));
+	}
+	return std::unique_ptr<std::ostream>(new std::ofstream(path.c_str(), std::ios_base::binary));
+}
+
+std::unique_ptr<std::ostream> openTruncatedStream(const std::string& path, uint64_t size) {
+	std::unique_ptr<std::ostream> stream(new std::ofstream(path.c_str(), std::ios_base::binary | std::ios_base::app));
+#ifdef _WIN32
+	int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+	bool truncated = fd >= 0 && _chsize_s(fd, static_cast<__int64>(size)) == 0;
+	if (fd >= 0)
+		_close(fd);
+#else
+	bool truncated = truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif // _WIN32
+	if (!truncated)
+		stream->setstate(std::ios_base::failbit);
+	return stream;
+}
+
+std::vector<FileExtent> findDataExtents(const std::string& path, uint64_t& size, uint64_t minHole) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		throw std::runtime_error("Unable to open input file: " + path);
+	size = static_cast<uint64_t>(st.st_size);
+
+	FileExtent whole = { 0, size };
+	std::vector<FileExtent> extents;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	if ((st.st_mode & S_IFMT) != S_IFREG || size == 0)
+		return std::vector<FileExtent>(1, whole);
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("Unable to open input file: " + path);
+
+	auto end = static_cast<off_t>(size);
+	for (off_t position = 0; position < end; ) {
+		auto data = lseek(fd, position, SEEK_DATA);
+		if (data < 0) {
+			// ENXIO means rest of file is hole, other errors mean holes aren't supported
+			if (errno != ENXIO)
+				extents.assign(1, whole);
+			break;
+		}
+		auto hole = lseek(fd, data, SEEK_HOLE);
+		if (hole < 0 || hole > end)
+			hole = end;
+		FileExtent extent = { static_cast<uint64_t>(data), static_cast<uint64_t>(hole - data) };
+		// hole before extent is too short, it's read as zeros
+		uint64_t previousEnd = extents.empty() ? 0 : extents.back().offset + extents.back().length;
+		if (extent.offset - previousEnd < minHole) {
+			if (extents.empty())
+				extents.push_back(FileExtent());
+			extents.back().length = extent.offset + extent.length - extents.back().offset;
+		} else
+			extents.push_back(extent);
+		position = hole;
+	}
+	close(fd);
+
+	uint64_t lastEnd = extents.empty() ? 0 : extents.back().offset + extents.back().length;
+	if (size - lastEnd < minHole) {
+		if (extents.empty())
+			extents.push_back(FileExtent());
+		extents.back().length = size - extents.back().offset;
+	}
+#else
+	extents.push_back(whole);
+#endif // SEEK_DATA && SEEK_HOLE
+	return extents;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file fdstream.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef FD_STREAM_H
+#define FD_STREAM_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * Input stream buffer reading directly from file descriptor.
+ * Unlike std::cin there is no synchronization with stdio, reads are done in large
+ * chunks and return as soon as some data is available, so stream can be consumed
+ * while producer is still writing to pipe.
+ */
+class FdInputBuf : public std::streambuf
+{
+public:
+	static const std::size_t BUFFER_SIZE = 1 << 18;
+
+	explicit FdInputBuf(int fd) : fd(fd), buffer(BUFFER_SIZE) { }
+protected:
+	virtual int_type underflow();
+	virtual std::streamsize xsgetn(char* s, std::streamsize n);
+private:
+	/**
+	 * read which retries on interrupt.
+	 * @return number of bytes read, 0 at end of input
+	 * @throws std::runtime_error when read fails
+	 */
+	std::size_t readSome(char* s, std::size_t n);
+
+	int fd;
+	std::vector<char> buffer;
+};
+
+/**
+ * Output stream buffer writing directly to file descriptor.
+ * Large writes bypass internal buffer.
+ */
+class FdOutputBuf : public std::streambuf
+{
+public:
+	static const std::size_t BUFFER_SIZE = 1 << 18;
+
+	explicit FdOutputBuf(int fd) : fd(fd), buffer(BUFFER_SIZE) {
+		setp(buffer.data(), buffer.data() + buffer.size());
+	}
+
+	~FdOutputBuf() {
+		sync();
+	}
+protected:
+	virtual int_type overflow(int_type c);
+	virtual std::streamsize xsputn(const char* s, std::streamsize n);
+	virtual int sync();
+private:
+	/// writes all data, retries on interrupt and partial writes
+	bool writeAll(const char* s, std::size_t n);
+
+	int fd;
+	std::vector<char> buffer;
+};
+
+/**
+ * Opens file for binary reading.
+ * @param path file name, "-" means standard input
+ * @return stream, caller checks its state to find out if opening succeeded
+ */
+std::unique_ptr<std::istream> openInputStream(const std::string& path);
+
+/**
+ * Opens file for binary writing.
+ * @param path file name, "-" means standard output
+ * @return stream, caller checks its state to find out if opening succeeded
+ */
+std::unique_ptr<std::ostream> openOutputStream(const std::string& path);
+
+/**
+ * Cuts existing file to size and opens it for binary writing at its end.
+ * @return stream, caller checks its state to find out if opening succeeded
+ */
+std::unique_ptr<std::ostream> openTruncatedStream(const std::string& path, uint64_t size);
+
+/**
+ * Range of file with data, bytes between ranges are holes which read as zeros.
+ */
+struct FileExtent
+{
+	uint64_t offset;
+	uint64_t length;
+};
+
+/**
+ * Finds ranges of file with data by SEEK_DATA and SEEK_HOLE.
+ * When holes can't be found (system or file system without them, special files),
+ * whole file is one range.
+ * @param path file name
+ * @param minHole holes shorter than this are joined with data around them, so small holes
+ *        don't split data to many short ranges
+ * @retval size size of file
+ * @return ranges with data in order of offsets
+ * @throws std::runtime_error when file can't be opened
+ */
+std::vector<FileExtent> findDataExtents(const std::string& path, uint64_t& size, uint64_t minHole = 0);
+
+#endif // !FD_STREAM_H
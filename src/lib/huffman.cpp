@@ -0,0 +1,250 @@
+/**
+ * @file huffman.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "huffman.h"
+
+#include <queue>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+/// Bits used for number of symbols in code lengths header
+const unsigned SYMBOL_COUNT_BITS = 17;
+/// Bits used for code length in code lengths header
+const unsigned LENGTH_BITS = 5;
+
+uint32_t reverseBits(uint32_t code, unsigned length) {
+	uint32_t result = 0;
+	for (unsigned i = 0; i < length; ++i) {
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return result;
+}
+
+/// Computes lengths of Huffman code without length limit
+std::vector<uint8_t> huffmanLengths(const std::vector<uint32_t>& freqs) {
+	typedef std::pair<uint64_t, size_t> Node;		// weight and node index
+	std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+
+	// leaves are first freqs.size() nodes, inner nodes follow
+	std::vector<size_t> parent(freqs.size());
+	for (size_t i = 0; i < freqs.size(); ++i) {
+		if (freqs[i] > 0)
+			queue.push(Node(freqs[i], i));
+	}
+
+	std::vector<uint8_t> lengths(freqs.size());
+	if (queue.size() == 1) {
+		lengths[queue.top().second] = 1;
+		return lengths;
+	}
+
+	while (queue.size() > 1) {
+		auto first = queue.top();
+		queue.pop();
+		auto second = queue.top();
+		queue.pop();
+
+		size_t node = parent.size();
+		parent.push_back(node);
+		parent[first.second] = node;
+		parent[second.second] = node;
+		queue.push(Node(first.first + second.first, node));
+	}
+
+	// inner nodes have larger index than their children, so depths are computed from root down
+	std::vector<size_t> depth(parent.size());
+	for (size_t node = parent.size(); node-- > freqs.size(); )
+		depth[node] = parent[node] == node ? 0 : depth[parent[node]] + 1;
+	for (size_t i = 0; i < freqs.size(); ++i) {
+		if (freqs[i] > 0)
+			lengths[i] = static_cast<uint8_t>(std::min<size_t>(depth[parent[i]] + 1, UINT8_MAX));
+	}
+	return lengths;
+}
+
+}
+
+const unsigned HuffmanCode::MAX_LENGTH;
+const unsigned HuffmanDecoder::TABLE_BITS;
+
+std::vector<uint8_t> HuffmanCode::buildLengths(const std::vector<uint32_t>& freqs) {
+	auto scaled = freqs;
+	for (;;) {
+		auto lengths = huffmanLengths(scaled);
+		if (lengths.empty() || *std::max_element(lengths.begin(), lengths.end()) <= MAX_LENGTH)
+			return lengths;
+
+		// flatten distribution, used symbols keep nonzero frequency
+		for (auto& freq : scaled) {
+			if (freq > 0)
+				freq = (freq >> 1) | 1;
+		}
+	}
+}
+
+HuffmanCode::HuffmanCode(std::vector<uint8_t> lengths) : lengths(std::move(lengths)), codes(this->lengths.size()) {
+	uint32_t lengthCount[MAX_LENGTH + 1] = {0};
+	for (auto length : this->lengths) {
+		if (length > MAX_LENGTH)
+			throw std::runtime_error("HuffmanCode: code length over maximum");
+		lengthCount[length]++;
+	}
+	lengthCount[0] = 0;
+
+	uint32_t nextCode[MAX_LENGTH + 1] = {0};
+	uint32_t code = 0;
+	for (unsigned length = 1; length <= MAX_LENGTH; ++length) {
+		code = (code + lengthCount[length - 1]) << 1;
+		nextCode[length] = code;
+		if (lengthCount[length] > 0 && code + lengthCount[length] > (1U << length))
+			throw std::runtime_error("HuffmanCode: code lengths don't form prefix code");
+	}
+
+	for (size_t symbol = 0; symbol < this->lengths.size(); ++symbol) {
+		auto length = this->lengths[symbol];
+		if (length > 0)
+			codes[symbol] = reverseBits(nextCode[length]++, length);
+	}
+}
+
+void HuffmanCode::writeLengths(BitStreamWriter& writer) const {
+	// trailing unused symbols are not written
+	size_t count = lengths.size();
+	while (count > 0 && lengths[count - 1] == 0)
+		count--;
+	writer.writeBits(count, SYMBOL_COUNT_BITS);
+
+	// lengths of neighbouring LZW codes are mostly the same, so only changes are stored
+	uint8_t previous = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (lengths[i] == previous) {
+			writer.writeBit(false);
+		} else {
+			writer.writeBit(true);
+			writer.writeBits(lengths[i], LENGTH_BITS);
+			previous = lengths[i];
+		}
+	}
+}
+
+bool HuffmanCode::readLengths(BitStreamReader& reader, std::vector<uint8_t>& lengths) {
+	size_t count;
+	if (!reader.readBits(SYMBOL_COUNT_BITS, count))
+		return false;
+
+	lengths.resize(count);
+	uint8_t previous = 0;
+	for (auto& length : lengths) {
+		bool changed;
+		if (!reader.readBit(changed))
+			return false;
+		if (changed) {
+			size_t value;
+			if (!reader.readBits(LENGTH_BITS, value))
+				return false;
+			previous = static_cast<uint8_t>(value);
+		}
+		length = previous;
+	}
+	return true;
+}
+
+HuffmanDecoder::HuffmanDecoder(const std::vector<uint8_t>& lengths, size_t pairLimit) : table(1 << TABLE_BITS) {
+	// validates lengths and gives bit reversed codes
+	HuffmanCode code(lengths);
+
+	std::fill(lengthCount, lengthCount + HuffmanCode::MAX_LENGTH + 1, 0);
+	for (auto length : lengths)
+		lengthCount[length]++;
+	lengthCount[0] = 0;
+
+	uint32_t first = 0, index = 0;
+	for (unsigned length = 1; length <= HuffmanCode::MAX_LENGTH; ++length) {
+		first = (first + lengthCount[length - 1]) << 1;
+		firstCode[length] = first;
+		firstIndex[length] = index;
+		index += lengthCount[length];
+	}
+	firstCode[0] = firstIndex[0] = 0;
+
+	sortedSymbols.resize(index);
+	std::vector<uint32_t> next(firstIndex, firstIndex + HuffmanCode::MAX_LENGTH + 1);
+	for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+		if (lengths[symbol] > 0)
+			sortedSymbols[next[lengths[symbol]]++] = static_cast<uint32_t>(symbol);
+	}
+
+	// entries of short codes, code is in low bits of index because stream is read from LSB
+	for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+		unsigned length = lengths[symbol];
+		if (length == 0 || length > TABLE_BITS)
+			continue;
+
+		for (uint32_t index = code.streamCode(symbol); index < table.size(); index += 1U << length) {
+			auto& entry = table[index];
+			entry.symbols[0] = static_cast<uint32_t>(symbol);
+			entry.count = 1;
+			entry.length = entry.totalLength = static_cast<uint8_t>(length);
+		}
+	}
+
+	// second code of entry is found in single code entries by remaining bits
+	auto single = table;
+	for (uint32_t index = 0; index < table.size(); ++index) {
+		auto& entry = table[index];
+		if (entry.count == 0 || entry.symbols[0] >= pairLimit)
+			continue;
+
+		auto& second = single[index >> entry.length];
+		if (second.count == 1 && entry.length + second.length <= TABLE_BITS) {
+			entry.symbols[1] = second.symbols[0];
+			entry.count = 2;
+			entry.totalLength = static_cast<uint8_t>(entry.length + second.length);
+		}
+	}
+}
+
+size_t HuffmanDecoder::decode(BitStreamReader& reader, uint32_t* symbols, size_t room) {
+	uint32_t index;
+	// near end of stream there is less than TABLE_BITS bits
+	if (reader.peekCodes(TABLE_BITS, 1, &index) == 0)
+		return decodeSlow(reader, symbols);
+
+	auto& entry = table[index];
+	if (entry.count == 0)
+		return decodeSlow(reader, symbols);
+
+	symbols[0] = entry.symbols[0];
+	if (entry.count == 2 && room >= 2) {
+		symbols[1] = entry.symbols[1];
+		reader.skipBits(entry.totalLength);
+		return 2;
+	}
+	reader.skipBits(entry.length);
+	return 1;
+}
+
+size_t HuffmanDecoder::decodeSlow(BitStreamReader& reader, uint32_t* symbols) {
+	uint32_t code = 0;
+	for (unsigned length = 1; length <= HuffmanCode::MAX_LENGTH; ++length) {
+		bool bit;
+		if (!reader.readBit(bit))
+			return 0;
+		code = (code << 1) | (bit ? 1 : 0);
+
+		// codes of same length are consecutive numbers starting at firstCode
+		if (code - firstCode[length] < lengthCount[length]) {
+			symbols[0] = sortedSymbols[firstIndex[length] + code - firstCode[length]];
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file huffman.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include "bitstream.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Canonical Huffman code with limited code length.
+ * Code is fully described by code lengths of symbols, codes of same length are
+ * assigned in order of symbols. Codes are written from their MSB.
+ */
+class HuffmanCode
+{
+public:
+	/// Maximum code length, enough for 2^16 + 1 symbols
+	static const unsigned MAX_LENGTH = 20;
+
+	/**
+	 * Computes code lengths from symbol frequencies.
+	 * When some code is longer than MAX_LENGTH, frequencies are halved until all codes fit.
+	 * @param freqs frequency of every symbol, symbols with zero frequency get no code
+	 * @return code length of every symbol
+	 */
+	static std::vector<uint8_t> buildLengths(const std::vector<uint32_t>& freqs);
+
+	/**
+	 * Constructs code from code lengths.
+	 * @throws std::runtime_error when lengths don't describe valid prefix code
+	 */
+	explicit HuffmanCode(std::vector<uint8_t> lengths);
+
+	/// Writes code lengths so decoder can build the same code
+	void writeLengths(BitStreamWriter& writer) const;
+
+	/**
+	 * Reads code lengths written by writeLengths.
+	 * @return false when stream ended
+	 */
+	static bool readLengths(BitStreamReader& reader, std::vector<uint8_t>& lengths);
+
+	void write(BitStreamWriter& writer, size_t symbol) const {
+		writer.writeBits(codes[symbol], lengths[symbol]);
+	}
+
+	/// Code of symbol in order its bits are stored in stream, first bit is LSB
+	uint32_t streamCode(size_t symbol) const {
+		return codes[symbol];
+	}
+
+	const std::vector<uint8_t>& codeLengths() const {
+		return lengths;
+	}
+private:
+	std::vector<uint8_t> lengths;
+	std::vector<uint32_t> codes;		/// bit reversed codes so they are written from MSB
+};
+
+/**
+ * Table driven decoder of canonical Huffman code.
+ * Lookup table is indexed by next TABLE_BITS bits of stream. When two codes fit
+ * to these bits, one lookup resolves both. Longer codes are decoded bit by bit.
+ */
+class HuffmanDecoder
+{
+public:
+	static const unsigned TABLE_BITS = 12;
+
+	/**
+	 * Builds decoding tables.
+	 * @param lengths code lengths of symbols
+	 * @param pairLimit only symbols below this can be first of two symbols resolved
+	 *        by one lookup, symbols followed by other data in stream must not be paired
+	 * @throws std::runtime_error when lengths don't describe valid prefix code
+	 */
+	explicit HuffmanDecoder(const std::vector<uint8_t>& lengths, size_t pairLimit = SIZE_MAX);
+
+	/**
+	 * Decodes one or two symbols.
+	 * @param reader stream to decode
+	 * @retval symbols decoded symbols
+	 * @param room maximum number of symbols decoded, at least 1
+	 * @return number of decoded symbols, 0 at end of stream or on invalid code
+	 */
+	size_t decode(BitStreamReader& reader, uint32_t* symbols, size_t room);
+private:
+	struct Entry
+	{
+		uint32_t symbols[2];
+		uint8_t count;			/// number of symbols resolved by entry, 0 for long codes
+		uint8_t length;			/// length of first code
+		uint8_t totalLength;	/// length of both codes
+	};
+
+	/// Decodes code longer than TABLE_BITS bit by bit
+	size_t decodeSlow(BitStreamReader& reader, uint32_t* symbols);
+
+	std::vector<Entry> table;
+
+	// canonical code description used by slow decoding
+	std::vector<uint32_t> sortedSymbols;
+	uint32_t firstCode[HuffmanCode::MAX_LENGTH + 1];
+	uint32_t lengthCount[HuffmanCode::MAX_LENGTH + 1];
+	uint32_t firstIndex[HuffmanCode::MAX_LENGTH + 1];
+};
+
+#endif // !HUFFMAN_H
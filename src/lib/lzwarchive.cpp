@@ -0,0 +1,334 @@
+/**
+ * @file lzwarchive.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "lzwarchive.h"
+#include "byteorder.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <mutex>
+#include <algorithm>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#endif // _WIN32
+
+namespace {
+
+const char ARCHIVE_MAGIC[3] = { 'L', 'Z', 'A' };
+const char INDEX_MARK[4] = { 'L', 'Z', 'A', 'I' };
+const size_t TRAILER_SIZE = sizeof(uint64_t) + sizeof(INDEX_MARK);
+/// Path length, file size and part count
+const uint64_t MIN_ENTRY_SIZE = sizeof(uint16_t) + sizeof(uint64_t) + sizeof(uint32_t);
+/// Offset, stored and raw size
+const uint64_t PART_ENTRY_SIZE = 3 * sizeof(uint64_t);
+
+struct InputFile
+{
+	std::string diskPath;
+	std::string archivePath;
+};
+
+bool isDirectory(const std::string& path) {
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+std::vector<std::string> listDirectory(const std::string& path) {
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+	if (handle == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Unable to read directory: " + path);
+	do {
+		names.push_back(data.cFileName);
+	} while (FindNextFileA(handle, &data));
+	FindClose(handle);
+#else
+	DIR* dir = opendir(path.c_str());
+	if (dir == nullptr)
+		throw std::runtime_error("Unable to read directory: " + path);
+	while (dirent* entry = readdir(dir))
+		names.push_back(entry->d_name);
+	closedir(dir);
+#endif // _WIN32
+
+	names.erase(std::remove_if(names.begin(), names.end(), [] (const std::string& name) {
+		return name == "." || name == "..";
+	}), names.end());
+	// sorted so archive content doesn't depend on directory order
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+/// True when extracted path can't escape output directory
+bool isSafeEntryPath(const std::string& path) {
+	if (path.empty() || path[0] == '/' || path.find(':') != std::string::npos)
+		return false;
+
+	std::istringstream components(path);
+	std::string component;
+	while (std::getline(components, component, '/')) {
+		if (component == "..")
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Path as stored in archive, relative with '/' separators, empty and "." components are dropped.
+ * @throws std::runtime_error when path can't be extracted again, so it isn't archived
+ */
+std::string archivePathOf(std::string path) {
+	std::replace(path.begin(), path.end(), '\\', '/');
+
+	std::istringstream components(path);
+	std::string component, normalized;
+	while (std::getline(components, component, '/')) {
+		if (component.empty() || component == ".")
+			continue;
+		if (!normalized.empty())
+			normalized += '/';
+		normalized += component;
+	}
+
+	if (!isSafeEntryPath(normalized))
+		throw std::runtime_error("Path can't be stored in archive: " + path);
+	if (normalized.size() > UINT16_MAX)
+		throw std::runtime_error("Path is too long for archive: " + path);
+	return normalized;
+}
+
+void collectFiles(const std::string& diskPath, std::vector<InputFile>& files) {
+	if (isDirectory(diskPath)) {
+		for (auto& name : listDirectory(diskPath))
+			collectFiles(diskPath + "/" + name, files);
+	} else {
+		InputFile file;
+		file.diskPath = diskPath;
+		file.archivePath = archivePathOf(diskPath);
+		files.push_back(file);
+	}
+}
+
+/// Checks that extracted path can't escape output directory
+void checkEntryPath(const std::string& path) {
+	if (!isSafeEntryPath(path))
+		throw std::runtime_error("Archive contains invalid path: " + path);
+}
+
+void makeDirectories(const std::string& path) {
+	for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+		auto dir = path.substr(0, pos);
+		if (isDirectory(dir))
+			continue;
+#ifdef _WIN32
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0777);
+#endif // _WIN32
+	}
+}
+
+uint64_t fileSize(const std::string& path) {
+	std::ifstream file(path.c_str(), std::ios_base::binary | std::ios_base::ate);
+	if (!file)
+		throw std::runtime_error("Unable to open input file: " + path);
+	return static_cast<uint64_t>(file.tellg());
+}
+
+}
+
+const uint8_t LzwArchive::VERSION;
+const uint64_t LzwArchive::PART_SIZE;
+
+void LzwArchive::create(const std::string& archivePath, const std::vector<std::string>& inputs,
+		LzwMethod method, ThreadPool& pool, size_t memoryLimit) {
+	std::vector<InputFile> files;
+	for (auto& input : inputs)
+		collectFiles(input, files);
+
+	std::ofstream archive(archivePath.c_str(), std::ios_base::binary);
+	if (!archive)
+		throw std::runtime_error("Unable to open output file: " + archivePath);
+	archive.write(ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+	archive.put(static_cast<char>(VERSION));
+
+	std::vector<ArchiveEntry> entries(files.size());
+	std::mutex archiveMutex;
+
+	// one task per file which splits file to parts and spawns task for each of them,
+	// parts of large files are stolen by idle workers
+	for (size_t i = 0; i < files.size(); ++i) {
+		pool.submit([&, i] () {
+			auto& entry = entries[i];
+			entry.path = files[i].archivePath;
+			entry.size = fileSize(files[i].diskPath);
+			entry.parts.resize(std::max<uint64_t>(1, (entry.size + PART_SIZE - 1) / PART_SIZE));
+
+			for (size_t p = 0; p < entry.parts.size(); ++p) {
+				pool.submit([&, i, p] () {
+					auto& entry = entries[i];
+					uint64_t begin = p * PART_SIZE;
+					auto size = static_cast<size_t>(std::min(PART_SIZE, entry.size - begin));
+
+					std::vector<char> data(size);
+					std::ifstream file(files[i].diskPath.c_str(), std::ios_base::binary);
+					file.seekg(begin);
+					if (size > 0 && !file.read(data.data(), size))
+						throw std::runtime_error("Unable to read input file: " + files[i].diskPath);
+
+					std::ostringstream coded;
+					LzwBlockWriter writer(&coded, method, LzwBlockWriter::DEFAULT_BLOCK_SIZE, memoryLimit);
+					writer.write(data.data(), data.size());
+					writer.close();
+					auto stream = coded.str();
+
+					std::lock_guard<std::mutex> lock(archiveMutex);
+					auto& part = entry.parts[p];
+					part.offset = static_cast<uint64_t>(archive.tellp());
+					part.storedSize = stream.size();
+					part.rawSize = size;
+					if (!archive.write(stream.data(), stream.size()))
+						throw std::runtime_error("Unable to write output file: " + archivePath);
+				});
+			}
+		});
+	}
+	pool.wait();
+
+	auto indexOffset = static_cast<uint64_t>(archive.tellp());
+	writeLittleEndian<uint32_t>(archive, static_cast<uint32_t>(entries.size()));
+	for (auto& entry : entries) {
+		// length was checked by archivePathOf
+		writeLittleEndian<uint16_t>(archive, static_cast<uint16_t>(entry.path.size()));
+		archive.write(entry.path.data(), entry.path.size());
+		writeLittleEndian<uint64_t>(archive, entry.size);
+		writeLittleEndian<uint32_t>(archive, static_cast<uint32_t>(entry.parts.size()));
+		for (auto& part : entry.parts) {
+			writeLittleEndian<uint64_t>(archive, part.offset);
+			writeLittleEndian<uint64_t>(archive, part.storedSize);
+			writeLittleEndian<uint64_t>(archive, part.rawSize);
+		}
+	}
+	writeLittleEndian<uint64_t>(archive, indexOffset);
+	archive.write(INDEX_MARK, sizeof(INDEX_MARK));
+
+	if (!archive.flush())
+		throw std::runtime_error("Unable to write output file: " + archivePath);
+}
+
+std::vector<ArchiveEntry> LzwArchive::readIndex(const std::string& archivePath) {
+	std::ifstream archive(archivePath.c_str(), std::ios_base::binary);
+	if (!archive)
+		throw std::runtime_error("Unable to open input file: " + archivePath);
+
+	char header[4] = {0};
+	archive.read(header, 4);
+	if (!std::equal(ARCHIVE_MAGIC, ARCHIVE_MAGIC + sizeof(ARCHIVE_MAGIC), header))
+		throw std::runtime_error("Bad archive header magic string.");
+	if (static_cast<uint8_t>(header[3]) != VERSION)
+		throw std::runtime_error("Unsupported archive version.");
+
+	// only trailer and index are read, part streams are skipped
+	if (!archive.seekg(-static_cast<std::streamoff>(TRAILER_SIZE), std::ios_base::end))
+		throw std::runtime_error("Archive index not found.");
+	auto trailerOffset = static_cast<uint64_t>(archive.tellg());
+	auto indexOffset = readLittleEndian<uint64_t>(archive);
+	char mark[sizeof(INDEX_MARK)];
+	archive.read(mark, sizeof(mark));
+	if (!archive || !std::equal(INDEX_MARK, INDEX_MARK + sizeof(INDEX_MARK), mark))
+		throw std::runtime_error("Archive index not found.");
+	if (indexOffset < sizeof(header) || indexOffset > trailerOffset)
+		throw std::runtime_error("Archive index offset is out of archive.");
+
+	// counts are checked against index size, so corrupted index can't cause huge allocation
+	auto indexSize = trailerOffset - indexOffset;
+	archive.seekg(indexOffset);
+	auto entryCount = readLittleEndian<uint32_t>(archive);
+	if (entryCount > indexSize / MIN_ENTRY_SIZE)
+		throw std::runtime_error("Archive index entry count exceeds index size.");
+
+	std::vector<ArchiveEntry> entries(entryCount);
+	for (auto& entry : entries) {
+		entry.path.resize(readLittleEndian<uint16_t>(archive));
+		if (!entry.path.empty() && !archive.read(&entry.path[0], entry.path.size()))
+			throw std::runtime_error("Unexpected end of archive index.");
+		entry.size = readLittleEndian<uint64_t>(archive);
+
+		auto partCount = readLittleEndian<uint32_t>(archive);
+		if (partCount > indexSize / PART_ENTRY_SIZE)
+			throw std::runtime_error("Archive index part count exceeds index size.");
+		entry.parts.resize(partCount);
+
+		uint64_t rawSize = 0;
+		for (auto& part : entry.parts) {
+			part.offset = readLittleEndian<uint64_t>(archive);
+			part.storedSize = readLittleEndian<uint64_t>(archive);
+			part.rawSize = readLittleEndian<uint64_t>(archive);
+			if (part.offset < sizeof(header) || part.offset > indexOffset
+				|| part.storedSize > indexOffset - part.offset || part.rawSize > PART_SIZE)
+				throw std::runtime_error("Archive part is out of archive: " + entry.path);
+			rawSize += part.rawSize;
+		}
+		if (rawSize != entry.size)
+			throw std::runtime_error("Archive entry size mismatch: " + entry.path);
+	}
+	if (static_cast<uint64_t>(archive.tellg()) != trailerOffset)
+		throw std::runtime_error("Archive index size mismatch.");
+	return entries;
+}
+
+void LzwArchive::extract(const std::string& archivePath, const std::string& outputDir, ThreadPool& pool,
+		size_t memoryLimit) {
+	auto entries = readIndex(archivePath);
+	for (auto& entry : entries)
+		checkEntryPath(entry.path);
+
+	for (auto& entry : entries) {
+		auto outPath = outputDir.empty() ? entry.path : outputDir + "/" + entry.path;
+		makeDirectories(outPath);
+
+		// create file first, parts are then written to their positions independently
+		{
+			std::ofstream out(outPath.c_str(), std::ios_base::binary);
+			if (!out)
+				throw std::runtime_error("Unable to open output file: " + outPath);
+		}
+
+		uint64_t rawOffset = 0;
+		for (auto& part : entry.parts) {
+			pool.submit([&archivePath, outPath, part, rawOffset, memoryLimit] () {
+				std::ifstream archive(archivePath.c_str(), std::ios_base::binary);
+				archive.seekg(part.offset);
+				std::string stream(static_cast<size_t>(part.storedSize), '\0');
+				if (!archive.read(&stream[0], stream.size()))
+					throw std::runtime_error("Unexpected end of archive: " + archivePath);
+
+				std::istringstream in(stream);
+				std::ostringstream decoded;
+				decompressLzwStream(in, decoded, memoryLimit);
+				auto data = decoded.str();
+				if (data.size() != part.rawSize)
+					throw std::runtime_error("Archive part size mismatch: " + outPath);
+
+				std::fstream out(outPath.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+				out.seekp(rawOffset);
+				if (!out.write(data.data(), data.size()))
+					throw std::runtime_error("Unable to write output file: " + outPath);
+			});
+			rawOffset += part.rawSize;
+		}
+	}
+	pool.wait();
+}
@@ -0,0 +1,83 @@
+/**
+ * @file lzwarchive.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef LZW_ARCHIVE_H
+#define LZW_ARCHIVE_H
+
+#include "lzwblock.h"
+#include "threadpool.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Part of archived file. Every part is complete LZW block stream so it can be
+ * decompressed on its own.
+ */
+struct ArchivePart
+{
+	uint64_t offset;		/// position of part stream in archive
+	uint64_t storedSize;	/// size of part stream in archive
+	uint64_t rawSize;		/// size of decompressed part
+};
+
+/**
+ * Entry of archive central index.
+ */
+struct ArchiveEntry
+{
+	std::string path;		/// relative path with '/' separators
+	uint64_t size;			/// size of whole file
+	std::vector<ArchivePart> parts;
+};
+
+/**
+ * Archive of many files compressed by LZW.
+ *
+ * Layout is: header "LZA" + version, part streams in order they were finished,
+ * central index and trailer with index offset and "LZAI" mark. Index at the end allows
+ * writing archive in one pass while listing reads only index.
+ */
+class LzwArchive
+{
+public:
+	static const uint8_t VERSION = 1;
+	/// Files larger than this are split to more parts which are compressed in parallel
+	static const uint64_t PART_SIZE = 4 << 20;
+
+	/**
+	 * Compresses files and directory trees to new archive.
+	 * @param archivePath archive to create
+	 * @param inputs files and directories to pack, directories are walked recursively
+	 * @param method coding method for parts
+	 * @param pool pool compressing parts
+	 * @param memoryLimit dictionary memory limit of every part, see LzwEncoder
+	 * @throws std::runtime_error on I/O error
+	 */
+	static void create(const std::string& archivePath, const std::vector<std::string>& inputs,
+		LzwMethod method, ThreadPool& pool, size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	/**
+	 * Reads central index of archive.
+	 * @throws std::runtime_error when archive is malformed
+	 */
+	static std::vector<ArchiveEntry> readIndex(const std::string& archivePath);
+
+	/**
+	 * Extracts all files of archive.
+	 * @param archivePath archive to extract
+	 * @param outputDir directory where files are created, missing directories are created too
+	 * @param pool pool decompressing parts
+	 * @param memoryLimit dictionary memory limit, parts needing more fail
+	 * @throws std::runtime_error on I/O error or malformed archive
+	 */
+	static void extract(const std::string& archivePath, const std::string& outputDir, ThreadPool& pool,
+		size_t memoryLimit = MemoryBudget::UNLIMITED);
+};
+
+#endif // !LZW_ARCHIVE_H
@@ -0,0 +1,141 @@
+/**
+ * @file lzwbatch.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "lzwbatch.h"
+#include "memstream.h"
+
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/// Records up to this size are one block, so stored block bounds the output
+const size_t BATCH_BLOCK_SIZE = LzwBlockWriter::DEFAULT_BLOCK_SIZE;
+/// Stream header, block header and end block
+const size_t STREAM_OVERHEAD = 4 + 10 + 1;
+
+}
+
+struct LzwBatchCodec::Context
+{
+	Context(LzwMethod method, size_t memoryLimit)
+		: output(&outputBuf), input(&inputBuf), writer(&output, method, BATCH_BLOCK_SIZE, memoryLimit),
+		reader(&input, memoryLimit) {
+		// writer starts with stream header which is written again for every record
+		detach();
+	}
+
+	/// Closes writer without writing to any record, so it can be reset to next one
+	void detach() {
+		outputBuf.reset(nullptr, 0);
+		try {
+			writer.close();
+		} catch (std::exception&) {
+			// writer is closed even when last block failed
+		}
+		output.clear();
+	}
+
+	MemoryOutputBuf outputBuf;
+	MemoryInputBuf inputBuf;
+	std::ostream output;
+	std::istream input;
+	LzwBlockWriter writer;
+	LzwBlockReader reader;
+};
+
+LzwBatchCodec::LzwBatchCodec(ThreadPool& pool, LzwMethod method, size_t memoryLimit)
+	: pool(pool), method(method), memoryLimit(memoryLimit) {
+	for (size_t i = 0; i < pool.size(); ++i)
+		contexts.emplace_back(new Context(method, memoryLimit));
+}
+
+LzwBatchCodec::~LzwBatchCodec() {
+}
+
+size_t LzwBatchCodec::compressBound(size_t size) {
+	auto blocks = std::max<size_t>((size + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE, 1);
+	return size + STREAM_OVERHEAD + (blocks - 1) * 10;
+}
+
+template <typename Function>
+void LzwBatchCodec::run(size_t count, Function record) {
+	// tasks take records in order, so short and long records are balanced
+	std::atomic<size_t> next(0);
+	for (auto& context : contexts) {
+		auto contextPtr = context.get();
+		pool.submit([contextPtr, count, &next, &record] () {
+			for (size_t i; (i = next++) < count; )
+				record(*contextPtr, i);
+		});
+	}
+	pool.wait();
+}
+
+std::vector<LzwBatchResult> LzwBatchCodec::compress(const std::vector<LzwInputSpan>& inputs,
+	const std::vector<LzwOutputSpan>& outputs) {
+	if (inputs.size() != outputs.size())
+		throw std::runtime_error("LzwBatchCodec: number of inputs and outputs differ");
+
+	std::vector<LzwBatchResult> results(inputs.size());
+	run(inputs.size(), [&] (Context& context, size_t i) {
+		auto& result = results[i];
+		try {
+			context.outputBuf.reset(outputs[i].data, outputs[i].size);
+			context.output.clear();
+			context.writer.reset(&context.output);
+			context.writer.write(inputs[i].data, inputs[i].size);
+			context.writer.close();
+			result.ok = !!context.output;
+			result.size = context.outputBuf.written();
+			if (!result.ok)
+				result.error = "output span too small";
+		} catch (std::exception& e) {
+			result.ok = false;
+			result.size = 0;
+			result.error = e.what();
+			context.detach();
+		}
+	});
+	return results;
+}
+
+std::vector<LzwBatchResult> LzwBatchCodec::decompress(const std::vector<LzwInputSpan>& inputs,
+	const std::vector<LzwOutputSpan>& outputs) {
+	if (inputs.size() != outputs.size())
+		throw std::runtime_error("LzwBatchCodec: number of inputs and outputs differ");
+
+	std::vector<LzwBatchResult> results(inputs.size());
+	run(inputs.size(), [&] (Context& context, size_t i) {
+		auto& result = results[i];
+		try {
+			context.inputBuf.reset(inputs[i].data, inputs[i].size);
+			context.input.clear();
+			context.outputBuf.reset(outputs[i].data, outputs[i].size);
+			context.output.clear();
+
+			// members of multi-member record are decoded one after another
+			do {
+				auto version = readLzwStreamHeader(context.input);
+				if (version != LZW_VERSION_BLOCKS && version != LZW_VERSION_LEVEL)
+					throw std::runtime_error("LzwBatchCodec: record isn't block stream");
+
+				context.reader.reset(&context.input);
+				context.reader.decode(context.output);
+			} while (context.input.peek() != std::char_traits<char>::eof());
+			result.ok = true;
+			result.size = context.outputBuf.written();
+		} catch (std::exception& e) {
+			result.ok = false;
+			result.size = 0;
+			// decoder reports full output as write failure
+			result.error = context.output ? e.what() : "output span too small";
+		}
+	});
+	return results;
+}
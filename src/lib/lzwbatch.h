@@ -0,0 +1,95 @@
+/**
+ * @file lzwbatch.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef LZW_BATCH_H
+#define LZW_BATCH_H
+
+#include "lzwblock.h"
+#include "threadpool.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Memory with input record, owned by caller
+struct LzwInputSpan
+{
+	const char* data;
+	size_t size;
+};
+
+/// Memory for output record, owned by caller
+struct LzwOutputSpan
+{
+	char* data;
+	size_t size;
+};
+
+/// Result of one record of batch
+struct LzwBatchResult
+{
+	bool ok;
+	size_t size;			/// bytes written to output span
+	std::string error;		/// reason of failure when !ok
+};
+
+/**
+ * Compresses and decompresses many small independent records in parallel.
+ * Every record is complete block stream readable by decompressLzwStream.
+ * Every task of pool gets its own codec context (block writer and reader with
+ * their encoder and decoder) which is reset between records instead of being built again.
+ *
+ * Contexts belong to instance and are shared by its compress and decompress calls, so
+ * they must not be called concurrently, not even one compress with one decompress.
+ * Threads calling at the same time need their own instances.
+ */
+class LzwBatchCodec
+{
+public:
+	/**
+	 * @param pool pool running records, must outlive this instance
+	 * @param method method used to compress records
+	 * @param memoryLimit dictionary memory limit of every context, see LzwEncoder
+	 */
+	LzwBatchCodec(ThreadPool& pool, LzwMethod method = LZW_METHOD_VARIABLE,
+		size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	~LzwBatchCodec();
+
+	/// Output size which is always enough for compressed record of input size
+	static size_t compressBound(size_t size);
+
+	/**
+	 * Compresses inputs[i] to outputs[i].
+	 * Record fails when its output span is too small, other records are not affected.
+	 * @return result of every record
+	 */
+	std::vector<LzwBatchResult> compress(const std::vector<LzwInputSpan>& inputs,
+		const std::vector<LzwOutputSpan>& outputs);
+
+	/**
+	 * Decompresses inputs[i] to outputs[i].
+	 * Record fails when it is malformed or its output span is too small.
+	 * @return result of every record
+	 */
+	std::vector<LzwBatchResult> decompress(const std::vector<LzwInputSpan>& inputs,
+		const std::vector<LzwOutputSpan>& outputs);
+private:
+	struct Context;
+
+	/// Runs record(context, i) for every record on pool, each task with its own context
+	template <typename Function>
+	void run(size_t count, Function record);
+
+	ThreadPool& pool;
+	LzwMethod method;
+	size_t memoryLimit;
+	std::vector<std::unique_ptr<Context> > contexts;
+};
+
+#endif // !LZW_BATCH_H
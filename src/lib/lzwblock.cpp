@@ -0,0 +1,949 @@
+/**
+ * @file lzwblock.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "lzwblock.h"
+#include "lzwestimate.h"
+#include "byteorder.h"
+#include "memstream.h"
+#include "bytescan.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+const char LZW_MAGIC[3] = { 'L', 'Z', 'W' };
+
+const double LzwBlockWriter::DEFAULT_AUTO_TOLERANCE = 0.05;
+const size_t LzwBlockWriter::RUN_PROBE;
+const size_t LzwBlockWriter::AUTO_RESELECT_SIZE;
+const size_t LzwCheckpoint::SIZE;
+
+namespace {
+
+/// Size of stream header
+const uint64_t HEADER_SIZE = sizeof(LZW_MAGIC) + 1;
+/// Size of stream header with compression level
+const uint64_t LEVEL_HEADER_SIZE = HEADER_SIZE + 1;
+/// Size of block header
+const size_t BLOCK_HEADER_SIZE = 10;
+/// Flag in window size of dedup block, window starts again
+const uint32_t DEDUP_RESTART = 0x80000000U;
+/// Flag in window size of dedup block, writer flushed after it
+const uint32_t DEDUP_SYNC = 0x40000000U;
+/// Window size in KiB without flags
+const uint32_t DEDUP_WINDOW_MASK = 0x3FFFFFFFU;
+
+/// Dictionary part of memory limit, dedup window takes the rest
+size_t dictionaryLimit(size_t memoryLimit, size_t window) {
+	return memoryLimit == MemoryBudget::UNLIMITED ? memoryLimit : memoryLimit - window;
+}
+
+/// Largest dedup window within memory limit, dictionary keeps the smallest limit of coders
+size_t maxDedupWindow(size_t memoryLimit) {
+	return memoryLimit > MemoryBudget::MIN_LZW_LIMIT ? memoryLimit - MemoryBudget::MIN_LZW_LIMIT : 0;
+}
+
+LzwMethod toMethod(int value) {
+	switch (value) {
+	case LZW_METHOD_VARIABLE:
+	case LZW_METHOD_ARITHMETIC:
+	case LZW_METHOD_HUFFMAN:
+	case LZW_METHOD_BITTREE:
+	case LZW_METHOD_ARITHMETIC_POW2:
+	case LZW_METHOD_ARITHMETIC_64:
+	case LZW_METHOD_ARITHMETIC_POW2_64:
+		return static_cast<LzwMethod>(value);
+	default:
+		throw std::runtime_error("Unknown LZW method.");
+	}
+}
+
+/// Settings of levels, level n is at index n - 1
+const LzwLevel LEVELS[] = {
+	{ 1, LZW_METHOD_VARIABLE, 1 << 22, 0, 3, true, 0 },
+	{ 2, LZW_METHOD_HUFFMAN, 1 << 22, 0, 3, true, 0 },
+	{ 3, LZW_METHOD_VARIABLE, 1 << 20, 16, 3, true, 0 },
+	{ 4, LZW_METHOD_HUFFMAN, 1 << 22, 16, 3, true, 0 },
+	{ 5, LZW_METHOD_BITTREE, 1 << 20, 16, 1, true, 0 },
+	{ 6, LZW_METHOD_BITTREE, 1 << 22, 16, 1, false, 0 },
+	{ 7, LZW_METHOD_BITTREE, 1 << 22, 16, 1, false, 16 << 20 },
+	{ 8, LZW_METHOD_BITTREE, 1 << 22, 16, 1, false, 64 << 20 },
+	{ 9, LZW_METHOD_BITTREE, 1 << 22, 16, 1, false, 256 << 20 }
+};
+
+}
+
+const int LzwLevel::MIN;
+const int LzwLevel::MAX;
+
+const LzwLevel& lzwLevel(int level) {
+	if (level < LzwLevel::MIN || level > LzwLevel::MAX)
+		throw std::runtime_error("Invalid compression level.");
+	return LEVELS[level - LzwLevel::MIN];
+}
+
+std::shared_ptr<ICodeWriter> createCodeWriter(LzwMethod method, std::ostream* stream) {
+	switch (method) {
+	case LZW_METHOD_VARIABLE:
+		return std::make_shared<VariableCodeWriter>(stream);
+	case LZW_METHOD_ARITHMETIC:
+		return std::make_shared<ArithmeticCodeWriter>(stream);
+	case LZW_METHOD_HUFFMAN:
+		return std::make_shared<HuffmanCodeWriter>(stream);
+	case LZW_METHOD_BITTREE:
+		return std::make_shared<BitTreeCodeWriter>(stream);
+	case LZW_METHOD_ARITHMETIC_POW2:
+		return std::make_shared<ArithmeticCodeWriter>(stream, true);
+	case LZW_METHOD_ARITHMETIC_64:
+		return std::make_shared<ArithmeticCodeWriter64>(stream);
+	case LZW_METHOD_ARITHMETIC_POW2_64:
+		return std::make_shared<ArithmeticCodeWriter64>(stream, true);
+	case LZW_METHOD_AUTO:
+		break;
+	}
+	throw std::runtime_error("createCodeWriter: unknown method");
+}
+
+std::shared_ptr<ICodeReader> createCodeReader(LzwMethod method, std::istream* stream) {
+	switch (method) {
+	case LZW_METHOD_VARIABLE:
+		return std::make_shared<VariableCodeReader>(stream);
+	case LZW_METHOD_ARITHMETIC:
+		return std::make_shared<ArithmeticCodeReader>(stream);
+	case LZW_METHOD_HUFFMAN:
+		return std::make_shared<HuffmanCodeReader>(stream);
+	case LZW_METHOD_BITTREE:
+		return std::make_shared<BitTreeCodeReader>(stream);
+	case LZW_METHOD_ARITHMETIC_POW2:
+		return std::make_shared<ArithmeticCodeReader>(stream, true);
+	case LZW_METHOD_ARITHMETIC_64:
+		return std::make_shared<ArithmeticCodeReader64>(stream);
+	case LZW_METHOD_ARITHMETIC_POW2_64:
+		return std::make_shared<ArithmeticCodeReader64>(stream, true);
+	case LZW_METHOD_AUTO:
+		break;
+	}
+	throw std::runtime_error("createCodeReader: unknown method");
+}
+
+LzwBlockWriter::LzwBlockWriter(std::ostream* stream, LzwMethod method, size_t blockSize, size_t memoryLimit)
+	: stream(stream), method(method), blockSize(blockSize), memoryLimit(memoryLimit), peak(0),
+	dedupPeak(0), autoTolerance(DEFAULT_AUTO_TOLERANCE), autoMethod(LZW_METHOD_AUTO), autoCoded(0), level(0), resetWidth(0),
+	probe(true), closed(false), checkpoint(false), segmentOpen(false), segmentMethod(LZW_METHOD_VARIABLE), dedupRestart(true) {
+	assert(blockSize > 0 && blockSize <= UINT32_MAX);
+
+	writeHeader();
+	buffer.reserve(blockSize);
+}
+
+LzwBlockWriter::LzwBlockWriter(std::ostream* stream, const LzwLevel& level, size_t memoryLimit)
+	: stream(stream), method(level.method), blockSize(level.blockSize), memoryLimit(memoryLimit), peak(0),
+	dedupPeak(0), autoTolerance(DEFAULT_AUTO_TOLERANCE), autoMethod(LZW_METHOD_AUTO), autoCoded(0), level(level.level),
+	resetWidth(level.resetWidth), probe(level.probe), closed(false), checkpoint(false), segmentOpen(false),
+	segmentMethod(LZW_METHOD_VARIABLE), dedupRestart(true) {
+	assert(blockSize > 0 && blockSize <= UINT32_MAX);
+
+	// level with automatic selection takes the smallest method of every block
+	if (method == LZW_METHOD_AUTO)
+		autoTolerance = 0;
+	setDedupWindow(level.dedupWindow);
+	writeHeader();
+	buffer.reserve(blockSize);
+}
+
+LzwBlockWriter::LzwBlockWriter(std::ostream* stream, const LzwCheckpoint& checkpoint, size_t memoryLimit)
+	: stream(stream), method(checkpoint.method), blockSize(checkpoint.blockSize), memoryLimit(memoryLimit), peak(0),
+	dedupPeak(0), autoTolerance(DEFAULT_AUTO_TOLERANCE), autoMethod(LZW_METHOD_AUTO), autoCoded(0), level(0), resetWidth(0),
+	probe(true), closed(false), checkpoint(true), offset(checkpoint.resumeOffset()),
+	lastBlockOffset(checkpoint.resumeOffset()), segmentOpen(false), segmentMethod(LZW_METHOD_VARIABLE),
+	dedupRestart(true) {
+	assert(blockSize > 0 && blockSize <= UINT32_MAX);
+
+	setDedupWindow(checkpoint.dedupWindow);
+	buffer.reserve(blockSize);
+}
+
+void LzwBlockWriter::reset(std::ostream* stream) {
+	close();
+	// data of failed block are not written to new stream
+	buffer.clear();
+
+	this->stream = stream;
+	closed = false;
+	segmentOpen = false;
+	// every stream selects its own methods, so it doesn't depend on streams before it
+	autoMethod = LZW_METHOD_AUTO;
+	if (dedup)
+		dedup->clear();
+	dedupRestart = true;
+	writeHeader();
+}
+
+void LzwBlockWriter::writeHeader() {
+	stream->write(LZW_MAGIC, sizeof(LZW_MAGIC));
+	if (level != 0) {
+		stream->put(static_cast<char>(LZW_VERSION_LEVEL));
+		stream->put(static_cast<char>(level));
+		offset = lastBlockOffset = LEVEL_HEADER_SIZE;
+	} else {
+		stream->put(static_cast<char>(LZW_VERSION_BLOCKS));
+		offset = lastBlockOffset = HEADER_SIZE;
+	}
+}
+
+void LzwBlockWriter::write(const char* data, size_t size) {
+	while (size > 0) {
+		// write full blocks directly without copying them to buffer
+		if (buffer.empty() && size >= blockSize) {
+			auto n = writeBlock(data, blockSize, false);
+			data += n;
+			size -= n;
+			continue;
+		}
+
+		size_t n = std::min(size, blockSize - buffer.size());
+		buffer.insert(buffer.end(), data, data + n);
+		data += n;
+		size -= n;
+
+		if (buffer.size() == blockSize)
+			writeBuffer(false);
+	}
+}
+
+void LzwBlockWriter::writeBuffer(bool last) {
+	try {
+		auto n = writeBlock(buffer.data(), buffer.size(), last);
+		buffer.erase(buffer.begin(), buffer.begin() + n);
+	} catch (std::exception&) {
+		// failed block isn't written again by next write or close
+		buffer.clear();
+		throw;
+	}
+}
+
+void LzwBlockWriter::flush() {
+	if (!buffer.empty()) {
+		try {
+			if (dedup) {
+				writeDedupBlock(buffer.data(), buffer.size(), true, true);
+			} else
+				writeSegment(buffer.data(), buffer.size(), true);
+		} catch (std::exception&) {
+			buffer.clear();
+			throw;
+		}
+		buffer.clear();
+	}
+	stream->flush();
+}
+
+void LzwBlockWriter::close() {
+	if (closed)
+		return;
+	closed = true;
+
+	if (!buffer.empty())
+		writeBuffer(true);
+	// run always ends by coded block, so block after it (i.e. appended one) doesn't continue it
+	if (segmentOpen)
+		writeSegment(nullptr, 0, false);
+	if (checkpoint) {
+		writeCheckpoint();
+	} else
+		stream->put(static_cast<char>(LZW_BLOCK_END));
+	stream->flush();
+}
+
+void LzwBlockWriter::writeHole(uint64_t length) {
+	if (length == 0)
+		return;
+
+	if (!buffer.empty())
+		writeBuffer(true);
+	if (segmentOpen)
+		writeSegment(nullptr, 0, false);
+
+	writeBlockHeader(LZW_BLOCK_HOLE, LZW_METHOD_VARIABLE, 0, sizeof(uint64_t));
+	writeLittleEndian<uint64_t>(*stream, length);
+	if (!*stream)
+		throw std::runtime_error("LzwBlockWriter: unable to write block to stream");
+}
+
+void LzwBlockWriter::setDedupWindow(size_t window) {
+	const size_t KIB = 1 << 10;
+	if (window == 0) {
+		dedup.reset();
+		return;
+	}
+	if (window / KIB >= DEDUP_WINDOW_MASK)
+		throw std::runtime_error("LzwBlockWriter: dedup window too large");
+	window = (window + KIB - 1) / KIB * KIB;
+	// window and dictionary share memory limit, reader with the same limit splits it the same way
+	if (window > maxDedupWindow(memoryLimit))
+		window = maxDedupWindow(memoryLimit) / KIB * KIB;
+	if (window == 0) {
+		dedup.reset();
+		return;
+	}
+	dedup.reset(new DedupIndex(window));
+	dedupRestart = true;
+	// encoder is created again with its part of limit
+	encoder.reset();
+}
+
+void LzwBlockWriter::setResetWidth(unsigned width) {
+	resetWidth = width;
+	if (encoder)
+		encoder->setResetWidth(width);
+}
+
+void LzwBlockWriter::writeCheckpoint() {
+	LzwCheckpoint state;
+	state.offset = offset;
+	state.lastBlockOffset = lastBlockOffset;
+	state.method = method;
+	state.blockSize = blockSize;
+	state.dedupWindow = dedupWindow();
+	state.write(*stream);
+	offset += LzwCheckpoint::SIZE;
+}
+
+LzwMethod LzwBlockWriter::selectMethod(const char* data, size_t size) {
+	if (method != LZW_METHOD_AUTO)
+		return method;
+	if (autoMethod == LZW_METHOD_AUTO || autoCoded >= AUTO_RESELECT_SIZE) {
+		autoMethod = selectLzwMethod(estimateLzwMethods(data, size, dictionaryLimit(memoryLimit, dedupWindow())), autoTolerance);
+		autoCoded = 0;
+	}
+	autoCoded += size;
+	return autoMethod;
+}
+
+size_t LzwBlockWriter::writeBlock(const char* data, size_t size, bool last) {
+	if (dedup)
+		return writeDedupBlock(data, size, last, false);
+	if (segmentOpen) {
+		writeSegment(data, size, false);
+		return size;
+	}
+	if (writeRunsBlock(data, size))
+		return size;
+
+	auto blockMethod = selectMethod(data, size);
+	std::string payload;
+	if (codeBlock(data, size, blockMethod, payload)) {
+		writeBlockHeader(LZW_BLOCK_CODED, blockMethod, size, payload.size());
+		stream->write(payload.data(), payload.size());
+	} else {
+		writeBlockHeader(LZW_BLOCK_STORED, blockMethod, size, size);
+		stream->write(data, size);
+	}
+
+	if (!*stream)
+		throw std::runtime_error("LzwBlockWriter: unable to write block to stream");
+	return size;
+}
+
+size_t LzwBlockWriter::writeDedupBlock(const char* data, size_t size, bool last, bool sync) {
+	// distance has to fit to entry next to reference flag
+	const uint64_t MAX_DISTANCE = UINT32_MAX >> 1;
+
+	recipe.clear();
+	literals.clear();
+	size_t position = 0;
+	while (position < size) {
+		auto n = ContentChunker::next(data + position, size - position);
+		// chunk cut by end of data goes to next block, so chunks of repeated data don't depend
+		// on block boundaries
+		if (!last && position > 0 && n == size - position && n < ContentChunker::MAX_CHUNK)
+			break;
+
+		uint64_t id;
+		if (dedup->find(data + position, n, id) && dedup->nextId() - id <= MAX_DISTANCE) {
+			recipe.push_back(static_cast<uint32_t>((dedup->nextId() - id) << 1) | 1);
+		} else {
+			dedup->add(data + position, n);
+			recipe.push_back(static_cast<uint32_t>(n << 1));
+			literals.append(data + position, n);
+		}
+		position += n;
+	}
+
+	// referenced chunks cost only their entry, literals are coded as usual block
+	auto blockMethod = selectMethod(literals.data(), literals.size());
+	std::string payload;
+	bool literalsCoded = !literals.empty() && codeBlock(literals.data(), literals.size(), blockMethod, payload);
+	auto& literalsData = literalsCoded ? payload : literals;
+
+	size_t payloadSize = 2 * sizeof(uint32_t) + recipe.size() * sizeof(uint32_t) + 1 + literalsData.size();
+	writeBlockHeader(LZW_BLOCK_DEDUP, blockMethod, position, payloadSize);
+	writeLittleEndian<uint32_t>(*stream, static_cast<uint32_t>(dedup->capacity() >> 10) | (dedupRestart ? DEDUP_RESTART : 0)
+		| (sync ? DEDUP_SYNC : 0));
+	dedupRestart = false;
+	dedupPeak = std::max(dedupPeak, dedup->size());
+	writeLittleEndian<uint32_t>(*stream, static_cast<uint32_t>(recipe.size()));
+	for (auto entry : recipe)
+		writeLittleEndian<uint32_t>(*stream, entry);
+	stream->put(static_cast<char>(literalsCoded ? LZW_BLOCK_CODED : LZW_BLOCK_STORED));
+	stream->write(literalsData.data(), literalsData.size());
+
+	if (!*stream)
+		throw std::runtime_error("LzwBlockWriter: unable to write block to stream");
+	return position;
+}
+
+bool LzwBlockWriter::writeRunsBlock(const char* data, size_t size) {
+	const size_t RUN_ENTRY_SIZE = 2 * sizeof(uint32_t) + 1;
+
+	runs.clear();
+	literals.clear();
+	auto bytes = reinterpret_cast<const uint8_t*>(data);
+	size_t position = 0;
+	while (position < size) {
+		size_t length;
+		auto start = position + bytescan::findRun(bytes + position, size - position, RUN_PROBE, length);
+		if (start == size)
+			break;
+
+		LzwRun run = { static_cast<uint32_t>(start - position), static_cast<uint32_t>(length), data[start] };
+		runs.push_back(run);
+		literals.append(data + position, start - position);
+		position = start + length;
+	}
+	if (runs.empty())
+		return false;
+	literals.append(data + position, size - position);
+
+	// literals around runs are coded together, so dictionary isn't restarted by runs
+	auto blockMethod = selectMethod(literals.data(), literals.size());
+	std::string payload;
+	bool literalsCoded = !literals.empty() && codeBlock(literals.data(), literals.size(), blockMethod, payload);
+	auto& literalsData = literalsCoded ? payload : literals;
+
+	size_t payloadSize = sizeof(uint32_t) + runs.size() * RUN_ENTRY_SIZE + 1 + literalsData.size();
+	writeBlockHeader(LZW_BLOCK_RUNS, blockMethod, size, payloadSize);
+	writeLittleEndian<uint32_t>(*stream, static_cast<uint32_t>(runs.size()));
+	for (auto& run : runs) {
+		writeLittleEndian<uint32_t>(*stream, run.literals);
+		writeLittleEndian<uint32_t>(*stream, run.length);
+		stream->put(run.byte);
+	}
+	stream->put(static_cast<char>(literalsCoded ? LZW_BLOCK_CODED : LZW_BLOCK_STORED));
+	stream->write(literalsData.data(), literalsData.size());
+
+	if (!*stream)
+		throw std::runtime_error("LzwBlockWriter: unable to write block to stream");
+	return true;
+}
+
+void LzwBlockWriter::writeBlockHeader(LzwBlockType type, LzwMethod blockMethod, size_t rawSize, size_t payloadSize) {
+	// block which isn't full is coded again with appended data, dedup blocks are kept
+	// because their chunks are already in reader's window
+	bool reopen = rawSize < blockSize && (type == LZW_BLOCK_STORED || type == LZW_BLOCK_CODED || type == LZW_BLOCK_RUNS);
+	lastBlockOffset = reopen ? offset : offset + BLOCK_HEADER_SIZE + payloadSize;
+	offset += BLOCK_HEADER_SIZE + payloadSize;
+
+	stream->put(static_cast<char>(type));
+	stream->put(static_cast<char>(blockMethod));
+	writeLittleEndian<uint32_t>(*stream, static_cast<uint32_t>(rawSize));
+	writeLittleEndian<uint32_t>(*stream, static_cast<uint32_t>(payloadSize));
+}
+
+bool LzwBlockWriter::codeBlock(const char* data, size_t size, LzwMethod blockMethod, std::string& payload) {
+	// when block prefix doesn't compress, whole block most likely won't either
+	// so skip coding of whole block, this keeps incompressible data near copy speed
+	bool probing = probe && size > 2 * PROBE_SIZE;
+	size_t codedSize = probing ? PROBE_SIZE : size;
+
+	for (;;) {
+		prepareEncoder(createCodeWriter(blockMethod, &coded));
+		// reset flushes previous writer to coded again, that is dropped here
+		coded.str(std::string());
+
+		for (size_t i = 0; i < codedSize; ++i)
+			encoder->encode(static_cast<unsigned char>(data[i]));
+		encoder->flush();
+		peak = std::max(peak, encoder->memory().peak());
+
+		payload = coded.str();
+		if (payload.size() >= codedSize)
+			return false;
+
+		if (!probing)
+			return true;
+
+		probing = false;
+		codedSize = size;
+	}
+}
+
+void LzwBlockWriter::prepareEncoder(std::shared_ptr<ICodeWriter> writer) {
+	if (encoder) {
+		encoder->reset(std::move(writer));
+		return;
+	}
+	encoder.reset(new LzwEncoder(std::move(writer), dictionaryLimit(memoryLimit, dedupWindow())));
+	encoder->setResetWidth(resetWidth);
+}
+
+void LzwBlockWriter::writeSegment(const char* data, size_t size, bool sync) {
+	if (!segmentOpen) {
+		segmentMethod = selectMethod(data, size);
+		prepareEncoder(createCodeWriter(segmentMethod, &coded));
+		segmentOpen = true;
+	}
+	// reset flushes previous writer to coded, segments also leave nothing behind
+	coded.str(std::string());
+
+	for (size_t i = 0; i < size; ++i)
+		encoder->encode(static_cast<unsigned char>(data[i]));
+	if (sync) {
+		encoder->syncFlush();
+	} else {
+		encoder->flush();
+		segmentOpen = false;
+	}
+	peak = std::max(peak, encoder->memory().peak());
+
+	auto payload = coded.str();
+	writeBlockHeader(sync ? LZW_BLOCK_SYNC : LZW_BLOCK_CODED, segmentMethod, size, payload.size());
+	// segment can't be decoded without the ones before it
+	lastBlockOffset = offset;
+	stream->write(payload.data(), payload.size());
+
+	if (!*stream)
+		throw std::runtime_error("LzwBlockWriter: unable to write block to stream");
+}
+
+bool LzwBlockReader::decodeBlock(std::ostream& out) {
+	int type = stream->get();
+	if (type == std::char_traits<char>::eof())
+		throw std::runtime_error("LzwBlockReader: missing end of stream block");
+	if (type == LZW_BLOCK_END)
+		return false;
+
+	auto method = toMethod(stream->get());
+	size_t rawSize = readLittleEndian<uint32_t>(*stream);
+	size_t payloadSize = readLittleEndian<uint32_t>(*stream);
+	if (segmentReader && type != LZW_BLOCK_SYNC && type != LZW_BLOCK_CODED)
+		throw std::runtime_error("LzwBlockReader: run of sync blocks doesn't end by coded block");
+
+	if (type == LZW_BLOCK_STORED) {
+		if (payloadSize != rawSize)
+			throw std::runtime_error("LzwBlockReader: stored block size mismatch");
+
+		// copy stored block straight through
+		char chunk[1 << 16];
+		while (payloadSize > 0) {
+			auto n = std::min(payloadSize, sizeof(chunk));
+			if (!stream->read(chunk, n))
+				throw std::runtime_error("LzwBlockReader: unexpected end of stream in stored block");
+			out.write(chunk, n);
+			payloadSize -= n;
+		}
+	} else if (type == LZW_BLOCK_CODED || type == LZW_BLOCK_DEDUP || type == LZW_BLOCK_SYNC || type == LZW_BLOCK_RUNS) {
+		payload.resize(payloadSize);
+		if (payloadSize > 0 && !stream->read(&payload[0], payloadSize))
+			throw std::runtime_error("LzwBlockReader: unexpected end of stream in coded block");
+
+		if (type == LZW_BLOCK_DEDUP) {
+			decodeDedupBlock(method, rawSize, out);
+		} else if (type == LZW_BLOCK_RUNS) {
+			decodeRunsBlock(method, rawSize, out);
+		} else {
+			// decoded size is checked before anything is written out
+			if (type == LZW_BLOCK_SYNC || segmentReader)
+				decodeSegment(method, type == LZW_BLOCK_SYNC);
+			else
+				decodePayload(method, payload.data(), payload.size());
+			if (decoded.size() != rawSize)
+				throw std::runtime_error("LzwBlockReader: decoded block size mismatch");
+			out.write(decoded.data(), decoded.size());
+			// writer flushed there, so data goes out without waiting for next block
+			if (type == LZW_BLOCK_SYNC)
+				out.flush();
+		}
+	} else if (type == LZW_BLOCK_HOLE) {
+		if (rawSize != 0 || payloadSize != sizeof(uint64_t))
+			throw std::runtime_error("LzwBlockReader: hole block size mismatch");
+		auto length = readLittleEndian<uint64_t>(*stream);
+		if (!*stream)
+			throw std::runtime_error("LzwBlockReader: unexpected end of stream in hole block");
+		writeHole(out, length);
+	} else if (type == LZW_BLOCK_CHECKPOINT) {
+		// only appending writer needs it
+		if (!stream->ignore(payloadSize))
+			throw std::runtime_error("LzwBlockReader: unexpected end of stream in checkpoint block");
+	} else
+		throw std::runtime_error("LzwBlockReader: unknown block type");
+
+	if (!out)
+		throw std::runtime_error("LzwBlockReader: unable to write to output stream");
+	return true;
+}
+
+void LzwBlockReader::decodePayload(LzwMethod method, const char* data, size_t size) {
+	MemoryInputBuf payloadBuf(data, size);
+	std::istream payloadStream(&payloadBuf);
+	prepareDecoder(createCodeReader(method, &payloadStream));
+
+	decoded.clear();
+	StringOutputBuf decodedBuf(decoded);
+	std::ostream decodedStream(&decodedBuf);
+	if (pool)
+		decoder->decode(decodedStream, *pool);
+	else
+		decoder->decode(decodedStream);
+	peak = std::max(peak, decoder->memory().peak());
+}
+
+void LzwBlockReader::decodeSegment(LzwMethod method, bool sync) {
+	segmentBuf.reset(payload.data(), payload.size());
+	segmentStream.clear();
+	if (!segmentReader) {
+		segmentReader = createCodeReader(method, &segmentStream);
+		segmentMethod = method;
+		prepareDecoder(segmentReader);
+	} else {
+		if (method != segmentMethod)
+			throw std::runtime_error("LzwBlockReader: method changed within run of sync blocks");
+		segmentReader->continueSegment(&segmentStream);
+	}
+
+	decoded.clear();
+	StringOutputBuf decodedBuf(decoded);
+	std::ostream decodedStream(&decodedBuf);
+	decoder->decode(decodedStream);
+	peak = std::max(peak, decoder->memory().peak());
+
+	if (!sync)
+		segmentReader.reset();
+}
+
+void LzwBlockReader::prepareDecoder(std::shared_ptr<ICodeReader> reader) {
+	// dictionary gets memory limit without window, like in writer
+	auto limit = dictionaryLimit(memoryLimit, history ? history->capacity() : 0);
+	if (decoder && decoder->memory().limit() == limit)
+		decoder->reset(std::move(reader));
+	else
+		decoder.reset(new LzwDecoder(std::move(reader), limit));
+}
+
+void LzwBlockReader::decodeDedupBlock(LzwMethod method, size_t rawSize, std::ostream& out) {
+	MemoryInputBuf payloadBuf(payload.data(), payload.size());
+	std::istream fields(&payloadBuf);
+	auto windowField = readLittleEndian<uint32_t>(fields);
+	size_t window = static_cast<size_t>(windowField & DEDUP_WINDOW_MASK) << 10;
+	if (!history || (windowField & DEDUP_RESTART)) {
+		if (window > maxDedupWindow(memoryLimit))
+			throw std::runtime_error("LzwBlockReader: dedup window exceeds memory limit");
+		history.reset(new DedupHistory(window));
+	} else if (history->capacity() != window)
+		throw std::runtime_error("LzwBlockReader: dedup window changed within stream");
+
+	size_t count = readLittleEndian<uint32_t>(fields);
+	if (count > payload.size() / sizeof(uint32_t))
+		throw std::runtime_error("LzwBlockReader: invalid number of chunks in dedup block");
+	recipe.resize(count);
+	for (auto& entry : recipe)
+		entry = readLittleEndian<uint32_t>(fields);
+
+	int literalsType = fields.get();
+	size_t offset = 2 * sizeof(uint32_t) + count * sizeof(uint32_t) + 1;
+	if (offset > payload.size())
+		throw std::runtime_error("LzwBlockReader: unexpected end of dedup block");
+	const char* literals = payload.data() + offset;
+	size_t literalsSize = payload.size() - offset;
+	if (literalsType == LZW_BLOCK_CODED) {
+		decodePayload(method, literals, literalsSize);
+		literals = decoded.data();
+		literalsSize = decoded.size();
+	} else if (literalsType != LZW_BLOCK_STORED)
+		throw std::runtime_error("LzwBlockReader: unknown type of dedup literals");
+
+	size_t produced = 0;
+	for (auto entry : recipe) {
+		if (entry & 1) {
+			// distance 0 gives id past window, so it's rejected too
+			auto chunk = history->find(history->nextId() - (entry >> 1));
+			if (!chunk)
+				throw std::runtime_error("LzwBlockReader: dedup reference outside window");
+			out.write(chunk->data(), chunk->size());
+			produced += chunk->size();
+		} else {
+			size_t n = entry >> 1;
+			if (n > literalsSize)
+				throw std::runtime_error("LzwBlockReader: dedup literals too short");
+			history->add(literals, n);
+			out.write(literals, n);
+			literals += n;
+			literalsSize -= n;
+			produced += n;
+		}
+	}
+
+	historyPeak = std::max(historyPeak, history->size());
+	if (literalsSize != 0 || produced != rawSize)
+		throw std::runtime_error("LzwBlockReader: dedup block size mismatch");
+	// writer flushed there like after sync block
+	if (windowField & DEDUP_SYNC)
+		out.flush();
+}
+
+void LzwBlockReader::decodeRunsBlock(LzwMethod method, size_t rawSize, std::ostream& out) {
+	const size_t RUN_ENTRY_SIZE = 2 * sizeof(uint32_t) + 1;
+
+	MemoryInputBuf payloadBuf(payload.data(), payload.size());
+	std::istream fields(&payloadBuf);
+	size_t count = readLittleEndian<uint32_t>(fields);
+	size_t offset = sizeof(uint32_t) + count * RUN_ENTRY_SIZE + 1;
+	if (count > payload.size() / RUN_ENTRY_SIZE || offset > payload.size())
+		throw std::runtime_error("LzwBlockReader: invalid number of runs in runs block");
+	runs.resize(count);
+	for (auto& run : runs) {
+		run.literals = readLittleEndian<uint32_t>(fields);
+		run.length = readLittleEndian<uint32_t>(fields);
+		run.byte = static_cast<char>(fields.get());
+	}
+
+	int literalsType = fields.get();
+	const char* literals = payload.data() + offset;
+	size_t literalsSize = payload.size() - offset;
+	if (literalsType == LZW_BLOCK_CODED) {
+		decodePayload(method, literals, literalsSize);
+		literals = decoded.data();
+		literalsSize = decoded.size();
+	} else if (literalsType != LZW_BLOCK_STORED)
+		throw std::runtime_error("LzwBlockReader: unknown type of runs block literals");
+
+	// sizes are checked before anything is written out
+	uint64_t produced = literalsSize, runLiterals = 0;
+	for (auto& run : runs) {
+		produced += run.length;
+		runLiterals += run.literals;
+	}
+	if (runLiterals > literalsSize || produced != rawSize)
+		throw std::runtime_error("LzwBlockReader: runs block size mismatch");
+
+	for (auto& run : runs) {
+		out.write(literals, run.literals);
+		literals += run.literals;
+		literalsSize -= run.literals;
+		writeRun(out, run.byte, run.length);
+	}
+	out.write(literals, literalsSize);
+}
+
+void LzwBlockReader::writeRun(std::ostream& out, char byte, uint64_t length) {
+	const size_t RUN_BUFFER_SIZE = 1 << 16;
+
+	// buffer is filled by one byte, zeros at start
+	if (runBuffer.empty())
+		runBuffer.resize(RUN_BUFFER_SIZE);
+	if (runBuffer[0] != byte)
+		std::memset(runBuffer.data(), byte, runBuffer.size());
+	while (length > 0) {
+		auto n = static_cast<size_t>(std::min<uint64_t>(length, runBuffer.size()));
+		out.write(runBuffer.data(), n);
+		length -= n;
+	}
+}
+
+void LzwBlockReader::writeHole(std::ostream& out, uint64_t length) {
+	// seek past end of file leaves hole, last byte is written so file gets its size,
+	// seek fails on pipes and in-memory streams
+	if (length > 1 && out.tellp() != std::streampos(-1)) {
+		if (out.seekp(static_cast<std::streamoff>(length - 1), std::ios_base::cur)) {
+			out.put('\0');
+			return;
+		}
+		out.clear();
+	}
+	writeRun(out, '\0', length);
+}
+
+void LzwBlockReader::decode(std::ostream& out) {
+	while (decodeBlock(out))
+		;
+}
+
+LzwCheckpoint LzwCheckpoint::read(std::istream& stream) {
+	LzwCheckpoint checkpoint;
+	if (!tryRead(stream, checkpoint))
+		throw std::runtime_error("LzwCheckpoint: stream doesn't end with checkpoint");
+	return checkpoint;
+}
+
+bool LzwCheckpoint::tryRead(std::istream& stream, LzwCheckpoint& checkpoint) {
+	stream.seekg(0, std::ios_base::end);
+	auto end = static_cast<uint64_t>(stream.tellg());
+	if (!stream || end < HEADER_SIZE + SIZE)
+		return false;
+
+	stream.seekg(static_cast<std::streamoff>(end - SIZE));
+	int type = stream.get();
+	stream.get();
+	readLittleEndian<uint32_t>(stream);
+	auto payloadSize = readLittleEndian<uint32_t>(stream);
+	checkpoint.offset = readLittleEndian<uint64_t>(stream);
+	checkpoint.lastBlockOffset = readLittleEndian<uint64_t>(stream);
+	int method = stream.get();
+	checkpoint.blockSize = readLittleEndian<uint32_t>(stream);
+	checkpoint.dedupWindow = static_cast<size_t>(readLittleEndian<uint32_t>(stream)) << 10;
+	int endType = stream.get();
+
+	// checkpoint knows its own offset, so random bytes at end of stream aren't taken for it
+	if (!stream || type != LZW_BLOCK_CHECKPOINT || payloadSize != SIZE - BLOCK_HEADER_SIZE - 1
+		|| endType != LZW_BLOCK_END || checkpoint.offset != end - SIZE || checkpoint.lastBlockOffset > checkpoint.offset
+		|| checkpoint.lastBlockOffset < HEADER_SIZE || checkpoint.blockSize == 0)
+		return false;
+	checkpoint.method = method == LZW_METHOD_AUTO ? LZW_METHOD_AUTO : toMethod(method);
+	return true;
+}
+
+void LzwCheckpoint::write(std::ostream& stream) const {
+	const size_t PAYLOAD_SIZE = SIZE - BLOCK_HEADER_SIZE - 1;
+
+	// method of block header has to be valid one, real method is in payload
+	stream.put(static_cast<char>(LZW_BLOCK_CHECKPOINT));
+	stream.put(static_cast<char>(LZW_METHOD_VARIABLE));
+	writeLittleEndian<uint32_t>(stream, 0);
+	writeLittleEndian<uint32_t>(stream, static_cast<uint32_t>(PAYLOAD_SIZE));
+	writeLittleEndian<uint64_t>(stream, offset);
+	writeLittleEndian<uint64_t>(stream, lastBlockOffset);
+	stream.put(static_cast<char>(method));
+	writeLittleEndian<uint32_t>(stream, static_cast<uint32_t>(blockSize));
+	writeLittleEndian<uint32_t>(stream, static_cast<uint32_t>(dedupWindow >> 10));
+	stream.put(static_cast<char>(LZW_BLOCK_END));
+}
+
+std::string LzwCheckpoint::readLastBlock(std::istream& stream, size_t memoryLimit) const {
+	if (lastBlockOffset == offset)
+		return std::string();
+
+	stream.clear();
+	stream.seekg(static_cast<std::streamoff>(lastBlockOffset));
+	LzwBlockReader reader(&stream, memoryLimit);
+	std::ostringstream decoded;
+	if (!reader.decodeBlock(decoded) || static_cast<uint64_t>(stream.tellg()) != offset)
+		throw std::runtime_error("LzwCheckpoint: last block doesn't end at checkpoint");
+	return decoded.str();
+}
+
+uint8_t readLzwStreamHeader(std::istream& in) {
+	char header[4] = {0};
+	in.read(header, 4);
+	if (!in || !std::equal(LZW_MAGIC, LZW_MAGIC + sizeof(LZW_MAGIC), header))
+		throw std::runtime_error("Bad input header magic string.");
+
+	auto version = static_cast<uint8_t>(header[3]);
+	if (version == LZW_VERSION_LEVEL) {
+		auto level = in.get();
+		if (level < LzwLevel::MIN || level > LzwLevel::MAX)
+			throw std::runtime_error("Invalid compression level in header.");
+	}
+	return version;
+}
+
+uint64_t lzwDecodedSize(std::istream& in) {
+	uint64_t size = 0;
+	do {
+		auto version = readLzwStreamHeader(in);
+		if (version != LZW_VERSION_BLOCKS && version != LZW_VERSION_LEVEL)
+			throw std::runtime_error("Legacy stream has no block sizes.");
+
+		for (;;) {
+			int type = in.get();
+			if (type == std::char_traits<char>::eof())
+				throw std::runtime_error("Missing end of stream block.");
+			if (type == LZW_BLOCK_END)
+				break;
+
+			in.get();
+			uint64_t rawSize = readLittleEndian<uint32_t>(in);
+			uint64_t payloadSize = readLittleEndian<uint32_t>(in);
+			if (type == LZW_BLOCK_HOLE) {
+				if (payloadSize != sizeof(uint64_t))
+					throw std::runtime_error("Hole block size mismatch.");
+				size += readLittleEndian<uint64_t>(in);
+			} else {
+				size += rawSize;
+				in.ignore(static_cast<std::streamsize>(payloadSize));
+				if (static_cast<uint64_t>(in.gcount()) != payloadSize)
+					throw std::runtime_error("Unexpected end of stream in block.");
+			}
+			if (!in)
+				throw std::runtime_error("Unexpected end of stream in block header.");
+		}
+	} while (in.peek() != std::char_traits<char>::eof());
+	return size;
+}
+
+uint64_t appendLzwMember(std::istream& member, std::ostream& out, uint64_t offset) {
+	auto version = readLzwStreamHeader(member);
+	if (version != LZW_VERSION_BLOCKS && version != LZW_VERSION_LEVEL)
+		throw std::runtime_error("Only block streams can be concatenated.");
+
+	LzwCheckpoint checkpoint;
+	bool hasCheckpoint = LzwCheckpoint::tryRead(member, checkpoint);
+	member.clear();
+	member.seekg(-1, std::ios_base::end);
+	auto size = static_cast<uint64_t>(member.tellg()) + 1;
+	if (!member || member.get() != LZW_BLOCK_END)
+		throw std::runtime_error("Stream doesn't end with end block.");
+
+	// checkpoint is written again with offsets in output, rest is copied as is
+	uint64_t remaining = hasCheckpoint ? size - LzwCheckpoint::SIZE : size;
+	member.seekg(0);
+	char chunk[1 << 16];
+	while (remaining > 0) {
+		auto n = static_cast<size_t>(std::min<uint64_t>(remaining, sizeof(chunk)));
+		if (!member.read(chunk, n))
+			throw std::runtime_error("Unable to read stream member.");
+		out.write(chunk, n);
+		remaining -= n;
+	}
+	if (hasCheckpoint) {
+		checkpoint.offset += offset;
+		checkpoint.lastBlockOffset += offset;
+		checkpoint.write(out);
+	}
+
+	if (!out)
+		throw std::runtime_error("Unable to write stream member.");
+	return size;
+}
+
+size_t decompressLzwStream(std::istream& in, std::ostream& out, size_t memoryLimit, ThreadPool* pool) {
+	size_t peak = 0;
+	std::unique_ptr<LzwBlockReader> reader;
+	// members follow each other until end of input
+	do {
+		auto version = readLzwStreamHeader(in);
+		if (version == LZW_METHOD_VARIABLE || version == LZW_METHOD_ARITHMETIC) {
+			// legacy stream has no end mark, it's read to end of input
+			LzwDecoder decoder(createCodeReader(static_cast<LzwMethod>(version), &in), memoryLimit);
+			if (pool)
+				decoder.decode(out, *pool);
+			else
+				decoder.decode(out);
+			return std::max(peak, decoder.memory().peak());
+		} else if (version == LZW_VERSION_BLOCKS || version == LZW_VERSION_LEVEL) {
+			if (reader)
+				reader->reset(&in);
+			else
+				reader.reset(new LzwBlockReader(&in, memoryLimit));
+			reader->setThreadPool(pool);
+			reader->decode(out);
+			peak = std::max(peak, reader->peakMemory());
+		} else
+			throw std::runtime_error("Invalid header value.");
+	} while (in.peek() != std::char_traits<char>::eof());
+	return peak;
+}
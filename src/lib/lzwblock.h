@@ -0,0 +1,538 @@
+/**
+ * @file lzwblock.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef LZW_BLOCK_H
+#define LZW_BLOCK_H
+
+#include "lzwencoder.h"
+#include "lzwdecoder.h"
+#include "lzwdedup.h"
+#include "memstream.h"
+
+#include <cstdint>
+#include <memory>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Methods used for coding LZW codes of one block.
+ */
+enum LzwMethod
+{
+	LZW_METHOD_VARIABLE = 0,		///< variable length codes, see VariableCodeWriter
+	LZW_METHOD_ARITHMETIC = 1,		///< adaptive arithmetic coding, see ArithmeticCodeWriter
+	LZW_METHOD_HUFFMAN = 2,			///< canonical Huffman code per block, see HuffmanCodeWriter
+	LZW_METHOD_BITTREE = 3,			///< binary range coding with bit tree models, see BitTreeCodeWriter
+	LZW_METHOD_ARITHMETIC_POW2 = 4,	///< arithmetic coding with power of two total frequency, see PowerOfTwoDataModel
+	LZW_METHOD_ARITHMETIC_64 = 5,	///< LZW_METHOD_ARITHMETIC with 64bit interval
+	LZW_METHOD_ARITHMETIC_POW2_64 = 6,	///< LZW_METHOD_ARITHMETIC_POW2 with 64bit interval
+	/// Only for LzwBlockWriter, method of every block is selected by estimateLzwMethods
+	LZW_METHOD_AUTO = 0xFF
+};
+
+/**
+ * Type of block in block stream.
+ */
+enum LzwBlockType
+{
+	LZW_BLOCK_END = 0,				///< terminates stream, has no other fields
+	LZW_BLOCK_STORED = 1,			///< payload is raw copy of input
+	LZW_BLOCK_CODED = 2,			///< payload is LZW coded with block method
+	LZW_BLOCK_DEDUP = 3,			///< chunks of block are literals or references to earlier chunks
+	LZW_BLOCK_CHECKPOINT = 4,		///< writer state for appending to stream, see LzwCheckpoint
+	/// LZW coded like coded block but ends at sync flush, coding state continues in next
+	/// sync or coded block, which ends the run
+	LZW_BLOCK_SYNC = 5,
+	LZW_BLOCK_RUNS = 6,				///< long runs of one byte are listed, remaining literals are coded
+	LZW_BLOCK_HOLE = 7				///< hole of sparse file, payload is its length (8B), raw size is 0
+};
+
+/// Magic string starting every LZW stream
+extern const char LZW_MAGIC[3];
+
+/// Stream versions, stored in fourth byte of header.
+/// Versions 0 and 1 are legacy single stream formats, value is the LzwMethod used.
+const uint8_t LZW_VERSION_BLOCKS = 2;
+/// Block stream written at compression level, level is stored in fifth byte of header
+const uint8_t LZW_VERSION_LEVEL = 3;
+
+/**
+ * Compression level preset, it combines writer settings so that higher level gives
+ * smaller output at lower speed. Level only chooses how blocks are coded, reader needs
+ * no settings from it.
+ *
+ * Low levels keep full dictionary and use cheap code writers, so decoding is fastest.
+ * Middle levels reset full dictionary, it adapts to changing input for better ratio.
+ * From level 6 every block is coded whole, so incompressible start of large block on mixed
+ * input doesn't make it stored. Levels 7 to 9 add deduplication, they differ by window,
+ * so higher one finds repeats further back and pays on input larger than window of lower
+ * one. Window holds only data read so far, so small input doesn't take whole window.
+ * Encoding speed depends mostly on dictionary lookups, so it differs less than decoding speed.
+ *
+ * Levels measured by bench --levels on 16 MiB of C headers (release build, one core):
+ *
+ * | level | method             | block     | reset width | threads | dedup     | compress    | decompress   | ratio |
+ * |-------|--------------------|-----------|-------------|---------|-----------|-------------|--------------|-------|
+ * | 1     | variable           | 4096 KiB  | 0           | 3       | -         |   3.4 MiB/s |   83.0 MiB/s | 0.428 |
+ * | 2     | huffman            | 4096 KiB  | 0           | 3       | -         |   3.7 MiB/s |   75.3 MiB/s | 0.415 |
+ * | 3     | variable           | 1024 KiB  | 16          | 3       | -         |   2.6 MiB/s |   45.2 MiB/s | 0.330 |
+ * | 4     | huffman            | 4096 KiB  | 16          | 3       | -         |   2.3 MiB/s |   29.5 MiB/s | 0.294 |
+ * | 5     | bittree            | 1024 KiB  | 16          | 1       | -         |   2.0 MiB/s |   15.8 MiB/s | 0.286 |
+ * | 6     | bittree            | 4096 KiB  | 16          | 1       | -         |   2.1 MiB/s |   15.4 MiB/s | 0.284 |
+ * | 7     | bittree            | 4096 KiB  | 16          | 1       | 16 MiB    |   2.1 MiB/s |   18.1 MiB/s | 0.282 |
+ * | 8     | bittree            | 4096 KiB  | 16          | 1       | 64 MiB    |   2.1 MiB/s |   15.1 MiB/s | 0.282 |
+ * | 9     | bittree            | 4096 KiB  | 16          | 1       | 256 MiB   |   1.8 MiB/s |   13.2 MiB/s | 0.282 |
+ *
+ * On 13 MB of headers, binaries and 1 MB of random data, levels 5, 6 and 7 give 5,310,436,
+ * 5,031,500 and 4,894,187 bytes. On 45 MB of the headers, that data and the headers again,
+ * levels 6, 7 and 8 give 14,564,544, 12,226,913 and 7,503,674 bytes.
+ */
+struct LzwLevel
+{
+	static const int MIN = 1;
+	static const int MAX = 9;
+
+	int level;
+	LzwMethod method;
+	size_t blockSize;
+	/// Dictionary is reset before codes need more bits, 0 keeps full dictionary, see LzwEncoder::setResetWidth
+	unsigned resetWidth;
+	/// Threads of compression, with more than one input and output run in background threads
+	unsigned threads;
+	/// Block is stored when its prefix doesn't compress, see LzwBlockWriter::PROBE_SIZE, otherwise
+	/// every block is coded whole, so compressible rest of block isn't stored with incompressible start
+	bool probe;
+	/// Deduplication window in bytes, 0 without deduplication, see LzwBlockWriter::setDedupWindow
+	size_t dedupWindow;
+};
+
+/**
+ * Gets settings of compression level.
+ * @param level number from LzwLevel::MIN to LzwLevel::MAX
+ * @throws std::runtime_error when level is out of range
+ */
+const LzwLevel& lzwLevel(int level);
+
+/**
+ * State of LzwBlockWriter needed to continue stream, stored in checkpoint block just before end block.
+ * Blocks are coded independently, so no encoder state crosses them. Only last block which
+ * isn't full is decoded and coded again together with appended data.
+ *
+ * Payload is: checkpoint offset (8B), last block offset (8B), method (1B), block size (4B),
+ * dedup window in KiB (4B, 0 without deduplication). Offsets are from start of file, so in
+ * stream of several members they include size of members before.
+ */
+struct LzwCheckpoint
+{
+	/// Size of checkpoint block and end block which follows it
+	static const size_t SIZE = 10 + 8 + 8 + 1 + 4 + 4 + 1;
+
+	uint64_t offset;			/// offset of checkpoint block in stream
+	uint64_t lastBlockOffset;	/// offset of last block which isn't full, offset when there is none
+	LzwMethod method;
+	size_t blockSize;
+	size_t dedupWindow;			/// in bytes
+
+	/// Stream offset where appending writer starts, stream has to be truncated there
+	uint64_t resumeOffset() const {
+		return lastBlockOffset;
+	}
+
+	/**
+	 * Reads checkpoint from end of seekable stream.
+	 * @throws std::runtime_error when stream doesn't end with checkpoint
+	 */
+	static LzwCheckpoint read(std::istream& stream);
+
+	/**
+	 * Reads checkpoint from end of seekable stream.
+	 * @return false when stream doesn't end with checkpoint
+	 */
+	static bool tryRead(std::istream& stream, LzwCheckpoint& checkpoint);
+
+	/// Writes checkpoint block followed by end block
+	void write(std::ostream& stream) const;
+
+	/**
+	 * Decodes last block which isn't full, it has to be written again before appended data.
+	 * @return decoded data, empty when there is no such block
+	 */
+	std::string readLastBlock(std::istream& stream, size_t memoryLimit = MemoryBudget::UNLIMITED) const;
+};
+
+/// Entry of runs block, see LzwBlockWriter
+struct LzwRun
+{
+	uint32_t literals;		/// literal bytes before run
+	uint32_t length;
+	char byte;
+};
+
+/// Creates code writer for method writing to stream
+std::shared_ptr<ICodeWriter> createCodeWriter(LzwMethod method, std::ostream* stream);
+
+/// Creates code reader for method reading from stream
+std::shared_ptr<ICodeReader> createCodeReader(LzwMethod method, std::istream* stream);
+
+/**
+ * Writer of block LZW stream.
+ * Input is split into blocks, each block is coded independently with fresh dictionary.
+ * Block which would expand after coding is stored raw instead, so incompressible data
+ * costs only block header and a copy.
+ *
+ * Block layout is: type (1B), method (1B), raw size (4B), payload size (4B), payload.
+ * All numbers are little endian. End block consists only of type byte.
+ *
+ * With deduplication every block is split to content defined chunks and chunk equal to one
+ * in window of earlier chunks is replaced by reference, only remaining literal chunks are coded.
+ * Payload of dedup block is: window size in KiB (4B), number of chunks (4B), chunk entries (4B each),
+ * literals type (1B, stored or coded) and literals. Entry is chunk size << 1 for literal chunk
+ * or distance << 1 | 1 for reference, distance 1 is the last chunk added to window.
+ * Top bit of window size is set in first dedup block of stream or of appended part,
+ * reader starts its window again there. Second top bit is set in block written by flush,
+ * reader flushes its output after it like after sync block.
+ *
+ * Long runs of one byte would take many codes and fill dictionary with strings of the run,
+ * so block with them is written as runs block. Its payload is: number of runs (4B), run entries,
+ * literals type (1B, stored or coded) and literals between runs. Entry is number of literal
+ * bytes before run (4B), run length (4B) and run byte (1B).
+ *
+ * Hole of sparse file is written as hole block with 64bit length, so holes of any size take
+ * a few bytes and their zeros are neither read nor coded. Reader recreates hole by seeking
+ * when output is seekable file.
+ *
+ * Flush writes buffered data as sync block, its codes end byte aligned, so reader decodes
+ * everything written so far. Dictionary and code models are kept, next block continues the
+ * run of segments and so doesn't pay for rebuilding dictionary like new block would.
+ */
+class LzwBlockWriter
+{
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+	/// Size of block prefix compressed first to find out if block is worth compressing
+	static const size_t PROBE_SIZE = 1 << 14;
+	/// Default allowed size increase of faster method in automatic selection
+	static const double DEFAULT_AUTO_TOLERANCE;
+	/// Runs of one byte at least twice this long are written as runs, see bytescan::findRun
+	static const size_t RUN_PROBE = 128;
+	/**
+	 * Automatically selected method is kept for blocks until this many bytes were coded by it.
+	 * Estimate codes samples of block by all methods, about as much work as coding a quarter of
+	 * default block by each, so doing it for every block would nearly double coding time.
+	 */
+	static const size_t AUTO_RESELECT_SIZE = 8 << 20;
+
+	/**
+	 * Constructs writer and writes stream header.
+	 * @param stream output stream, must outlive this instance
+	 * @param method method used for coded blocks, LZW_METHOD_AUTO selects it by samples of blocks,
+	 *        see AUTO_RESELECT_SIZE
+	 * @param blockSize maximal size of input per block
+	 * @param memoryLimit dictionary memory limit of encoder, see LzwEncoder
+	 */
+	LzwBlockWriter(std::ostream* stream, LzwMethod method, size_t blockSize = DEFAULT_BLOCK_SIZE,
+		size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	/**
+	 * Constructs writer with settings of compression level, level is stored in stream header.
+	 * Threads of level are up to caller.
+	 * @param stream output stream, must outlive this instance
+	 * @param level level settings, see lzwLevel
+	 * @param memoryLimit dictionary memory limit of encoder, see LzwEncoder
+	 */
+	LzwBlockWriter(std::ostream* stream, const LzwLevel& level, size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	/**
+	 * Constructs writer continuing stream with checkpoint, it writes checkpoint again on close.
+	 * Deduplication window starts empty.
+	 * @param stream output stream positioned at checkpoint.resumeOffset(), must outlive this instance
+	 * @param checkpoint checkpoint read from stream
+	 * @param memoryLimit dictionary memory limit of encoder, see LzwEncoder
+	 */
+	LzwBlockWriter(std::ostream* stream, const LzwCheckpoint& checkpoint,
+		size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	/// Closes stream, write errors are dropped, call close to get them
+	~LzwBlockWriter() {
+		try {
+			close();
+		} catch (std::exception&) {
+			// destructor may run during unwinding of earlier write error
+		}
+	}
+
+	/**
+	 * Appends data to stream. Full blocks are written immediately.
+	 * @throws std::runtime_error when block can't be written, its data are dropped
+	 */
+	void write(const char* data, size_t size);
+
+	/**
+	 * Writes buffered data, so reader can decode everything written so far, and flushes stream.
+	 * Coding state continues with next data. With deduplication dedup block is written instead.
+	 */
+	void flush();
+
+	/**
+	 * Appends hole of sparse file, it reads as zeros. Buffered data are written before it
+	 * as block which isn't full.
+	 * @param length number of zero bytes
+	 */
+	void writeHole(uint64_t length);
+
+	/**
+	 * Writes pending block and end of stream mark, writer is closed even when it fails.
+	 * @throws std::runtime_error when stream can't be written
+	 */
+	void close();
+
+	/**
+	 * Closes current stream and starts new one, encoder and buffers are reused.
+	 * @param stream output stream, must outlive this instance
+	 */
+	void reset(std::ostream* stream);
+
+	/// Peak dictionary memory of all blocks coded so far together with peak of dedup window
+	size_t peakMemory() const {
+		return peak + dedupPeak;
+	}
+
+	/**
+	 * Sets allowed size increase of faster method in automatic selection.
+	 * @param tolerance relative increase, i.e. 0.05 for 5 %
+	 */
+	void setAutoTolerance(double tolerance) {
+		autoTolerance = tolerance;
+	}
+
+	/**
+	 * Enables deduplication of chunks repeated within window, has to be set before first write.
+	 * Window and dictionary share memory limit of writer, window is cut so that dictionary keeps
+	 * at least MemoryBudget::MIN_LZW_LIMIT and dictionary is limited to the rest. Reader splits
+	 * its limit the same way, so it needs memory limit at least as large as writer's.
+	 * @param window size of window in bytes, rounded up to KiB, 0 disables deduplication
+	 */
+	void setDedupWindow(size_t window);
+
+	/**
+	 * Sets code width after which dictionary of blocks is reset, see LzwEncoder::setResetWidth.
+	 */
+	void setResetWidth(unsigned width);
+
+	/**
+	 * Writes checkpoint before end of stream on close, so stream can be continued.
+	 * Appending writer keeps method and block size of stream, other settings are its own.
+	 */
+	void setCheckpoint(bool enabled) {
+		checkpoint = enabled;
+	}
+private:
+	/// Writes stream header, offsets of stream start after it
+	void writeHeader();
+	void writeCheckpoint();
+
+	/// Method of block, automatic selection estimates it again after AUTO_RESELECT_SIZE bytes
+	LzwMethod selectMethod(const char* data, size_t size);
+
+	/**
+	 * Writes block from start of data.
+	 * @param last data is end of input, so it's all written
+	 * @return number of bytes written, with deduplication chunk cut by end of data waits for next block
+	 */
+	size_t writeBlock(const char* data, size_t size, bool last);
+	/// Writes block from buffer and removes written data, buffer is dropped when it fails
+	void writeBuffer(bool last);
+	/// @param sync block is written by flush, reader flushes its output after it
+	size_t writeDedupBlock(const char* data, size_t size, bool last, bool sync);
+	/// Writes block with long runs as runs block, returns false when block has none
+	bool writeRunsBlock(const char* data, size_t size);
+	void writeBlockHeader(LzwBlockType type, LzwMethod blockMethod, size_t rawSize, size_t payloadSize);
+
+	/// Window size, 0 without deduplication
+	size_t dedupWindow() const {
+		return dedup ? dedup->capacity() : 0;
+	}
+	/// Sets code writer of encoder, it's created with dictionary part of memory limit
+	void prepareEncoder(std::shared_ptr<ICodeWriter> writer);
+
+	/// Codes data into payload, returns false when coding expands data
+	bool codeBlock(const char* data, size_t size, LzwMethod blockMethod, std::string& payload);
+
+	/**
+	 * Writes segment of run continued after sync flush, run is started when none is open.
+	 * @param sync segment ends by sync flush, otherwise it ends the run
+	 */
+	void writeSegment(const char* data, size_t size, bool sync);
+
+	std::ostream* stream;
+	LzwMethod method;
+	size_t blockSize;
+	size_t memoryLimit;
+	size_t peak;
+	size_t dedupPeak;			/// peak bytes of dedup window
+	double autoTolerance;
+	/// Last automatically selected method, LZW_METHOD_AUTO when none is selected yet
+	LzwMethod autoMethod;
+	size_t autoCoded;			/// bytes coded by autoMethod
+	/// Level stored in header, 0 for stream without level
+	int level;
+	unsigned resetWidth;
+	/// Block is stored without coding it whole when its prefix doesn't compress, see PROBE_SIZE
+	bool probe;
+
+	std::vector<char> buffer;
+	bool closed;
+
+	bool checkpoint;
+	uint64_t offset;			/// bytes written to stream
+	uint64_t lastBlockOffset;	/// offset of last block if it isn't full, else offset
+
+	/// Encoder reused by blocks, it writes to coded which has to be destroyed after it
+	std::ostringstream coded;
+	std::unique_ptr<LzwEncoder> encoder;
+	/// Encoder keeps state of run of sync blocks, next block continues it
+	bool segmentOpen;
+	LzwMethod segmentMethod;
+
+	/// Chunk window, null when deduplication is disabled
+	std::unique_ptr<DedupIndex> dedup;
+	/// Next dedup block tells reader to start window again
+	bool dedupRestart;
+	std::vector<uint32_t> recipe;
+	std::string literals;
+	std::vector<LzwRun> runs;
+};
+
+/**
+ * Reader of block LZW stream written by LzwBlockWriter.
+ */
+class LzwBlockReader
+{
+public:
+	/**
+	 * Constructs reader.
+	 * @param stream input stream positioned just after stream header
+	 * @param memoryLimit dictionary memory limit of decoder, see LzwDecoder
+	 */
+	explicit LzwBlockReader(std::istream* stream, size_t memoryLimit = MemoryBudget::UNLIMITED)
+		: stream(stream), memoryLimit(memoryLimit), peak(0), pool(nullptr), historyPeak(0), segmentMethod(LZW_METHOD_VARIABLE),
+		segmentStream(&segmentBuf) { }
+
+	/**
+	 * Decodes next block to out.
+	 * @return false when end of stream was reached
+	 * @throws std::runtime_error on malformed stream
+	 */
+	bool decodeBlock(std::ostream& out);
+
+	/**
+	 * Decodes all remaining blocks to out.
+	 */
+	void decode(std::ostream& out);
+
+	/**
+	 * Starts reading new stream, decoder and buffers are reused.
+	 * @param stream input stream positioned just after stream header
+	 */
+	void reset(std::istream* stream) {
+		this->stream = stream;
+		history.reset();
+		segmentReader.reset();
+	}
+
+	/// Peak dictionary memory of all blocks decoded so far together with peak of dedup window
+	size_t peakMemory() const {
+		return peak + historyPeak;
+	}
+
+	/**
+	 * Sets pool expanding strings of coded blocks, see LzwDecoder::decode(std::ostream&, ThreadPool&).
+	 * Runs of sync blocks are decoded serially.
+	 * @param pool pool which outlives this instance, null decodes serially
+	 */
+	void setThreadPool(ThreadPool* pool) {
+		this->pool = pool;
+	}
+private:
+	/// Sets code reader of decoder, it's created with dictionary part of memory limit
+	void prepareDecoder(std::shared_ptr<ICodeReader> reader);
+	/// Decodes LZW coded data to decoded
+	void decodePayload(LzwMethod method, const char* data, size_t size);
+	void decodeDedupBlock(LzwMethod method, size_t rawSize, std::ostream& out);
+	void decodeRunsBlock(LzwMethod method, size_t rawSize, std::ostream& out);
+	/// Writes length bytes equal to byte
+	void writeRun(std::ostream& out, char byte, uint64_t length);
+	/// Skips hole when out is seekable file, so file gets hole too, other output gets zeros
+	void writeHole(std::ostream& out, uint64_t length);
+	/// Decodes payload of sync block or coded block ending run of them to decoded
+	void decodeSegment(LzwMethod method, bool sync);
+
+	std::istream* stream;
+	size_t memoryLimit;
+	size_t peak;
+	ThreadPool* pool;
+
+	std::string payload;
+	std::string decoded;
+	/// Decoder reused by blocks
+	std::unique_ptr<LzwDecoder> decoder;
+
+	/// Chunk window, created by first dedup block
+	std::unique_ptr<DedupHistory> history;
+	size_t historyPeak;			/// peak bytes of history
+	std::vector<uint32_t> recipe;
+	std::vector<LzwRun> runs;
+	/// Bytes of last expanded run, written out repeatedly
+	std::vector<char> runBuffer;
+
+	/// Code reader of open run of sync blocks, null when there is none
+	std::shared_ptr<ICodeReader> segmentReader;
+	LzwMethod segmentMethod;
+	MemoryInputBuf segmentBuf;
+	std::istream segmentStream;
+};
+
+/**
+ * Reads stream header, level of stream with it is checked and skipped.
+ * @return stream version
+ * @throws std::runtime_error on bad magic or level
+ */
+uint8_t readLzwStreamHeader(std::istream& in);
+
+/**
+ * Sums decompressed size of block stream from its block headers without decoding it.
+ * Members of multi-member stream are summed too.
+ * @param in stream positioned at stream header
+ * @throws std::runtime_error on malformed stream or legacy stream which has no sizes
+ */
+uint64_t lzwDecodedSize(std::istream& in);
+
+/**
+ * Appends complete block stream as next member of multi-member stream, member is copied without
+ * decoding. Its checkpoint is moved by offset, so stream still can be appended to.
+ * Streams of legacy versions can't be members, decoder reads them to end of input.
+ * @param member seekable stream positioned at its start
+ * @param offset offset of member in out
+ * @return size of member
+ * @throws std::runtime_error when member isn't complete block stream or on I/O error
+ */
+uint64_t appendLzwMember(std::istream& member, std::ostream& out, uint64_t offset);
+
+/**
+ * Decompresses LZW stream of any supported version including stream header.
+ * Members of multi-member stream are decoded one after another.
+ * @param memoryLimit dictionary memory limit of decoder, see LzwDecoder
+ * @param pool pool expanding decoded strings in parallel, null decodes serially
+ * @return peak dictionary memory used
+ * @throws std::runtime_error on malformed stream or when stream needs more memory than limit
+ */
+size_t decompressLzwStream(std::istream& in, std::ostream& out, size_t memoryLimit = MemoryBudget::UNLIMITED,
+	ThreadPool* pool = nullptr);
+
+#endif // !LZW_BLOCK_H
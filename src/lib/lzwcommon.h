@@ -9,8 +9,12 @@
 #define LZW_COMMON_H
 
 #include "arithmcodec.h"
+#include "rangecoder.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
+#include <memory>
 
 /**
  * Generator for LZW codes.
@@ -116,9 +120,236 @@ protected:
 	static const size_t MAX_CODE_LEN = 16;
 	static const size_t MAX_CODE = (1U << MAX_CODE_LEN) - 1;
 
-	LzwArithmeticCoding() : LzwSimpleCoding(INIT_NEXT_CODE, MAX_CODE), dataModel(MAX_CODE + 1) { }
+	/**
+	 * @param powerOfTwoModel use PowerOfTwoDataModel, so coder doesn't divide
+	 * @param precision interval size of coder in bytes
+	 */
+	LzwArithmeticCoding(bool powerOfTwoModel, size_t precision) : LzwSimpleCoding(INIT_NEXT_CODE, MAX_CODE) {
+		// wider interval keeps precision with larger total, so unused codes take less of it
+		if (powerOfTwoModel)
+			dataModel.reset(new PowerOfTwoDataModel(MAX_CODE + 1, precision >= sizeof(uint64_t) ? 28 : 22));
+		else
+			dataModel.reset(new AdaptiveDataModel(MAX_CODE + 1));
+	}
+
+	std::unique_ptr<DataModel> dataModel;
+};
+
+/**
+ * Memory accounting of one coding context.
+ * Codec reports bytes it holds and checks if more fits to limit, so memory of
+ * coding doesn't depend on how repetitive input is.
+ */
+class MemoryBudget
+{
+public:
+	static const size_t UNLIMITED = SIZE_MAX;
+	/// Estimated bytes of dictionary entry besides its string, node of map and string object
+	static const size_t DICTIONARY_ENTRY_OVERHEAD = 64;
+	/// Smallest limit accepted by LZW coders, initial dictionary has to fit with room to grow
+	static const size_t MIN_LZW_LIMIT = 1 << 16;
+
+	explicit MemoryBudget(size_t limit = UNLIMITED) : limitBytes(limit), currentBytes(0), peakBytes(0) { }
+
+	/// Estimated memory of dictionary entry with string of given length, same for encoder and decoder
+	static size_t dictionaryEntry(size_t length) {
+		return DICTIONARY_ENTRY_OVERHEAD + length;
+	}
+
+	/// True when bytes can be allocated without exceeding limit
+	bool fits(size_t bytes) const {
+		return bytes <= limitBytes - std::min(currentBytes, limitBytes);
+	}
+
+	void allocate(size_t bytes) {
+		currentBytes += bytes;
+		if (currentBytes > peakBytes)
+			peakBytes = currentBytes;
+	}
+
+	void release(size_t bytes) {
+		currentBytes -= std::min(bytes, currentBytes);
+	}
+
+	void releaseAll() {
+		currentBytes = 0;
+	}
+
+	size_t limit() const {
+		return limitBytes;
+	}
+
+	/// Bytes currently held
+	size_t current() const {
+		return currentBytes;
+	}
+
+	/// Maximum of bytes held at once
+	size_t peak() const {
+		return peakBytes;
+	}
+private:
+	size_t limitBytes;
+	size_t currentBytes;
+	size_t peakBytes;
+};
+
+/**
+ * Follows dictionary size from sequence of codes. Dictionary grows by one code with
+ * every code, so code readers know range of next code without waiting for decoder.
+ */
+class DictionarySizeTracker
+{
+public:
+	/**
+	 * @param initialSize number of codes in dictionary after start or reset
+	 * @param maxSize dictionary size limit
+	 * @param resetCode code indicating dictionary reset
+	 */
+	DictionarySizeTracker(size_t initialSize, size_t maxSize, size_t resetCode)
+		: initialSize(initialSize), maxSize(maxSize), resetCode(resetCode), codeCount(0) { }
+
+	/// Counts written or read code
+	void count(size_t code) {
+		codeCount = code == resetCode ? 0 : codeCount + 1;
+	}
+
+	/// Largest code which can come next
+	size_t newestCode() const {
+		size_t size = initialSize + codeCount;
+		return (size < maxSize ? size : maxSize) - 1;
+	}
+private:
+	size_t initialSize;
+	size_t maxSize;
+	size_t resetCode;
+	size_t codeCount;		/// codes since start or dictionary reset
+};
+
+/**
+ * Base class for HuffmanCodeReader and HuffmanCodeWriter.
+ * Reset code, end code and codes of single bytes have own Huffman symbol. Other codes
+ * are coded by distance from newest dictionary code because recently added strings
+ * are used more often. Short distances have own symbol, longer are split to bucket
+ * given by their length and bits following MSB, which is Huffman coded, and remaining
+ * low bits which are written as they are.
+ */
+class LzwHuffmanCoding : public LzwSimpleCoding
+{
+protected:
+	static const size_t CODE_END = 0;			// code terminating Huffman coded codes
+	static const size_t CODE_DICT_RESET = 1;	// code indicating that dictionary has been reseted
+
+	static const size_t INIT_NEXT_CODE = 2;
+	static const size_t MAX_CODE_LEN = 16;
+	static const size_t MAX_CODE = (1U << MAX_CODE_LEN) - 1;
+
+	static const size_t DIRECT_CODES = INIT_NEXT_CODE + 256;	// codes having own symbol
+	static const size_t BUCKET_BITS = 4;		// bits after MSB selecting bucket
+	static const size_t DIRECT_DISTANCES = 1U << (BUCKET_BITS + 1);	// distances having own symbol
+	static const size_t MIN_BUCKET_LEN = BUCKET_BITS + 2;		// length of smallest distance in bucket
+	static const size_t NUM_SYMBOLS = DIRECT_CODES + DIRECT_DISTANCES
+		+ ((MAX_CODE_LEN - MIN_BUCKET_LEN + 1) << BUCKET_BITS);
+
+	LzwHuffmanCoding() : LzwSimpleCoding(INIT_NEXT_CODE, MAX_CODE), dictSize(DIRECT_CODES, MAX_CODE, CODE_DICT_RESET) { }
+
+	/**
+	 * Splits code to Huffman symbol and extra bits.
+	 * @retval extraBits number of extra bits, they are the low bits of distance
+	 * @return symbol
+	 */
+	size_t symbolOf(size_t code, size_t& distance, size_t& extraBits) const {
+		extraBits = 0;
+		if (code < DIRECT_CODES)
+			return code;
+
+		distance = dictSize.newestCode() - code;
+		if (distance < DIRECT_DISTANCES)
+			return DIRECT_CODES + distance;
+
+		size_t length = MIN_BUCKET_LEN;
+		while ((distance >> length) != 0)
+			length++;
+		extraBits = length - 1 - BUCKET_BITS;
+		size_t bucket = (distance >> extraBits) & ((1U << BUCKET_BITS) - 1);
+		return DIRECT_CODES + DIRECT_DISTANCES + ((length - MIN_BUCKET_LEN) << BUCKET_BITS) + bucket;
+	}
+
+	/// Number of extra bits following symbol
+	static size_t extraBitsOf(size_t symbol) {
+		if (symbol < DIRECT_CODES + DIRECT_DISTANCES)
+			return 0;
+		return ((symbol - DIRECT_CODES - DIRECT_DISTANCES) >> BUCKET_BITS) + MIN_BUCKET_LEN - 1 - BUCKET_BITS;
+	}
+
+	/// Distance of symbol which isn't direct code from newest dictionary code
+	static size_t distanceOf(size_t symbol, size_t extra) {
+		if (symbol < DIRECT_CODES + DIRECT_DISTANCES)
+			return symbol - DIRECT_CODES;
+
+		size_t extraBits = extraBitsOf(symbol);
+		size_t bucket = (symbol - DIRECT_CODES - DIRECT_DISTANCES) & ((1U << BUCKET_BITS) - 1);
+		return (size_t(1) << (extraBits + BUCKET_BITS)) | (bucket << extraBits) | extra;
+	}
+
+	/// True when symbol is direct code or its distance doesn't point before first code
+	bool validSymbol(size_t symbol, size_t extra) const {
+		return symbol < DIRECT_CODES || distanceOf(symbol, extra) <= dictSize.newestCode();
+	}
+
+	/// Joins symbol and its extra bits back to code
+	size_t codeOf(size_t symbol, size_t extra) const {
+		if (symbol < DIRECT_CODES)
+			return symbol;
+		return dictSize.newestCode() - distanceOf(symbol, extra);
+	}
 
-	AdaptiveDataModel dataModel;
+	DictionarySizeTracker dictSize;
+};
+
+/**
+ * Base class for BitTreeCodeReader and BitTreeCodeWriter.
+ * Codes are coded by binary range coder as sequence of bits. Models are selected
+ * by current code width, high bits of code are coded by bit tree and every low bit
+ * has own probability. Whole model has few kilobytes so it stays in cache.
+ */
+class LzwBitTreeCoding : public LzwSimpleCoding
+{
+protected:
+	static const size_t CODE_END = 0;			// code terminating coded codes
+	static const size_t CODE_DICT_RESET = 1;	// code indicating that dictionary has been reseted
+
+	static const size_t INIT_NEXT_CODE = 2;
+	static const size_t MAX_CODE_LEN = 16;
+	static const size_t MAX_CODE = (1U << MAX_CODE_LEN) - 1;
+
+	static const unsigned TREE_BITS = 8;		// high bits of code coded by bit tree
+
+	LzwBitTreeCoding() : LzwSimpleCoding(INIT_NEXT_CODE, MAX_CODE),
+		dictSize(INIT_NEXT_CODE + 256, MAX_CODE, CODE_DICT_RESET) { }
+
+	/// Code width given by dictionary size, it selects models
+	unsigned codeWidth() const {
+		unsigned width = TREE_BITS;
+		while ((dictSize.newestCode() >> width) != 0)
+			width++;
+		return width;
+	}
+
+	/// Bit tree for high bits of code of given width
+	BitProbability* treeModel(unsigned width) {
+		return treeProbs[width];
+	}
+
+	/// Probability of low bit of code of given width
+	BitProbability& lowModel(unsigned width, unsigned bit) {
+		return lowProbs[width][bit];
+	}
+
+	DictionarySizeTracker dictSize;
+private:
+	BitProbability treeProbs[MAX_CODE_LEN + 1][1 << TREE_BITS];
+	BitProbability lowProbs[MAX_CODE_LEN + 1][MAX_CODE_LEN];
 };
 
 #endif // !LZW_COMMON_H
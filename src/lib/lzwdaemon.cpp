@@ -0,0 +1,695 @@
+/**
+ * @file lzwdaemon.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "lzwdaemon.h"
+#include "memstream.h"
+
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+// memory files are passed only sealed, so sender can't shrink or change them under mapping of receiver
+#if defined(SYS_memfd_create) && defined(F_SEAL_SHRINK)
+#define MUL13_HAVE_MEMFD
+#endif
+
+namespace {
+
+/// Message type, flags and payload size
+const size_t HEADER_SIZE = 10;
+/// Payload is in memory file passed with header
+const uint8_t FLAG_MEMORY_FILE = 1;
+
+const char REQUEST_COMPRESS = 'C';
+const char REQUEST_DECOMPRESS = 'D';
+const char REPLY_OK = 'O';
+const char REPLY_ERROR = 'E';
+
+/// Client which doesn't read its reply can hold daemon for this long
+const int CLIENT_TIMEOUT_SECONDS = 5;
+
+#ifdef MUL13_HAVE_MEMFD
+const unsigned MEMFD_CLOEXEC = 1;
+const unsigned MEMFD_ALLOW_SEALING = 2;
+const int MEMORY_FILE_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+/// Seals received memory file must have, so sender can't change payload while it's coded
+const int REQUIRED_SEALS = F_SEAL_SHRINK | F_SEAL_WRITE;
+/// Larger payloads have to come in memory file
+const uint64_t MAX_INLINE_PAYLOAD = LzwDaemon::INLINE_LIMIT;
+#else
+const uint64_t MAX_INLINE_PAYLOAD = LzwDaemon::MAX_PAYLOAD;
+#endif
+
+/**
+ * Payload of message, small one in memory, large one in mapped memory file.
+ */
+class Payload
+{
+public:
+	Payload() : fd(-1), mapped(nullptr), mappedSize(0), length(0) { }
+
+	~Payload() {
+		release();
+	}
+
+	/// Allocates writable payload, it is memory file when it's large and system has them
+	void allocate(size_t size) {
+		release();
+#ifdef MUL13_HAVE_MEMFD
+		// receiver doesn't take large payload inline
+		if (size > LzwDaemon::INLINE_LIMIT) {
+			fd = static_cast<int>(syscall(SYS_memfd_create, "lzwd", MEMFD_CLOEXEC | MEMFD_ALLOW_SEALING));
+			if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0)
+				throw std::runtime_error("unable to allocate memory file");
+			map(size, PROT_READ | PROT_WRITE);
+			return;
+		}
+#endif
+		resize(size);
+	}
+
+	/**
+	 * Takes memory file passed with message header.
+	 * @param passedFd memory file, it is owned by payload even when it's rejected
+	 * @throws std::runtime_error when file isn't sealed against writes and shrinking or is too small
+	 */
+	void adopt(int passedFd, uint64_t size);
+
+	/// Resizes inline payload, its data are kept
+	void resize(size_t size) {
+		buffer.resize(size);
+		length = size;
+	}
+
+	/// Truncates written payload, memory file can't be written after it
+	void seal(size_t size) {
+		if (fd < 0) {
+			resize(size);
+			return;
+		}
+#ifdef MUL13_HAVE_MEMFD
+		unmap();
+		if (ftruncate(fd, static_cast<off_t>(size)) != 0 || fcntl(fd, F_ADD_SEALS, MEMORY_FILE_SEALS) != 0)
+			throw std::runtime_error("unable to seal memory file");
+		length = size;
+#endif
+	}
+
+	char* data() {
+		return mapped ? mapped : buffer.data();
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	/// Memory file with payload, -1 when payload is inline
+	int descriptor() const {
+		return fd;
+	}
+private:
+	Payload(const Payload&);
+	Payload& operator=(const Payload&);
+
+	void map(size_t size, int protection) {
+		length = size;
+		if (size == 0)
+			return;
+		void* memory = mmap(nullptr, size, protection, MAP_SHARED, fd, 0);
+		if (memory == MAP_FAILED)
+			throw std::runtime_error("unable to map memory file");
+		mapped = static_cast<char*>(memory);
+		mappedSize = size;
+	}
+
+	void unmap() {
+		if (mapped)
+			munmap(mapped, mappedSize);
+		mapped = nullptr;
+		mappedSize = 0;
+	}
+
+	void release() {
+		unmap();
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+		buffer.clear();
+		length = 0;
+	}
+
+	int fd;
+	char* mapped;
+	size_t mappedSize;
+	size_t length;
+	std::vector<char> buffer;
+};
+
+void sendAll(int socket, const char* data, size_t size) {
+	while (size > 0) {
+		auto ret = send(socket, data, size, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("unable to send message");
+		}
+		data += ret;
+		size -= static_cast<size_t>(ret);
+	}
+}
+
+void Payload::adopt(int passedFd, uint64_t size) {
+	release();
+	fd = passedFd;
+#ifdef MUL13_HAVE_MEMFD
+	struct stat info;
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || (seals & REQUIRED_SEALS) != REQUIRED_SEALS || fstat(fd, &info) != 0
+		|| static_cast<uint64_t>(info.st_size) < size)
+		throw std::runtime_error("passed file isn't sealed memory file of payload size");
+	map(static_cast<size_t>(size), PROT_READ);
+#else
+	(void)size;
+	throw std::runtime_error("memory files are not supported");
+#endif
+}
+
+void encodeHeader(char* header, char type, uint8_t flags, uint64_t size) {
+	header[0] = type;
+	header[1] = static_cast<char>(flags);
+	for (size_t i = 0; i < 8; ++i)
+		header[2 + i] = static_cast<char>((size >> (CHAR_BIT * i)) & 0xFF);
+}
+
+/**
+ * Sends message with payload in socket or in memory file.
+ * @param fd memory file with payload or -1 when data is sent inline
+ */
+void sendMessage(int socket, char type, const char* data, uint64_t size, int fd) {
+	char header[HEADER_SIZE];
+	encodeHeader(header, type, fd >= 0 ? FLAG_MEMORY_FILE : 0, size);
+
+	iovec iov[2];
+	iov[0].iov_base = header;
+	iov[0].iov_len = HEADER_SIZE;
+	iov[1].iov_base = const_cast<char*>(data);
+	iov[1].iov_len = fd >= 0 ? 0 : static_cast<size_t>(size);
+
+	msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	union {
+		cmsghdr align;
+		char buffer[CMSG_SPACE(sizeof(int))];
+	} control;
+	if (fd >= 0) {
+		std::memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buffer;
+		msg.msg_controllen = sizeof(control.buffer);
+		auto cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	ssize_t ret;
+	do {
+		ret = sendmsg(socket, &msg, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		throw std::runtime_error("unable to send message");
+
+	// descriptor went with first byte, the rest is sent as plain data
+	auto sent = static_cast<size_t>(ret);
+	if (sent < HEADER_SIZE) {
+		sendAll(socket, header + sent, HEADER_SIZE - sent);
+		sent = HEADER_SIZE;
+	}
+	if (fd < 0)
+		sendAll(socket, data + (sent - HEADER_SIZE), static_cast<size_t>(size) - (sent - HEADER_SIZE));
+}
+
+/**
+ * Reads message from socket in parts as they arrive, so waiting for slow sender
+ * doesn't hold other connections.
+ */
+class MessageReader
+{
+public:
+	MessageReader() : received(0), passedFd(-1), payloadSize(0), payloadReceived(0), ended(false) { }
+
+	~MessageReader() {
+		if (passedFd >= 0)
+			close(passedFd);
+	}
+
+	/**
+	 * Reads part of message which socket has.
+	 * @param wait wait until message is complete or connection is closed
+	 * @return true when message is complete, next read starts new message
+	 * @throws std::runtime_error on malformed message or connection closed in middle of it
+	 */
+	bool read(int socket, bool wait);
+
+	/// Connection was closed between messages
+	bool closed() const {
+		return ended;
+	}
+
+	/// Type of complete message
+	char type() const {
+		return header[0];
+	}
+
+	/// Payload of complete message, it goes to caller
+	std::unique_ptr<Payload> takePayload() {
+		return std::move(payload);
+	}
+private:
+	MessageReader(const MessageReader&);
+	MessageReader& operator=(const MessageReader&);
+
+	/// Checks complete header and prepares payload for it
+	void startPayload();
+
+	char header[HEADER_SIZE];
+	size_t received;			/// bytes of header
+	int passedFd;				/// memory file passed with header
+	std::unique_ptr<Payload> payload;
+	uint64_t payloadSize;
+	uint64_t payloadReceived;
+	bool ended;
+};
+
+bool MessageReader::read(int socket, bool wait) {
+	int flags = wait ? 0 : MSG_DONTWAIT;
+	while (received < HEADER_SIZE) {
+		iovec iov;
+		iov.iov_base = header + received;
+		iov.iov_len = HEADER_SIZE - received;
+
+		union {
+			cmsghdr align;
+			char buffer[CMSG_SPACE(sizeof(int))];
+		} control;
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buffer;
+		msg.msg_controllen = sizeof(control.buffer);
+
+		auto ret = recvmsg(socket, &msg, flags | MSG_CMSG_CLOEXEC);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+			throw std::runtime_error("unable to receive message");
+		}
+		if (ret == 0) {
+			if (received != 0)
+				throw std::runtime_error("connection closed in middle of message");
+			ended = true;
+			return false;
+		}
+
+		// descriptors over the one expected are closed
+		for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			int passed;
+			std::memcpy(&passed, CMSG_DATA(cmsg), sizeof(int));
+			if (passedFd >= 0)
+				close(passed);
+			else
+				passedFd = passed;
+		}
+		received += static_cast<size_t>(ret);
+		if (received == HEADER_SIZE)
+			startPayload();
+	}
+
+	while (payloadReceived < payloadSize) {
+		// inline buffer grows with received data, so size in header alone doesn't allocate it
+		payload->resize(static_cast<size_t>(std::min<uint64_t>(payloadSize, payloadReceived + LzwDaemon::INLINE_LIMIT)));
+		auto ret = recv(socket, payload->data() + payloadReceived, payload->size() - static_cast<size_t>(payloadReceived), flags);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return false;
+			throw std::runtime_error("unable to receive message");
+		}
+		if (ret == 0)
+			throw std::runtime_error("connection closed in middle of message");
+		payloadReceived += static_cast<uint64_t>(ret);
+	}
+
+	received = 0;
+	payloadSize = payloadReceived = 0;
+	return true;
+}
+
+void MessageReader::startPayload() {
+	uint64_t size = 0;
+	for (size_t i = 0; i < 8; ++i)
+		size |= static_cast<uint64_t>(static_cast<uint8_t>(header[2 + i])) << (CHAR_BIT * i);
+
+	payload.reset(new Payload());
+	int fd = passedFd;
+	passedFd = -1;
+	if (fd >= 0) {
+		// payload owns descriptor, it's closed with it when message is rejected
+		payload->adopt(fd, std::min(size, LzwDaemon::MAX_PAYLOAD));
+		if ((header[1] & FLAG_MEMORY_FILE) == 0)
+			throw std::runtime_error("memory file doesn't match message header");
+	} else if ((header[1] & FLAG_MEMORY_FILE) != 0)
+		throw std::runtime_error("memory file doesn't match message header");
+	if (size > LzwDaemon::MAX_PAYLOAD)
+		throw std::runtime_error("payload over size limit");
+
+	payloadSize = size;
+	payloadReceived = 0;
+	if (fd >= 0)
+		payloadReceived = size;
+	else if (size > MAX_INLINE_PAYLOAD)
+		throw std::runtime_error("inline payload over size limit");
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	if (path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("socket path is too long: " + path);
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size());
+	return address;
+}
+
+int connectSocket(const std::string& path) {
+	auto address = socketAddress(path);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+		auto error = errno;
+		close(fd);
+		errno = error;
+		return -1;
+	}
+	return fd;
+}
+
+}
+
+const size_t LzwDaemon::INLINE_LIMIT;
+const uint64_t LzwDaemon::MAX_PAYLOAD;
+const size_t LzwDaemon::MAX_BATCH;
+
+struct LzwDaemon::Request
+{
+	int client;
+	char type;
+	std::unique_ptr<Payload> input;
+	std::unique_ptr<Payload> output;
+	LzwBatchResult result;
+};
+
+struct LzwDaemon::Connection
+{
+	explicit Connection(int fd) : fd(fd) { }
+
+	~Connection() {
+		close(fd);
+	}
+
+	int fd;
+	/// Message received so far, its rest is waited for by poll with other connections
+	MessageReader reader;
+};
+
+LzwDaemon::LzwDaemon(const std::string& socketPath, size_t threads, LzwMethod method, size_t memoryLimit)
+	: socketPath(socketPath), listenFd(-1), pool(threads), codec(pool, method, memoryLimit),
+	stopping(false), requests(0), batches(0), largestBatch(0) {
+	wakeFds[0] = wakeFds[1] = -1;
+	try {
+		auto address = socketAddress(socketPath);
+		if (pipe2(wakeFds, O_CLOEXEC | O_NONBLOCK) != 0)
+			throw std::runtime_error("unable to create pipe");
+
+		// socket file is left behind by daemon which didn't exit cleanly
+		int running = connectSocket(socketPath);
+		if (running >= 0) {
+			close(running);
+			throw std::runtime_error("other daemon listens on " + socketPath);
+		}
+		if (errno == ECONNREFUSED)
+			unlink(socketPath.c_str());
+
+		listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+		if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+			throw std::runtime_error("unable to bind socket " + socketPath);
+		if (listen(listenFd, SOMAXCONN) != 0) {
+			unlink(socketPath.c_str());
+			throw std::runtime_error("unable to listen on socket " + socketPath);
+		}
+	} catch (std::runtime_error& e) {
+		for (int fd : { listenFd, wakeFds[0], wakeFds[1] }) {
+			if (fd >= 0)
+				close(fd);
+		}
+		throw std::runtime_error(std::string("LzwDaemon: ") + e.what());
+	}
+}
+
+LzwDaemon::~LzwDaemon() {
+	connections.clear();
+	close(listenFd);
+	close(wakeFds[0]);
+	close(wakeFds[1]);
+	unlink(socketPath.c_str());
+}
+
+void LzwDaemon::stop() {
+	stopping = true;
+	char byte = 0;
+	// full pipe already wakes up poll
+	if (write(wakeFds[1], &byte, 1) < 0)
+		return;
+}
+
+void LzwDaemon::run() {
+	std::vector<pollfd> fds;
+	std::vector<Request> batch;
+	while (!stopping) {
+		fds.clear();
+		pollfd wake = { wakeFds[0], POLLIN, 0 };
+		pollfd listening = { listenFd, POLLIN, 0 };
+		fds.push_back(wake);
+		fds.push_back(listening);
+		for (auto& connection : connections) {
+			pollfd ready = { connection->fd, POLLIN, 0 };
+			fds.push_back(ready);
+		}
+
+		if (poll(fds.data(), fds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("LzwDaemon: unable to wait for requests");
+		}
+
+		if (fds[0].revents != 0) {
+			char bytes[64];
+			while (read(wakeFds[0], bytes, sizeof(bytes)) > 0)
+				;
+			continue;
+		}
+
+		if ((fds[1].revents & POLLIN) != 0) {
+			// reads don't wait, replies are sent blocking with timeout
+			int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+			if (client >= 0) {
+				timeval timeout = { CLIENT_TIMEOUT_SECONDS, 0 };
+				setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+				connections.push_back(std::unique_ptr<Connection>(new Connection(client)));
+			}
+		}
+
+		// at most one request of every ready connection, clients send next request after reply
+		batch.clear();
+		std::vector<int> closed;
+		for (size_t i = 2; i < fds.size() && batch.size() < MAX_BATCH; ++i) {
+			if (fds[i].revents == 0)
+				continue;
+
+			auto& reader = connections[i - 2]->reader;
+			try {
+				if (reader.read(fds[i].fd, false)) {
+					Request request;
+					request.client = fds[i].fd;
+					request.type = reader.type();
+					request.input = reader.takePayload();
+					request.output.reset(new Payload());
+					batch.push_back(std::move(request));
+					continue;
+				}
+				// rest of message comes later
+				if (!reader.closed())
+					continue;
+			} catch (std::runtime_error&) {
+				// broken message leaves connection in unknown state
+			}
+			closed.push_back(fds[i].fd);
+		}
+
+		if (!batch.empty())
+			serve(batch);
+
+		for (auto client : closed)
+			drop(client);
+	}
+}
+
+void LzwDaemon::drop(int client) {
+	auto connection = std::find_if(connections.begin(), connections.end(),
+		[client] (const std::unique_ptr<Connection>& c) { return c->fd == client; });
+	if (connection != connections.end())
+		connections.erase(connection);
+}
+
+void LzwDaemon::serve(std::vector<Request>& batch) {
+	std::vector<size_t> compressing, decompressing;
+	for (size_t i = 0; i < batch.size(); ++i) {
+		auto& request = batch[i];
+		try {
+			auto& input = *request.input;
+			if (request.type == REQUEST_COMPRESS) {
+				request.output->allocate(LzwBatchCodec::compressBound(input.size()));
+				compressing.push_back(i);
+			} else if (request.type == REQUEST_DECOMPRESS) {
+				// output is sized by block headers, so it can be memory file of exact size
+				MemoryInputBuf buffer(input.data(), input.size());
+				std::istream stream(&buffer);
+				auto size = lzwDecodedSize(stream);
+				if (size > MAX_PAYLOAD)
+					throw std::runtime_error("Decompressed size over limit of daemon.");
+				request.output->allocate(static_cast<size_t>(size));
+				decompressing.push_back(i);
+			} else
+				throw std::runtime_error("Unknown request type.");
+			request.result.ok = true;
+		} catch (std::exception& e) {
+			request.result.ok = false;
+			request.result.error = e.what();
+		}
+	}
+
+	auto code = [&batch, this] (const std::vector<size_t>& indexes, bool compress) {
+		if (indexes.empty())
+			return;
+		std::vector<LzwInputSpan> inputs;
+		std::vector<LzwOutputSpan> outputs;
+		for (auto i : indexes) {
+			LzwInputSpan input = { batch[i].input->data(), batch[i].input->size() };
+			LzwOutputSpan output = { batch[i].output->data(), batch[i].output->size() };
+			inputs.push_back(input);
+			outputs.push_back(output);
+		}
+		auto results = compress ? codec.compress(inputs, outputs) : codec.decompress(inputs, outputs);
+		for (size_t j = 0; j < indexes.size(); ++j)
+			batch[indexes[j]].result = results[j];
+	};
+	code(compressing, true);
+	code(decompressing, false);
+
+	for (auto& request : batch) {
+		try {
+			if (request.result.ok) {
+				auto& output = *request.output;
+				output.seal(request.result.size);
+				sendMessage(request.client, REPLY_OK, output.data(), output.size(), output.descriptor());
+			} else
+				sendMessage(request.client, REPLY_ERROR, request.result.error.data(), request.result.error.size(), -1);
+		} catch (std::runtime_error&) {
+			drop(request.client);
+		}
+	}
+	requests += batch.size();
+	batches++;
+	if (batch.size() > largestBatch)
+		largestBatch = batch.size();
+}
+
+LzwDaemonClient::LzwDaemonClient(const std::string& socketPath) {
+	try {
+		fd = connectSocket(socketPath);
+	} catch (std::runtime_error& e) {
+		throw std::runtime_error(std::string("LzwDaemonClient: ") + e.what());
+	}
+	if (fd < 0)
+		throw std::runtime_error("LzwDaemonClient: unable to connect to " + socketPath);
+}
+
+LzwDaemonClient::~LzwDaemonClient() {
+	close(fd);
+}
+
+std::string LzwDaemonClient::compress(const char* data, size_t size) {
+	return request(REQUEST_COMPRESS, data, size);
+}
+
+std::string LzwDaemonClient::decompress(const char* data, size_t size) {
+	return request(REQUEST_DECOMPRESS, data, size);
+}
+
+std::string LzwDaemonClient::request(char type, const char* data, size_t size) {
+	try {
+		if (size > LzwDaemon::MAX_PAYLOAD)
+			throw std::runtime_error("payload over size limit");
+
+		// large request goes in memory file, it's mapped by daemon instead of copied through socket
+		Payload request;
+		if (size > LzwDaemon::INLINE_LIMIT)
+			request.allocate(size);
+		if (request.descriptor() >= 0) {
+			std::memcpy(request.data(), data, size);
+			request.seal(size);
+			sendMessage(fd, type, nullptr, size, request.descriptor());
+		} else
+			sendMessage(fd, type, data, size, -1);
+
+		MessageReader reader;
+		while (!reader.read(fd, true)) {
+			if (reader.closed())
+				throw std::runtime_error("daemon closed connection");
+		}
+		auto reply = reader.takePayload();
+		if (reader.type() == REPLY_ERROR)
+			throw std::runtime_error(std::string(reply->data(), reply->size()));
+		if (reader.type() != REPLY_OK)
+			throw std::runtime_error("unknown reply type");
+		return std::string(reply->data(), reply->size());
+	} catch (std::runtime_error& e) {
+		throw std::runtime_error(std::string("LzwDaemonClient: ") + e.what());
+	}
+}
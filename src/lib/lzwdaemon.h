@@ -0,0 +1,144 @@
+/**
+ * @file lzwdaemon.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef LZW_DAEMON_H
+#define LZW_DAEMON_H
+
+#include "lzwbatch.h"
+#include "threadpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Compression server on Unix domain socket, it saves start up of process and
+ * building of codec contexts to short requests.
+ *
+ * Every message is header (type byte, flags byte and 8 byte little endian payload size)
+ * followed by payload. Payloads up to INLINE_LIMIT are sent in socket, larger ones are
+ * written to memory file sealed against writes and shrinking whose descriptor is passed
+ * with header, so they are not copied through socket. Larger inline payload is rejected
+ * when system has memory files. Requests are compressed ('C') or decompressed ('D') data,
+ * reply is result ('O') or error message ('E'). Connection can send any number of requests,
+ * each one is replied before next one is read.
+ *
+ * Messages are read in parts as they arrive, so slow connection doesn't hold others.
+ * Requests completed on all connections are served together as one batch by LzwBatchCodec,
+ * its codec contexts stay warm between batches.
+ */
+class LzwDaemon
+{
+public:
+	/// Larger payloads are passed in memory file when system has them
+	static const size_t INLINE_LIMIT = 1 << 16;
+	/// Largest payload of request or reply
+	static const uint64_t MAX_PAYLOAD = 1ULL << 30;
+	/// Largest number of requests served by one batch
+	static const size_t MAX_BATCH = 256;
+
+	/**
+	 * Creates socket, stale socket file of not running daemon is replaced.
+	 * @param socketPath path of socket file
+	 * @param threads number of codec threads, 0 for number of cores
+	 * @param method method used to compress requests
+	 * @param memoryLimit dictionary memory limit of every codec context
+	 * @throws std::runtime_error when socket can't be created or other daemon listens on it
+	 */
+	LzwDaemon(const std::string& socketPath, size_t threads = 0, LzwMethod method = LZW_METHOD_VARIABLE,
+		size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	/// Closes connections and removes socket file
+	~LzwDaemon();
+
+	/**
+	 * Serves requests until stop is called.
+	 * @throws std::runtime_error when waiting for connections fails
+	 */
+	void run();
+
+	/// Makes run return after current batch, can be called from any thread or signal handler
+	void stop();
+
+	/// Number of served requests
+	uint64_t requestCount() const {
+		return requests;
+	}
+
+	/// Number of batches requests were served by
+	uint64_t batchCount() const {
+		return batches;
+	}
+
+	/// Number of requests of largest batch
+	uint64_t maxBatchSize() const {
+		return largestBatch;
+	}
+private:
+	struct Request;
+	struct Connection;
+
+	LzwDaemon(const LzwDaemon&);
+	LzwDaemon& operator=(const LzwDaemon&);
+
+	/// Codes requests and sends replies, connections which failed are closed
+	void serve(std::vector<Request>& batch);
+
+	/// Closes connection of client
+	void drop(int client);
+
+	std::string socketPath;
+	int listenFd;
+	int wakeFds[2];			/// stop writes to pipe waking up poll
+	std::vector<std::unique_ptr<Connection> > connections;
+
+	ThreadPool pool;
+	LzwBatchCodec codec;
+
+	std::atomic<bool> stopping;
+	std::atomic<uint64_t> requests;
+	std::atomic<uint64_t> batches;
+	std::atomic<uint64_t> largestBatch;
+};
+
+/**
+ * Client of LzwDaemon, one connection used for all its requests.
+ */
+class LzwDaemonClient
+{
+public:
+	/**
+	 * @throws std::runtime_error when daemon doesn't listen on socket
+	 */
+	explicit LzwDaemonClient(const std::string& socketPath);
+
+	~LzwDaemonClient();
+
+	/**
+	 * Compresses data by daemon.
+	 * @return block stream readable by decompressLzwStream
+	 * @throws std::runtime_error when request fails
+	 */
+	std::string compress(const char* data, size_t size);
+
+	/**
+	 * Decompresses block stream by daemon.
+	 * @throws std::runtime_error when request fails or stream is malformed
+	 */
+	std::string decompress(const char* data, size_t size);
+private:
+	LzwDaemonClient(const LzwDaemonClient&);
+	LzwDaemonClient& operator=(const LzwDaemonClient&);
+
+	std::string request(char type, const char* data, size_t size);
+
+	int fd;
+};
+
+#endif // !LZW_DAEMON_H
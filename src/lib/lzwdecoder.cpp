@@ -10,90 +10,389 @@
 #include <string>
 #include <stdexcept>
 #include <limits>
+#include <algorithm>
+
+const size_t VariableCodeReader::UNPACK_GROUP;
 
 bool VariableCodeReader::readNextCode(code_type& code) {
-	try {
-		code = reader.readBits(curBitLen);
-	} catch (std::exception&) {
-		return false;
-	}
+	return readCodes(&code, 1) == 1;
+}
+
+size_t VariableCodeReader::readCodes(code_type* codes, size_t count) {
+	uint32_t group[UNPACK_GROUP];
+	size_t n = 0;
+	while (n < count) {
+		// end of stream, incomplete last code is padding of last byte
+		size_t unpacked = reader.peekCodes(static_cast<unsigned>(curBitLen), std::min(UNPACK_GROUP, count - n), group);
+		if (unpacked == 0)
+			break;
 
-	// if we read mark indicating code length change
-	if (code == CODE_MARK) {
+		size_t used = 0;
+		while (used < unpacked && group[used] != CODE_MARK)
+			codes[n++] = group[used++];
+		if (used == unpacked) {
+			reader.skipBits(used * curBitLen);
+			continue;
+		}
+
+		// mark indicates code length change, codes after it are read again with new length
+		if (curBitLen == MAX_CODE_LEN)
+			throw std::runtime_error("VariableCodeReader: code length over maximum");
+		reader.skipBits((used + 1) * curBitLen);
 		curBitLen++;
-		return readNextCode(code);
 	}
+	return n;
+}
+
+template <size_t N>
+bool BasicArithmeticCodeReader<N>::readNextCode(code_type& code) {
+	return readCodes(&code, 1) == 1;
+}
+
+template <size_t N>
+size_t BasicArithmeticCodeReader<N>::readCodes(code_type* codes, size_t count) {
+	size_t n = 0;
+	while (!ended && n < count) {
+		auto code = decoder->decode(dataModel.get());
+		if (code == CODE_END || decoder->exhausted()) {
+			ended = true;
+			break;
+		}
+		if (code == CODE_DICT_RESET)
+			dataModel->reset();
+		codes[n++] = code;
+	}
+	return n;
+}
+
+template class BasicArithmeticCodeReader<sizeof(uint32_t)>;
+template class BasicArithmeticCodeReader<sizeof(uint64_t)>;
+
+size_t HuffmanCodeReader::readCodes(code_type* codes, size_t count) {
+	if (ended)
+		return 0;
+
+	if (!decoder) {
+		std::vector<uint8_t> lengths;
+		if (!HuffmanCode::readLengths(reader, lengths)) {
+			ended = true;
+			return 0;
+		}
+		// larger symbols would have more extra bits than any code
+		if (lengths.size() > NUM_SYMBOLS)
+			throw std::runtime_error("HuffmanCodeReader: code lengths of symbols outside of coding");
+		// symbols followed by extra bits can't share lookup with next symbol
+		decoder.reset(new HuffmanDecoder(lengths, DIRECT_CODES + DIRECT_DISTANCES));
+	}
+
+	size_t n = 0;
+	uint32_t symbols[2];
+	while (n < count) {
+		size_t decoded = decoder->decode(reader, symbols, count - n);
+		if (decoded == 0) {
+			ended = true;
+			break;
+		}
+
+		for (size_t i = 0; i < decoded; ++i) {
+			if (symbols[i] == CODE_END) {
+				ended = true;
+				return n;
+			}
 
-	return true;
+			size_t extra = 0;
+			if (!reader.readBits(extraBitsOf(symbols[i]), extra)) {
+				ended = true;
+				return n;
+			}
+			if (!validSymbol(symbols[i], extra))
+				throw std::runtime_error("HuffmanCodeReader: distance before first code");
+			codes[n] = codeOf(symbols[i], extra);
+			dictSize.count(codes[n++]);
+		}
+	}
+	return n;
 }
 
-bool ArithmeticCodeReader::readNextCode(code_type& code) {
-	try {
-		code = decoder->decode(&dataModel);
-	} catch (std::exception&) {
-		return false;
+size_t BitTreeCodeReader::readCodes(code_type* codes, size_t count) {
+	size_t n = 0;
+	while (!ended && n < count) {
+		unsigned width = codeWidth();
+		unsigned lowBits = width - TREE_BITS;
+		code_type code = decoder.decodeTree(treeModel(width), TREE_BITS);
+		for (unsigned i = 0; i < lowBits; ++i)
+			code = (code << 1) | (decoder.decode(lowModel(width, lowBits - 1 - i)) ? 1 : 0);
+
+		if (code == CODE_END || decoder.exhausted()) {
+			ended = true;
+			break;
+		}
+		dictSize.count(code);
+		codes[n++] = code;
 	}
+	return n;
+}
 
-	if (code == CODE_DICT_RESET) {
-		dataModel.reset();
-	} else if (code == CODE_END)
-		return false;
+const size_t LzwDecoder::CODE_BATCH;
+const size_t LzwDecoder::EXPANDED_FLUSH;
+const size_t LzwDecoder::PARALLEL_WINDOW;
+const size_t LzwDecoder::PARALLEL_CHUNK;
+const uint32_t LzwDecoder::NO_ENTRY;
 
-	return true;
+LzwDecoder::LzwDecoder(std::shared_ptr<ICodeReader> reader, size_t memoryLimit)
+	: codeReader(std::move(reader)), budget(memoryLimit),
+	dictionaryStart(0), firstPending(true), previousCode(0), previousChar(0) {
+	if (memoryLimit < MemoryBudget::MIN_LZW_LIMIT)
+		throw std::runtime_error("LzwDecoder: memory limit too small");
+	initDictionary();
 }
 
 void LzwDecoder::decode(std::ostream& out) {
-	size_t oldCode;
-	std::string codeStr;
-	char c;
-	firstRun(oldCode, codeStr, c);
-	out << codeStr;
-
-	size_t newCode;
-	while (codeReader->readNextCode(newCode)) {
-		// when codeReader read dict reset code we have to rebuild dictionary
-		if (newCode == codeReader->dictResetCode()) {
-			codeReader->generator()->reset();
-			initDictionary();
-			// we need to handle oldCode cos current oldCode is not valid now
-			firstRun(oldCode, codeStr, c);
-			out << codeStr;
-			continue;
+	ICodeReader::code_type codes[CODE_BATCH];
+	auto resetCode = codeReader->dictResetCode();
+	// state continues from previous segment of codes
+	bool first = firstPending;
+	size_t oldCode = previousCode;
+	char c = previousChar;
+
+	size_t count;
+	while ((count = codeReader->readCodes(codes, CODE_BATCH)) > 0) {
+		expanded.clear();
+		for (size_t i = 0; i < count; ++i) {
+			auto newCode = codes[i];
+
+			// when codeReader read dict reset code we have to rebuild dictionary
+			if (newCode == resetCode) {
+				codeReader->generator()->reset();
+				initDictionary();
+				// next code is handled as first one cos current oldCode is not valid now
+				first = true;
+				continue;
+			}
+
+			if (first) {
+				firstCode(newCode, c);
+				oldCode = newCode;
+				first = false;
+				continue;
+			}
+
+			auto it = dictionary.find(newCode);
+			const std::string& oldStr = dictionary.at(oldCode);
+			// newCode in dictionary
+			if (it != dictionary.end()) {
+				c = it->second[0];
+				expanded += it->second;
+			// newCode NOT in dictionary
+			} else {
+				c = oldStr[0];
+				expanded += oldStr;
+				expanded += c;
+			}
+
+			if (codeReader->generator()->haveNext())
+				addEntry(codeReader->generator()->next(), oldStr + c);
+			oldCode = newCode;
+
+			// long strings of repetitive input would make batch large
+			if (expanded.size() >= EXPANDED_FLUSH) {
+				out.write(expanded.data(), expanded.size());
+				expanded.clear();
+			}
+		}
+		out.write(expanded.data(), expanded.size());
+	}
+
+	firstPending = first;
+	previousCode = oldCode;
+	previousChar = c;
+}
+
+void LzwDecoder::decode(std::ostream& out, ThreadPool& pool) {
+	ICodeReader::code_type codes[CODE_BATCH];
+	auto resetCode = codeReader->dictResetCode();
+	// codes are assigned from start again, dictionary of serial decoding isn't used
+	codeReader->generator()->reset();
+	entries.clear();
+	initPrefixDictionary();
+
+	bool first = true;
+	uint32_t oldEntry = 0;
+	size_t count = 0, next = 0;
+	bool ended = false;
+	// first parsed code and output offset of every chunk of window
+	std::vector<std::pair<size_t, size_t>> chunks;
+	while (!ended) {
+		// codes are parsed to entries until their output fills window
+		parsed.clear();
+		chunks.clear();
+		size_t windowSize = 0;
+		while (windowSize < PARALLEL_WINDOW) {
+			if (next == count) {
+				count = codeReader->readCodes(codes, CODE_BATCH);
+				next = 0;
+				if (count == 0) {
+					ended = true;
+					break;
+				}
+			}
+			auto code = codes[next++];
+
+			if (code == resetCode) {
+				codeReader->generator()->reset();
+				initPrefixDictionary();
+				first = true;
+				continue;
+			}
+
+			uint32_t entry = code < codeEntries.size() ? codeEntries[code] : NO_ENTRY;
+			if (first) {
+				if (entry == NO_ENTRY || entries[entry].length != 1)
+					throw std::runtime_error("LzwDecoder::decode: first code doesn't correspond to one byte only!!!");
+				first = false;
+			} else {
+				// code not in dictionary is string added now, old string followed by its first byte
+				char c = entries[entry != NO_ENTRY ? entry : oldEntry].first;
+				uint32_t added = NO_ENTRY;
+				if (codeReader->generator()->haveNext()) {
+					auto bytes = MemoryBudget::dictionaryEntry(entries[oldEntry].length + 1);
+					if (!budget.fits(bytes))
+						throw std::runtime_error("LzwDecoder: dictionary exceeds memory limit");
+					budget.allocate(bytes);
+					added = addPrefixEntry(oldEntry, c);
+
+					auto newCode = codeReader->generator()->next();
+					if (newCode >= codeEntries.size())
+						codeEntries.resize(newCode + 1, NO_ENTRY);
+					codeEntries[newCode] = added;
+				}
+				if (entry == NO_ENTRY)
+					entry = added != NO_ENTRY ? added : addPrefixEntry(oldEntry, c);
+			}
+
+			if (windowSize >= chunks.size() * PARALLEL_CHUNK)
+				chunks.push_back(std::make_pair(parsed.size(), windowSize));
+			parsed.push_back(entry);
+			windowSize += entries[entry].length;
+			oldEntry = entry;
 		}
 
-		auto it = dictionary.find(newCode);
-		// newCode in dictionary
-		if (it != dictionary.end()) {
-			codeStr = it->second;
-		// newCode NOT in dictionary
-		} else {
-			codeStr = dictionary.at(oldCode);
-			codeStr += c;
+		// output offsets are known, so chunks are expanded independently
+		expanded.resize(windowSize);
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			size_t firstCode = chunks[i].first;
+			size_t lastCode = i + 1 < chunks.size() ? chunks[i + 1].first : parsed.size();
+			char* dest = &expanded[0] + chunks[i].second;
+			if (chunks.size() == 1)
+				expandCodes(firstCode, lastCode, dest);
+			else
+				pool.submit([this, firstCode, lastCode, dest] () { expandCodes(firstCode, lastCode, dest); });
 		}
+		if (chunks.size() > 1)
+			pool.wait();
+		out.write(expanded.data(), windowSize);
 
-		out << codeStr;
-		c = codeStr[0];
-		if (codeReader->generator()->haveNext())
-			dictionary[codeReader->generator()->next()] = dictionary.at(oldCode) + c;
-		oldCode = newCode;
+		oldEntry = compactPrefixDictionary(oldEntry);
 	}
 }
 
-void LzwDecoder::firstRun(size_t& code, std::string& codeStr, char& c) {
-	// read first code
-	codeReader->readNextCode(code);
-	codeStr = dictionary.at(code);
+void LzwDecoder::reset(std::shared_ptr<ICodeReader> reader) {
+	codeReader = std::move(reader);
+	initDictionary();
+}
+
+void LzwDecoder::firstCode(size_t code, char& c) {
+	auto& codeStr = dictionary.at(code);
 
 	// first code corresponds to one byte
 	if (codeStr.size() != 1)
 		throw std::runtime_error("LzwDecoder::decode: first code doesn't correspond to one byte only!!!");
 	c = codeStr[0];
+	expanded += c;
 }
 
 void LzwDecoder::initDictionary() {
 	// init dictionary with entry for each byte
 	dictionary.clear();
-	for (int b = 0; b <= std::numeric_limits<uint8_t>::max(); b++) {
-		dictionary[codeReader->generator()->next()] = std::string(1, b);
+	firstPending = true;
+	budget.releaseAll();
+	for (int b = 0; b <= std::numeric_limits<uint8_t>::max(); b++)
+		addEntry(codeReader->generator()->next(), std::string(1, b));
+}
+
+void LzwDecoder::initPrefixDictionary() {
+	const uint32_t SINGLE_BYTES = std::numeric_limits<uint8_t>::max() + 1;
+	if (entries.empty()) {
+		for (uint32_t b = 0; b < SINGLE_BYTES; b++) {
+			PrefixEntry entry = { 0, 1, static_cast<char>(b), static_cast<char>(b) };
+			entries.push_back(entry);
+		}
+	}
+
+	// entries of old dictionary stay until parsed codes using them are expanded
+	std::fill(codeEntries.begin(), codeEntries.end(), NO_ENTRY);
+	budget.releaseAll();
+	for (uint32_t b = 0; b < SINGLE_BYTES; b++) {
+		auto code = codeReader->generator()->next();
+		if (code >= codeEntries.size())
+			codeEntries.resize(code + 1, NO_ENTRY);
+		codeEntries[code] = b;
+		budget.allocate(MemoryBudget::dictionaryEntry(1));
+	}
+	dictionaryStart = static_cast<uint32_t>(entries.size());
+}
+
+uint32_t LzwDecoder::addPrefixEntry(uint32_t prefix, char last) {
+	PrefixEntry entry = { prefix, entries[prefix].length + 1, entries[prefix].first, last };
+	entries.push_back(entry);
+	return static_cast<uint32_t>(entries.size() - 1);
+}
+
+void LzwDecoder::expandCodes(size_t first, size_t last, char* dest) const {
+	for (size_t i = first; i < last; ++i) {
+		auto entry = parsed[i];
+		auto length = entries[entry].length;
+		// string is written from its last byte by walking prefixes
+		char* p = dest + length;
+		for (;;) {
+			auto& e = entries[entry];
+			*--p = e.last;
+			if (e.length == 1)
+				break;
+			entry = e.prefix;
+		}
+		dest += length;
+	}
+}
+
+uint32_t LzwDecoder::compactPrefixDictionary(uint32_t entry) {
+	const uint32_t SINGLE_BYTES = std::numeric_limits<uint8_t>::max() + 1;
+	if (dictionaryStart == SINGLE_BYTES)
+		return entry;
+
+	// entries of current dictionary have prefixes only in it or in single bytes
+	uint32_t shift = dictionaryStart - SINGLE_BYTES;
+	entries.erase(entries.begin() + SINGLE_BYTES, entries.begin() + dictionaryStart);
+	for (auto it = entries.begin() + SINGLE_BYTES; it != entries.end(); ++it) {
+		if (it->prefix >= SINGLE_BYTES)
+			it->prefix -= shift;
+	}
+	for (auto& codeEntry : codeEntries) {
+		if (codeEntry != NO_ENTRY && codeEntry >= SINGLE_BYTES)
+			codeEntry -= shift;
 	}
+	dictionaryStart = SINGLE_BYTES;
+	if (entry < SINGLE_BYTES)
+		return entry;
+	// entry before last reset isn't used anymore
+	return entry >= SINGLE_BYTES + shift ? entry - shift : 0;
+}
+
+void LzwDecoder::addEntry(ICodeReader::code_type code, std::string str) {
+	// encoder with the same limit resets dictionary before this happens
+	auto bytes = MemoryBudget::dictionaryEntry(str.size());
+	if (!budget.fits(bytes))
+		throw std::runtime_error("LzwDecoder: dictionary exceeds memory limit");
+	budget.allocate(bytes);
+	dictionary[code] = std::move(str);
 }
\ No newline at end of file
@@ -11,10 +11,15 @@
 #include "lzwcommon.h"
 #include "bitstream.h"
 #include "arithmdecoder.h"
+#include "huffman.h"
+#include "threadpool.h"
 
+#include <cstdint>
 #include <memory>
 #include <iostream>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #ifdef _MSC_VER
 // disable inheriting via dominance warning
@@ -36,7 +41,26 @@ public:
 	 */
 	virtual bool readNextCode(code_type& code) = 0;
 
+	/**
+	 * Reads up to count codes to array.
+	 * Readers override this to read whole batch without virtual call per code.
+	 * @return number of codes read, less than count only at end of stream
+	 */
+	virtual size_t readCodes(code_type* codes, size_t count) {
+		size_t n = 0;
+		while (n < count && readNextCode(codes[n]))
+			++n;
+		return n;
+	}
+
 	virtual code_type dictResetCode() const = 0;
+
+	/**
+	 * Continues reading by next segment of codes after ICodeWriter::syncFlush.
+	 * Coding state of previous segments is kept.
+	 * @param stream stream with next segment
+	 */
+	virtual void continueSegment(std::istream* stream) = 0;
 };
 
 /**
@@ -56,6 +80,10 @@ public:
 	virtual code_type dictResetCode() const {
 		return 0;
 	}
+
+	virtual void continueSegment(std::istream* stream) {
+		this->stream = stream;
+	}
 private:
 	std::istream* stream;
 };
@@ -67,60 +95,226 @@ private:
 class VariableCodeReader : public LzwVariableCoding, public ICodeReader
 {
 public:
+	/// Number of codes unpacked at once, runs of codes with same length are unpacked by SIMD
+	static const size_t UNPACK_GROUP = 16;
+
 	explicit VariableCodeReader(const BitStreamReader& reader) : reader(reader) { }
 	explicit VariableCodeReader(std::istream* stream) : reader(stream) { }
 
 	virtual bool readNextCode(code_type& code);
+	virtual size_t readCodes(code_type* codes, size_t count);
 
 	virtual code_type dictResetCode() const {
 		return CODE_DICT_RESET;
 	}
+
+	virtual void continueSegment(std::istream* stream) {
+		reader.reset(stream);
+	}
 private:
 	BitStreamReader reader;
 };
 
-class ArithmeticCodeReader : public LzwArithmeticCoding, public ICodeReader
+/**
+ * LZW codes reader for codes written by BasicArithmeticCodeWriter with the same N.
+ */
+template <size_t N>
+class BasicArithmeticCodeReader : public LzwArithmeticCoding, public ICodeReader
 {
 public:
-	explicit ArithmeticCodeReader(std::istream* stream) 
-		: decoder(std::make_shared<ArithmeticDecoder>(std::make_shared<BitStreamReader>(stream))) 
+	typedef BasicArithmeticDecoder<N> DecoderType;
+
+	explicit BasicArithmeticCodeReader(std::istream* stream, bool powerOfTwoModel = false) 
+		: LzwArithmeticCoding(powerOfTwoModel, N),
+		decoder(std::make_shared<DecoderType>(std::make_shared<BitStreamReader>(stream))), ended(false)
 	{ }
 
-	explicit ArithmeticCodeReader(std::shared_ptr<BitStreamReader> bsr) 
-		: decoder(std::make_shared<ArithmeticDecoder>(std::move(bsr))) 
+	explicit BasicArithmeticCodeReader(std::shared_ptr<BitStreamReader> bsr, bool powerOfTwoModel = false) 
+		: LzwArithmeticCoding(powerOfTwoModel, N), decoder(std::make_shared<DecoderType>(std::move(bsr))), ended(false)
 	{ }
 
-	explicit ArithmeticCodeReader(std::shared_ptr<ArithmeticDecoder> decoder) : decoder(std::move(decoder)) { }
+	explicit BasicArithmeticCodeReader(std::shared_ptr<DecoderType> decoder, bool powerOfTwoModel = false)
+		: LzwArithmeticCoding(powerOfTwoModel, N), decoder(std::move(decoder)), ended(false) { }
 
 	virtual bool readNextCode(code_type& code);
+	virtual size_t readCodes(code_type* codes, size_t count);
 
 	virtual code_type dictResetCode() const {
 		return CODE_DICT_RESET;
 	}
+
+	virtual void continueSegment(std::istream* stream) {
+		decoder->reader()->reset(stream);
+		decoder->reset();
+		ended = false;
+	}
 private:
-	std::shared_ptr<ArithmeticDecoder> decoder;
+	std::shared_ptr<DecoderType> decoder;
+	/// CODE_END was read, bits after it are padding and must not be decoded
+	bool ended;
+};
+
+typedef BasicArithmeticCodeReader<sizeof(uint32_t)> ArithmeticCodeReader;
+typedef BasicArithmeticCodeReader<sizeof(uint64_t)> ArithmeticCodeReader64;
+
+extern template class BasicArithmeticCodeReader<sizeof(uint32_t)>;
+extern template class BasicArithmeticCodeReader<sizeof(uint64_t)>;
+
+/**
+ * LZW codes reader for codes written by HuffmanCodeWriter.
+ */
+class HuffmanCodeReader : public LzwHuffmanCoding, public ICodeReader
+{
+public:
+	explicit HuffmanCodeReader(std::istream* stream) : reader(stream), ended(false) { }
+
+	virtual bool readNextCode(code_type& code) {
+		return readCodes(&code, 1) == 1;
+	}
+
+	virtual size_t readCodes(code_type* codes, size_t count);
+
+	virtual code_type dictResetCode() const {
+		return CODE_DICT_RESET;
+	}
+
+	virtual void continueSegment(std::istream* stream) {
+		// every segment has its own code lengths
+		reader.reset(stream);
+		decoder.reset();
+		ended = false;
+	}
+private:
+	BitStreamReader reader;
+	/// created when code lengths are read before first code
+	std::unique_ptr<HuffmanDecoder> decoder;
+	bool ended;
+};
+
+/**
+ * LZW codes reader for codes written by BitTreeCodeWriter.
+ */
+class BitTreeCodeReader : public LzwBitTreeCoding, public ICodeReader
+{
+public:
+	explicit BitTreeCodeReader(std::istream* stream) : decoder(stream), ended(false) { }
+
+	virtual bool readNextCode(code_type& code) {
+		return readCodes(&code, 1) == 1;
+	}
+
+	virtual size_t readCodes(code_type* codes, size_t count);
+
+	virtual code_type dictResetCode() const {
+		return CODE_DICT_RESET;
+	}
+
+	virtual void continueSegment(std::istream* stream) {
+		decoder.reset(stream);
+		ended = false;
+	}
+private:
+	BinaryRangeDecoder decoder;
+	bool ended;
 };
 
 /**
  * Decoder for LZW algorithm.
+ * Decoding runs in two stages, first batch of codes is read from code reader
+ * and then whole batch is expanded to strings written to output at once.
+ *
+ * Parallel decoding splits work differently. Dictionary building needs only prefix entry,
+ * first and last byte and length of every string, so it runs serially over window of codes
+ * and gives output offset of every code. Strings of window are then expanded to their
+ * offsets by tasks in thread pool.
  * @see http://marknelson.us/1989/10/01/lzw-data-compression/
  */
 class LzwDecoder
 {
 public:
-	explicit LzwDecoder(std::shared_ptr<ICodeReader> reader) : codeReader(std::move(reader)) {
-		initDictionary();
-	}
+	/// Number of codes read from code reader at once
+	static const size_t CODE_BATCH = 512;
+
+	/// Decoded data are written out when batch expands over this
+	static const size_t EXPANDED_FLUSH = 1 << 16;
+
+	/// Output of codes parsed before they are expanded in parallel, with dictionary it fits to cache
+	static const size_t PARALLEL_WINDOW = 1 << 21;
+	/// Output expanded by one task of parallel decoding
+	static const size_t PARALLEL_CHUNK = 1 << 16;
 
+	/**
+	 * @param reader reader of LZW codes
+	 * @param memoryLimit limit of dictionary memory, see LzwEncoder
+	 */
+	explicit LzwDecoder(std::shared_ptr<ICodeReader> reader, size_t memoryLimit = MemoryBudget::UNLIMITED);
+
+	/**
+	 * Decodes all codes to out.
+	 * When code reader continues by next segment, next call continues decoding.
+	 * @throws std::runtime_error on malformed stream or when dictionary would exceed memory limit
+	 */
 	void decode(std::ostream& out);
+
+	/**
+	 * Decodes all codes to out, strings are expanded by tasks in pool. Output is the same as by decode.
+	 * Dictionary is built from scratch, so codes can't continue segment decoded before.
+	 * @throws std::runtime_error on malformed stream or when dictionary would exceed memory limit
+	 */
+	void decode(std::ostream& out, ThreadPool& pool);
+
+	/**
+	 * Resets decoder to read codes from new reader, memory limit is kept.
+	 */
+	void reset(std::shared_ptr<ICodeReader> reader);
+
+	/// Current and peak memory of dictionary
+	const MemoryBudget& memory() const {
+		return budget;
+	}
 private:
 	void initDictionary();
+	void addEntry(ICodeReader::code_type code, std::string str);
 
-	void firstRun(size_t& code, std::string& codeStr, char& c);
+	/// Handles first code after start or dictionary reset
+	void firstCode(size_t code, char& c);
+
+	/// String of parallel decoding, it's string of prefix entry followed by last byte
+	struct PrefixEntry
+	{
+		uint32_t prefix;		/// unused by single byte entries
+		uint32_t length;
+		char first;
+		char last;
+	};
+
+	static const uint32_t NO_ENTRY = UINT32_MAX;
+
+	void initPrefixDictionary();
+	/// Adds entry of prefix string followed by byte, code is not assigned to it
+	uint32_t addPrefixEntry(uint32_t prefix, char last);
+	/// Expands parsed codes from first to last, output starts at dest
+	void expandCodes(size_t first, size_t last, char* dest) const;
+	/// Drops entries of dictionaries before last reset, returns new index of entry
+	uint32_t compactPrefixDictionary(uint32_t entry);
 
 	std::shared_ptr<ICodeReader> codeReader;
+	/// Strings of current batch
+	std::string expanded;
 	// LZW codes might be sparse so hash table will be more efficient than tree
 	std::unordered_map<ICodeReader::code_type, std::string> dictionary;
+	MemoryBudget budget;
+
+	// dictionary of parallel decoding, single byte entries are first and never removed
+	std::vector<PrefixEntry> entries;
+	std::vector<uint32_t> codeEntries;		/// entry of every code, NO_ENTRY for unused codes
+	uint32_t dictionaryStart;				/// first entry added after last dictionary reset
+	std::vector<uint32_t> parsed;			/// entries of codes in window
+
+	// state between segments of codes
+	bool firstPending;			/// next code is first after start or dictionary reset
+	size_t previousCode;
+	char previousChar;
 };
 
 #endif // !LZW_DECODER_H
@@ -0,0 +1,126 @@
+/**
+ * @file lzwdedup.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "lzwdedup.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/// Random values of bytes for gear hash, generated by splitmix64 so every build has the same
+struct GearTable
+{
+	GearTable() {
+		uint64_t state = 0x9E3779B97F4A7C15ULL;
+		for (auto& value : values) {
+			uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			value = z ^ (z >> 31);
+		}
+	}
+
+	uint64_t values[256];
+};
+
+const GearTable GEAR;
+
+/// Gear hash is shifted left every byte, so its top bits depend on the most bytes
+const uint64_t BOUNDARY_MASK = ((uint64_t(1) << ContentChunker::AVERAGE_BITS) - 1) << (64 - ContentChunker::AVERAGE_BITS);
+/// Gear hash depends only on last 64 bytes
+const size_t GEAR_WINDOW = 64;
+
+}
+
+const size_t ContentChunker::MIN_CHUNK;
+const unsigned ContentChunker::AVERAGE_BITS;
+const size_t ContentChunker::MAX_CHUNK;
+const size_t DedupHistory::CHUNK_OVERHEAD;
+
+size_t ContentChunker::next(const char* data, size_t size) {
+	size_t limit = std::min(size, MAX_CHUNK);
+	if (limit <= MIN_CHUNK)
+		return limit;
+
+	// boundary can't be before MIN_CHUNK, so hashing starts just to fill hash window there
+	auto bytes = reinterpret_cast<const unsigned char*>(data);
+	uint64_t hash = 0;
+	for (size_t i = MIN_CHUNK - GEAR_WINDOW; i < limit; ++i) {
+		hash = (hash << 1) + GEAR.values[bytes[i]];
+		if (i >= MIN_CHUNK && (hash & BOUNDARY_MASK) == 0)
+			return i + 1;
+	}
+	return limit;
+}
+
+uint64_t chunkHash(const char* data, size_t size) {
+	const uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+	uint64_t hash = size * MULTIPLIER;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ static_cast<unsigned char>(data[i])) * MULTIPLIER;
+	return hash ^ (hash >> 32);
+}
+
+uint64_t DedupHistory::add(const char* data, size_t size) {
+	chunks.emplace_back(data, size);
+	totalSize += size + CHUNK_OVERHEAD;
+	// newest chunk stays even when it alone exceeds capacity
+	while (totalSize > windowCapacity && chunks.size() > 1) {
+		totalSize -= chunks.front().size() + CHUNK_OVERHEAD;
+		chunks.pop_front();
+		firstId++;
+	}
+	return nextId() - 1;
+}
+
+void DedupHistory::clear() {
+	chunks.clear();
+	firstId = 0;
+	totalSize = 0;
+}
+
+bool DedupIndex::find(const char* data, size_t size, uint64_t& id) const {
+	auto it = ids.find(chunkHash(data, size));
+	if (it == ids.end())
+		return false;
+
+	auto chunk = history.find(it->second);
+	if (!chunk || chunk->size() != size || std::memcmp(chunk->data(), data, size) != 0)
+		return false;
+	id = it->second;
+	return true;
+}
+
+uint64_t DedupIndex::add(const char* data, size_t size) {
+	auto hash = chunkHash(data, size);
+	auto id = history.add(data, size);
+	ids[hash] = id;
+	hashes.push_back(hash);
+
+	// forget fingerprints of dropped chunks unless newer chunk has the same one
+	for (auto dropped = id + 1 - hashes.size(); dropped < history.oldestId(); ++dropped) {
+		auto it = ids.find(hashes.front());
+		if (it != ids.end() && it->second == dropped)
+			ids.erase(it);
+		hashes.pop_front();
+	}
+	return id;
+}
+
+void DedupIndex::clear() {
+	history.clear();
+	ids.clear();
+	hashes.clear();
+}
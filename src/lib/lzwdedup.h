@@ -0,0 +1,130 @@
+/**
+ * @file lzwdedup.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef LZW_DEDUP_H
+#define LZW_DEDUP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Content defined chunking by gear rolling hash.
+ * Chunk ends where hash of last bytes has top bits zero, so boundaries depend only on
+ * nearby content and repeated data is split to the same chunks wherever it occurs.
+ */
+class ContentChunker
+{
+public:
+	static const size_t MIN_CHUNK = 1 << 11;
+	/// Expected chunk size is MIN_CHUNK + 1 << AVERAGE_BITS
+	static const unsigned AVERAGE_BITS = 13;
+	static const size_t MAX_CHUNK = 1 << 16;
+
+	/**
+	 * Finds end of chunk starting at data.
+	 * @return chunk size, at most size
+	 */
+	static size_t next(const char* data, size_t size);
+};
+
+/// Fingerprint of chunk content, equal chunks are still compared byte by byte
+uint64_t chunkHash(const char* data, size_t size);
+
+/**
+ * Window of last chunks which can be referenced, both writer and reader keep it.
+ * Chunks are numbered in order they were added, oldest ones are dropped when
+ * their memory exceeds capacity. Every chunk counts with CHUNK_OVERHEAD, so
+ * capacity bounds memory of window even when chunks are small.
+ */
+class DedupHistory
+{
+public:
+	/// Estimated bytes of chunk besides its data, string, deque slot and entry of writer's index
+	static const size_t CHUNK_OVERHEAD = 128;
+
+	explicit DedupHistory(size_t capacity) : windowCapacity(capacity), firstId(0), totalSize(0) { }
+
+	/**
+	 * Adds chunk and drops oldest chunks over capacity.
+	 * @return id of added chunk
+	 */
+	uint64_t add(const char* data, size_t size);
+
+	/// Chunk with id, nullptr when it was dropped or doesn't exist yet
+	const std::string* find(uint64_t id) const {
+		return id >= firstId && id < nextId() ? &chunks[static_cast<size_t>(id - firstId)] : nullptr;
+	}
+
+	/// Id which gets next added chunk
+	uint64_t nextId() const {
+		return firstId + chunks.size();
+	}
+
+	/// Id of oldest chunk in window
+	uint64_t oldestId() const {
+		return firstId;
+	}
+
+	size_t capacity() const {
+		return windowCapacity;
+	}
+
+	/// Estimated memory of chunks in window
+	size_t size() const {
+		return totalSize;
+	}
+
+	/// Forgets all chunks, numbering starts again from zero
+	void clear();
+private:
+	size_t windowCapacity;
+	std::deque<std::string> chunks;
+	uint64_t firstId;
+	size_t totalSize;			/// memory of chunks, see CHUNK_OVERHEAD
+};
+
+/**
+ * Writer side of deduplication, history with index of chunk fingerprints.
+ */
+class DedupIndex
+{
+public:
+	explicit DedupIndex(size_t capacity) : history(capacity) { }
+
+	/**
+	 * Looks chunk up in window.
+	 * @retval id id of equal chunk
+	 * @return false when window has no equal chunk
+	 */
+	bool find(const char* data, size_t size, uint64_t& id) const;
+
+	/// Adds chunk to window, see DedupHistory::add
+	uint64_t add(const char* data, size_t size);
+
+	uint64_t nextId() const {
+		return history.nextId();
+	}
+
+	size_t capacity() const {
+		return history.capacity();
+	}
+
+	size_t size() const {
+		return history.size();
+	}
+
+	void clear();
+private:
+	DedupHistory history;
+	std::unordered_map<uint64_t, uint64_t> ids;		/// fingerprint to id of last chunk with it
+	std::deque<uint64_t> hashes;					/// fingerprints of chunks in history
+};
+
+#endif // !LZW_DEDUP_H
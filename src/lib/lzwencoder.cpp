@@ -11,22 +11,31 @@
 #include <ios>
 #include <stdexcept>
 
+const size_t VariableCodeWriter::PACK_GROUP;
+
 void VariableCodeWriter::flush() {
+	writePending();
 	writer.flush();
 }
 
 void VariableCodeWriter::writeCode(code_type code) {
 	code_type codeLen = codeBitLength(code);
-	if (codeLen > curBitLen) {
-		if (codeLen == curBitLen + 1) {
-			// write mark that we are changing code len
-			writer.writeBits(CODE_MARK, curBitLen);
-			curBitLen = codeLen;
-		} else
-			throw std::runtime_error("VariableCodeWriter::writeCode: code bitlen is larger than current bit len by more than 1");
+	// write mark for every bit code len grows, pending codes have old length
+	// (incompressible data writes only short codes while dictionary grows, so it can be several bits)
+	while (codeLen > curBitLen) {
+		pending[pendingCount++] = CODE_MARK;
+		writePending();
+		curBitLen++;
 	}
 
-	writer.writeBits(code, curBitLen);
+	pending[pendingCount++] = static_cast<uint32_t>(code);
+	if (pendingCount == PACK_GROUP)
+		writePending();
+}
+
+void VariableCodeWriter::writePending() {
+	writer.packCodes(static_cast<unsigned>(curBitLen), pending, pendingCount);
+	pendingCount = 0;
 }
 
 void VariableCodeWriter::writeDictReset() {
@@ -40,16 +49,63 @@ VariableCodeWriter::code_type VariableCodeWriter::codeBitLength(code_type code)
 	return res + 1;
 }
 
-void ArithmeticCodeWriter::writeCode(code_type code) {
-	encoder->encode(code, &dataModel);
+template <size_t N>
+void BasicArithmeticCodeWriter<N>::writeCode(code_type code) {
+	encoder->encode(code, dataModel.get());
 }
 
-void ArithmeticCodeWriter::writeDictReset() {
+template <size_t N>
+void BasicArithmeticCodeWriter<N>::writeDictReset() {
 	writeCode(CODE_DICT_RESET);
-	dataModel.reset();
+	dataModel->reset();
+}
+
+template class BasicArithmeticCodeWriter<sizeof(uint32_t)>;
+template class BasicArithmeticCodeWriter<sizeof(uint64_t)>;
+
+void HuffmanCodeWriter::flush() {
+	if (codes.empty())
+		return;
+	codes.push_back(CODE_END);
+
+	// codes are turned to symbols in first pass, they depend on order of codes
+	size_t distance, extraBits;
+	std::vector<uint32_t> freqs(NUM_SYMBOLS);
+	std::vector<uint32_t> symbols(codes.size()), extras(codes.size());
+	for (size_t i = 0; i < codes.size(); ++i) {
+		symbols[i] = static_cast<uint32_t>(symbolOf(codes[i], distance, extraBits));
+		extras[i] = static_cast<uint32_t>(distance & ((size_t(1) << extraBits) - 1));
+		freqs[symbols[i]]++;
+		// reader doesn't count end code, segment after sync flush has to agree
+		if (codes[i] != CODE_END)
+			dictSize.count(codes[i]);
+	}
+	HuffmanCode huffman(HuffmanCode::buildLengths(freqs));
+
+	huffman.writeLengths(writer);
+	for (size_t i = 0; i < codes.size(); ++i) {
+		huffman.write(writer, symbols[i]);
+		writer.writeBits(extras[i], extraBitsOf(symbols[i]));
+	}
+	writer.flush();
+	codes.clear();
+}
+
+void BitTreeCodeWriter::writeCode(code_type code) {
+	unsigned width = codeWidth();
+	unsigned lowBits = width - TREE_BITS;
+	encoder.encodeTree(treeModel(width), TREE_BITS, static_cast<uint32_t>(code >> lowBits));
+	for (unsigned i = lowBits; i-- > 0; )
+		encoder.encode(lowModel(width, i), ((code >> i) & 1) != 0);
+	if (code != CODE_END)
+		dictSize.count(code);
 }
 
-LzwEncoder::LzwEncoder(std::shared_ptr<ICodeWriter> codeWriter) : codeWriter(std::move(codeWriter)), encodedIt(dictionary.end()) {
+LzwEncoder::LzwEncoder(std::shared_ptr<ICodeWriter> codeWriter, size_t memoryLimit)
+	: codeWriter(std::move(codeWriter)), encodedIt(dictionary.end()), synced(false), budget(memoryLimit),
+	codeLimit(SIZE_MAX) {
+	if (memoryLimit < MemoryBudget::MIN_LZW_LIMIT)
+		throw std::runtime_error("LzwEncoder: memory limit too small");
 	initDictionary();
 }
 
@@ -61,6 +117,17 @@ void LzwEncoder::flush() {
 	codeWriter->flush();
 }
 
+void LzwEncoder::syncFlush() {
+	if (encodedIt != dictionary.end()) {
+		codeWriter->writeCode(encodedIt->second);
+		syncedStr = encodedIt->first;
+		synced = true;
+	}
+	encodedIt = dictionary.end();
+
+	codeWriter->syncFlush();
+}
+
 void LzwEncoder::reset(std::shared_ptr<ICodeWriter> codeWriter) {
 	flush();
 	this->codeWriter = std::move(codeWriter);
@@ -74,6 +141,21 @@ void LzwEncoder::encode(int byte) {
 		return;
 	}
 
+	if (synced) {
+		// decoder adds entry of previous code and first byte of next one, same as
+		// when string ends because concatenated isn't in dictionary
+		synced = false;
+		auto concatenated = syncedStr + std::string(1, byte);
+		ICodeWriter::code_type code;
+		if (!budget.fits(MemoryBudget::dictionaryEntry(concatenated.size())))
+			eraseDictionary();
+		else if (nextCode(code)) {
+			// string can be in dictionary already, decoder gets duplicate entry for its code
+			budget.allocate(MemoryBudget::dictionaryEntry(concatenated.size()));
+			dictionary.insert(std::make_pair(concatenated, code));
+		}
+	}
+
 	auto concatenated = (encodedIt == dictionary.end() ? "" : encodedIt->first) + std::string(1, byte);
 	auto concatenatedIt = dictionary.find(concatenated);
 	// concatenated in dictionary
@@ -82,8 +164,13 @@ void LzwEncoder::encode(int byte) {
 	// concatenated isn't in dictionary
 	} else {
 		codeWriter->writeCode(encodedIt->second);
-		if (codeWriter->generator()->haveNext())
-			dictionary[concatenated] = codeWriter->generator()->next();
+		encodedIt = dictionary.end();
+		ICodeWriter::code_type code;
+		if (!budget.fits(MemoryBudget::dictionaryEntry(concatenated.size()))) {
+			// dictionary would exceed memory limit, so it starts again
+			eraseDictionary();
+		} else if (nextCode(code))
+			addEntry(concatenated, code);
 
 		encodedIt = dictionary.find(std::string(1, byte));
 	}
@@ -91,11 +178,37 @@ void LzwEncoder::encode(int byte) {
 
 void LzwEncoder::initDictionary() {
 	// init dictionary with entry for each byte
-	dictionary.clear();
-	for (int b = 0; b <= std::numeric_limits<uint8_t>::max(); b++) {
-		auto key = std::string(1, b);
-		dictionary[key] = codeWriter->generator()->next();
+	// single byte entries are kept and only get their codes again, so reset of reused
+	// encoder doesn't reallocate them
+	for (auto it = dictionary.begin(); it != dictionary.end(); ) {
+		if (it->first.size() > 1)
+			it = dictionary.erase(it);
+		else
+			++it;
 	}
+	budget.releaseAll();
+	synced = false;
+	for (int b = 0; b <= std::numeric_limits<uint8_t>::max(); b++)
+		addEntry(std::string(1, b), codeWriter->generator()->next());
+}
+
+void LzwEncoder::addEntry(const std::string& str, ICodeWriter::code_type code) {
+	dictionary[str] = code;
+	budget.allocate(MemoryBudget::dictionaryEntry(str.size()));
+}
+
+bool LzwEncoder::nextCode(ICodeWriter::code_type& code) {
+	auto generator = codeWriter->generator();
+	if (generator->haveNext()) {
+		code = generator->next();
+		if (code < codeLimit)
+			return true;
+	} else if (codeLimit == SIZE_MAX)
+		return false;
+
+	// decoder reads reset instead of adding entry, same as with memory limit
+	eraseDictionary();
+	return false;
 }
 
 void LzwEncoder::eraseDictionary() {
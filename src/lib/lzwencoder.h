@@ -11,11 +11,13 @@
 #include "lzwcommon.h"
 #include "bitstream.h"
 #include "arithmencoder.h"
+#include "huffman.h"
 
 #include <cstdint>
 #include <memory>
 #include <map>
 #include <string>
+#include <vector>
 #include <stdexcept>
 
 #ifdef _MSC_VER
@@ -37,6 +39,16 @@ public:
 	 */
 	virtual void flush() = 0;
 
+	/**
+	 * Ends segment of codes, so all codes written so far can be decoded before
+	 * anything else is written. Unlike flush, coding state is kept and writing
+	 * continues by next segment, which reader reads after ICodeReader::continueSegment.
+	 * Segments of writers without end code are just flushed.
+	 */
+	virtual void syncFlush() {
+		flush();
+	}
+
 	/**
 	 * Write code to some output stream.
 	 * How and where this method writes is implementation defined
@@ -87,8 +99,11 @@ private:
 class VariableCodeWriter : public LzwVariableCoding, public ICodeWriter
 {
 public:
-	explicit VariableCodeWriter(std::ostream* stream) : writer(stream) { }
-	explicit VariableCodeWriter(const BitStreamWriter& writer) : writer(writer) { }
+	/// Number of codes packed at once, runs of codes with same length are packed by SIMD
+	static const size_t PACK_GROUP = 16;
+
+	explicit VariableCodeWriter(std::ostream* stream) : writer(stream), pendingCount(0) { }
+	explicit VariableCodeWriter(const BitStreamWriter& writer) : writer(writer), pendingCount(0) { }
 
 	~VariableCodeWriter() {
 		flush();
@@ -102,23 +117,36 @@ public:
 private:
 	static code_type codeBitLength(code_type code);
 
+	/// Packs pending codes with current code length
+	void writePending();
+
 	BitStreamWriter writer;
+	uint32_t pending[PACK_GROUP];		/// codes waiting for packing, all have current length
+	size_t pendingCount;
 };
 
-class ArithmeticCodeWriter : public LzwArithmeticCoding, public ICodeWriter
+/**
+ * LZW codes writer using adaptive arithmetic coding with interval of N bytes.
+ */
+template <size_t N>
+class BasicArithmeticCodeWriter : public LzwArithmeticCoding, public ICodeWriter
 {
 public:
-	explicit ArithmeticCodeWriter(std::ostream* stream) : 
-		encoder(std::make_shared<ArithmeticEncoder>(std::make_shared<BitStreamWriter>(stream))) 
+	typedef BasicArithmeticEncoder<N> EncoderType;
+
+	explicit BasicArithmeticCodeWriter(std::ostream* stream, bool powerOfTwoModel = false) : 
+		LzwArithmeticCoding(powerOfTwoModel, N),
+		encoder(std::make_shared<EncoderType>(std::make_shared<BitStreamWriter>(stream))) 
 	{ }
 
-	explicit ArithmeticCodeWriter(std::shared_ptr<BitStreamWriter> bsw) : 
-		encoder(std::make_shared<ArithmeticEncoder>(std::move(bsw))) 
+	explicit BasicArithmeticCodeWriter(std::shared_ptr<BitStreamWriter> bsw, bool powerOfTwoModel = false) : 
+		LzwArithmeticCoding(powerOfTwoModel, N), encoder(std::make_shared<EncoderType>(std::move(bsw))) 
 	{ }
 
-	explicit ArithmeticCodeWriter(std::shared_ptr<ArithmeticEncoder> encoder) : encoder(std::move(encoder)) { }
+	explicit BasicArithmeticCodeWriter(std::shared_ptr<EncoderType> encoder, bool powerOfTwoModel = false)
+		: LzwArithmeticCoding(powerOfTwoModel, N), encoder(std::move(encoder)) { }
 
-	~ArithmeticCodeWriter() {
+	~BasicArithmeticCodeWriter() {
 		flush();
 	}
 
@@ -127,11 +155,91 @@ public:
 		encoder->close();
 	}
 
+	virtual void syncFlush() {
+		// interval starts again, data model is kept
+		writeCode(CODE_END);
+		encoder->reset();
+	}
+
 	virtual void writeCode(code_type code);
 
 	virtual void writeDictReset();
 private:
-	std::shared_ptr<ArithmeticEncoder> encoder;
+	std::shared_ptr<EncoderType> encoder;
+};
+
+typedef BasicArithmeticCodeWriter<sizeof(uint32_t)> ArithmeticCodeWriter;
+typedef BasicArithmeticCodeWriter<sizeof(uint64_t)> ArithmeticCodeWriter64;
+
+extern template class BasicArithmeticCodeWriter<sizeof(uint32_t)>;
+extern template class BasicArithmeticCodeWriter<sizeof(uint64_t)>;
+
+/**
+ * LZW codes writer using canonical Huffman code.
+ * Codes are collected until flush, then Huffman code is built from their
+ * frequencies and code lengths are written followed by coded codes.
+ */
+class HuffmanCodeWriter : public LzwHuffmanCoding, public ICodeWriter
+{
+public:
+	explicit HuffmanCodeWriter(std::ostream* stream) : writer(stream) { }
+
+	~HuffmanCodeWriter() {
+		flush();
+	}
+
+	virtual void flush();
+
+	virtual void writeCode(code_type code) {
+		codes.push_back(static_cast<uint32_t>(code));
+	}
+
+	virtual void writeDictReset() {
+		writeCode(CODE_DICT_RESET);
+	}
+private:
+	BitStreamWriter writer;
+	std::vector<uint32_t> codes;
+};
+
+/**
+ * LZW codes writer using binary range coder with bit tree models.
+ */
+class BitTreeCodeWriter : public LzwBitTreeCoding, public ICodeWriter
+{
+public:
+	explicit BitTreeCodeWriter(std::ostream* stream) : encoder(stream), closed(false) { }
+
+	/// Write errors are dropped like by BinaryRangeEncoder
+	~BitTreeCodeWriter() {
+		try {
+			flush();
+		} catch (std::exception&) {
+		}
+	}
+
+	virtual void flush() {
+		if (closed)
+			return;
+		closed = true;
+		writeCode(CODE_END);
+		encoder.close();
+	}
+
+	virtual void syncFlush() {
+		// range coding starts again, bit models are kept
+		writeCode(CODE_END);
+		encoder.reset();
+	}
+
+	virtual void writeCode(code_type code);
+
+	virtual void writeDictReset() {
+		writeCode(CODE_DICT_RESET);
+	}
+private:
+	BinaryRangeEncoder encoder;
+	bool closed;
 };
 
 /**
@@ -143,7 +251,12 @@ private:
 class LzwEncoder
 {
 public:
-	explicit LzwEncoder(std::shared_ptr<ICodeWriter> codeWriter);
+	/**
+	 * @param codeWriter writer of LZW codes
+	 * @param memoryLimit limit of dictionary memory, when next entry doesn't fit
+	 *        dictionary is reset, decoder with the same limit can decode the stream
+	 */
+	explicit LzwEncoder(std::shared_ptr<ICodeWriter> codeWriter, size_t memoryLimit = MemoryBudget::UNLIMITED);
 
 	~LzwEncoder() {
 		flush();
@@ -154,6 +267,13 @@ public:
 	 */
 	void flush();
 
+	/**
+	 * Writes code of encoded string and ends segment of codes, so decoder can output
+	 * all bytes encoded so far. Dictionary and coding state are kept and encoding
+	 * continues, decoder reads next segment after ICodeReader::continueSegment.
+	 */
+	void syncFlush();
+
 	/**
 	 * Resets encoder to write to new output stream
 	 * @param bsw writer to new output stream
@@ -170,14 +290,42 @@ public:
 	 * Erases dictionary used while encoding.
 	 */
 	void eraseDictionary();
+
+	/**
+	 * Sets width of codes after which dictionary is reset, decoder needs no setting
+	 * because reset is written to stream.
+	 * @param width dictionary is reset when next code wouldn't fit to width bits or when
+	 *        writer has no more codes, 0 keeps full dictionary without reset (default)
+	 */
+	void setResetWidth(unsigned width) {
+		codeLimit = width == 0 ? SIZE_MAX : static_cast<ICodeWriter::code_type>(1) << width;
+	}
+
+	/// Current and peak memory of dictionary
+	const MemoryBudget& memory() const {
+		return budget;
+	}
 private:
 	void initDictionary();
+	void addEntry(const std::string& str, ICodeWriter::code_type code);
+
+	/**
+	 * Gets code of next entry, full dictionary is erased instead when reset width is set.
+	 * @return false when no entry is added
+	 */
+	bool nextCode(ICodeWriter::code_type& code);
 
 	std::shared_ptr<ICodeWriter> codeWriter;
 
 	typedef std::map<std::string, ICodeWriter::code_type> dictionary_type;
 	dictionary_type dictionary;
 	dictionary_type::iterator encodedIt;
+	/// string written by sync flush, its entry is added with first byte of next string
+	std::string syncedStr;
+	bool synced;
+	MemoryBudget budget;
+	/// Codes from this one are not used, dictionary is reset instead, SIZE_MAX for no reset
+	ICodeWriter::code_type codeLimit;
 
 	//std::string encodedStr;
 };
@@ -0,0 +1,168 @@
+/**
+ * @file lzwestimate.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "lzwestimate.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+// plain adaptive arithmetic coding isn't tried, power of two model codes to about
+// the same size many times faster
+const LzwMethod LZW_AUTO_METHODS[4] = {
+	LZW_METHOD_VARIABLE, LZW_METHOD_HUFFMAN, LZW_METHOD_BITTREE, LZW_METHOD_ARITHMETIC_POW2
+};
+
+CountingStreamBuf::int_type CountingStreamBuf::overflow(int_type c) {
+	counted += static_cast<uint64_t>(pptr() - pbase());
+	setp(buffer, buffer + sizeof(buffer));
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+		counted++;
+	return traits_type::not_eof(c);
+}
+
+std::streamsize CountingStreamBuf::xsputn(const char*, std::streamsize n) {
+	counted += static_cast<uint64_t>(n);
+	return n;
+}
+
+namespace {
+
+uint64_t codedSize(LzwMethod method, const char* data, size_t size, size_t memoryLimit) {
+	CountingStreamBuf counter;
+	std::ostream out(&counter);
+	{
+		LzwEncoder encoder(createCodeWriter(method, &out), memoryLimit);
+		for (size_t i = 0; i < size; ++i)
+			encoder.encode(static_cast<unsigned char>(data[i]));
+		encoder.flush();
+	}
+	// block writer stores data which would expand
+	return std::min<uint64_t>(counter.count(), size);
+}
+
+/// Codes every window of windows laid back to back in samples independently
+std::vector<LzwEstimate> estimateWindows(const std::string& samples, size_t windowSize, size_t memoryLimit) {
+	std::vector<LzwEstimate> estimates;
+	for (auto method : LZW_AUTO_METHODS) {
+		LzwEstimate estimate = { method, 0, 0 };
+		for (size_t position = 0; position < samples.size(); position += windowSize) {
+			auto size = std::min(windowSize, samples.size() - position);
+			estimate.sampleSize += size;
+			estimate.codedSize += codedSize(method, samples.data() + position, size, memoryLimit);
+		}
+		estimates.push_back(estimate);
+	}
+	return estimates;
+}
+
+/// Reads up to size bytes to end of str, returns number of bytes read
+size_t readAppend(std::istream& in, std::string& str, size_t size) {
+	auto old = str.size();
+	str.resize(old + size);
+	in.read(&str[old], static_cast<std::streamsize>(size));
+	auto n = static_cast<size_t>(in.gcount());
+	str.resize(old + n);
+	if (in.bad())
+		throw std::runtime_error("estimateLzwMethods: unable to read input");
+	return n;
+}
+
+}
+
+std::vector<LzwEstimate> estimateLzwMethods(const char* data, size_t size, size_t memoryLimit,
+	size_t windows, size_t windowSize) {
+	// windows start at multiples of stride, so they cover beginning, middle parts and end of data
+	bool whole = windows == 0 || size <= windows * windowSize;
+	size_t stride = whole || windows == 1 ? 0 : (size - windowSize) / (windows - 1);
+
+	std::vector<LzwEstimate> estimates;
+	for (auto method : LZW_AUTO_METHODS) {
+		LzwEstimate estimate = { method, 0, 0 };
+		if (whole) {
+			estimate.sampleSize = size;
+			estimate.codedSize = codedSize(method, data, size, memoryLimit);
+		} else {
+			for (size_t i = 0; i < windows; ++i) {
+				estimate.sampleSize += windowSize;
+				estimate.codedSize += codedSize(method, data + i * stride, windowSize, memoryLimit);
+			}
+		}
+		estimates.push_back(estimate);
+	}
+	return estimates;
+}
+
+std::vector<LzwEstimate> estimateLzwMethods(std::istream& in, uint64_t& size, size_t memoryLimit,
+	size_t windows, size_t windowSize) {
+	std::string samples;
+	auto begin = in.tellg();
+	if (windows > 0 && begin != std::istream::pos_type(-1) && in.seekg(0, std::ios_base::end)) {
+		size = static_cast<uint64_t>(in.tellg() - begin);
+		in.seekg(begin);
+		if (size <= windows * windowSize) {
+			readAppend(in, samples, static_cast<size_t>(size));
+			return estimateLzwMethods(samples.data(), samples.size(), memoryLimit, windows, windowSize);
+		}
+
+		// the same windows as of data in memory
+		uint64_t stride = windows == 1 ? 0 : (size - windowSize) / (windows - 1);
+		for (size_t i = 0; i < windows; ++i) {
+			in.seekg(begin + static_cast<std::streamoff>(i * stride));
+			if (readAppend(in, samples, windowSize) != windowSize)
+				throw std::runtime_error("estimateLzwMethods: input is shorter than its size");
+		}
+		return estimateWindows(samples, windowSize, memoryLimit);
+	}
+
+	// not seekable, size is known at the end only
+	in.clear();
+	size = 0;
+	if (windows == 0) {
+		while (readAppend(in, samples, windowSize) > 0) { }
+		size = samples.size();
+		return estimateLzwMethods(samples.data(), samples.size(), memoryLimit, windows, windowSize);
+	}
+
+	std::string window;
+	uint64_t stride = windowSize;
+	for (size_t n; (n = readAppend(in, window, windowSize)) > 0; window.clear()) {
+		if (size % stride == 0) {
+			samples += window;
+			if (samples.size() >= 2 * windows * windowSize) {
+				// windows at even multiples of stride stay
+				for (size_t i = 1; 2 * i < 2 * windows; ++i)
+					samples.replace(i * windowSize, windowSize, samples, 2 * i * windowSize, windowSize);
+				samples.resize(windows * windowSize);
+				stride *= 2;
+			}
+		}
+		size += n;
+	}
+
+	// all windows were kept when input is smaller than them
+	if (size <= windows * windowSize)
+		return estimateLzwMethods(samples.data(), samples.size(), memoryLimit, windows, windowSize);
+	return estimateWindows(samples, windowSize, memoryLimit);
+}
+
+LzwMethod selectLzwMethod(const std::vector<LzwEstimate>& estimates, double tolerance) {
+	if (estimates.empty())
+		return LZW_METHOD_VARIABLE;
+
+	auto best = estimates[0].codedSize;
+	for (auto& estimate : estimates)
+		best = std::min(best, estimate.codedSize);
+
+	// estimates are ordered from fastest method
+	for (auto& estimate : estimates) {
+		if (estimate.codedSize <= best * (1.0 + tolerance))
+			return estimate.method;
+	}
+	return estimates[0].method;
+}
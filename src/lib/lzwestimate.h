@@ -0,0 +1,92 @@
+/**
+ * @file lzwestimate.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef LZW_ESTIMATE_H
+#define LZW_ESTIMATE_H
+
+#include "lzwblock.h"
+
+#include <cstdint>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+/**
+ * Output stream buffer which only counts bytes written to it.
+ */
+class CountingStreamBuf : public std::streambuf
+{
+public:
+	CountingStreamBuf() : counted(0) {
+		setp(buffer, buffer + sizeof(buffer));
+	}
+
+	/// Number of bytes written so far
+	uint64_t count() const {
+		return counted + static_cast<uint64_t>(pptr() - pbase());
+	}
+protected:
+	virtual int_type overflow(int_type c);
+	virtual std::streamsize xsputn(const char* s, std::streamsize n);
+private:
+	uint64_t counted;
+	char buffer[1 << 12];
+};
+
+/**
+ * Estimated coded size of input sample for one method.
+ */
+struct LzwEstimate
+{
+	LzwMethod method;
+	uint64_t sampleSize;
+	uint64_t codedSize;
+
+	/// Coded size relative to sample size
+	double ratio() const {
+		return sampleSize > 0 ? static_cast<double>(codedSize) / sampleSize : 1.0;
+	}
+};
+
+/// Methods tried by automatic selection, from fastest to slowest
+extern const LzwMethod LZW_AUTO_METHODS[4];
+
+/// Default number of sampled windows
+const size_t LZW_ESTIMATE_WINDOWS = 4;
+/// Default size of one sampled window
+const size_t LZW_ESTIMATE_WINDOW_SIZE = 1 << 16;
+
+/**
+ * Estimates coded size of every method in LZW_AUTO_METHODS.
+ * Windows are spread evenly over data and each one is coded independently to null sink.
+ * Data smaller than all windows together are coded whole.
+ * @param memoryLimit dictionary memory limit of encoder, see LzwEncoder
+ * @return estimates in order of LZW_AUTO_METHODS
+ */
+std::vector<LzwEstimate> estimateLzwMethods(const char* data, size_t size,
+	size_t memoryLimit = MemoryBudget::UNLIMITED, size_t windows = LZW_ESTIMATE_WINDOWS,
+	size_t windowSize = LZW_ESTIMATE_WINDOW_SIZE);
+
+/**
+ * Estimates coded size of every method in LZW_AUTO_METHODS from samples of input stream,
+ * only windows are kept in memory. Windows of seekable stream are read at their positions.
+ * Other stream is read whole, every window at multiple of stride is kept and every other
+ * one is dropped when stride doubles, so there are from windows to 2 * windows of them.
+ * @param size set to size of input
+ * @throws std::runtime_error when stream can't be read
+ */
+std::vector<LzwEstimate> estimateLzwMethods(std::istream& in, uint64_t& size,
+	size_t memoryLimit = MemoryBudget::UNLIMITED, size_t windows = LZW_ESTIMATE_WINDOWS,
+	size_t windowSize = LZW_ESTIMATE_WINDOW_SIZE);
+
+/**
+ * Selects fastest method whose estimated size is within tolerance of the smallest one.
+ * @param tolerance allowed relative size increase, i.e. 0.05 for 5 %
+ */
+LzwMethod selectLzwMethod(const std::vector<LzwEstimate>& estimates, double tolerance);
+
+#endif // !LZW_ESTIMATE_H
@@ -0,0 +1,81 @@
+/**
+ * @file memstream.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef MEM_STREAM_H
+#define MEM_STREAM_H
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+
+/**
+ * Input stream buffer reading from memory owned by caller, nothing is copied.
+ */
+class MemoryInputBuf : public std::streambuf
+{
+public:
+	MemoryInputBuf() { }
+
+	MemoryInputBuf(const char* data, std::size_t size) {
+		reset(data, size);
+	}
+
+	/// Starts reading from another memory
+	void reset(const char* data, std::size_t size) {
+		// streambuf doesn't modify input area, it's only declared as non-const
+		auto begin = const_cast<char*>(data);
+		setg(begin, begin, begin + size);
+	}
+};
+
+/**
+ * Output stream buffer writing to memory owned by caller.
+ * Writing past end fails, so stream goes to bad state.
+ */
+class MemoryOutputBuf : public std::streambuf
+{
+public:
+	MemoryOutputBuf() { }
+
+	MemoryOutputBuf(char* data, std::size_t size) {
+		reset(data, size);
+	}
+
+	/// Starts writing to another memory
+	void reset(char* data, std::size_t size) {
+		setp(data, data + size);
+	}
+
+	/// Number of bytes written
+	std::size_t written() const {
+		return static_cast<std::size_t>(pptr() - pbase());
+	}
+};
+
+/**
+ * Output stream buffer appending to string, capacity of string is reused.
+ */
+class StringOutputBuf : public std::streambuf
+{
+public:
+	explicit StringOutputBuf(std::string& str) : str(str) { }
+protected:
+	virtual int_type overflow(int_type c) {
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+			str.push_back(traits_type::to_char_type(c));
+		return traits_type::not_eof(c);
+	}
+
+	virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+		str.append(s, static_cast<std::size_t>(n));
+		return n;
+	}
+private:
+	std::string& str;
+};
+
+#endif // !MEM_STREAM_H
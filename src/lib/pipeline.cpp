@@ -0,0 +1,245 @@
+/**
+ * @file pipeline.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "pipeline.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+
+// waits are in predicate loops like in ThreadPool, timeout only bounds a missed notification
+const std::chrono::milliseconds WAIT_TIMEOUT(100);
+
+}
+
+const unsigned BufferChannel::SPIN_COUNT;
+
+BufferChannel::BufferChannel(std::size_t bufferSize, std::size_t numBuffers)
+	: filled(numBuffers + 1), recycled(numBuffers), aborted(false), finished(false), sleepers(0) {
+	// all buffers start as recycled so producer can take them
+	for (std::size_t i = 0; i < numBuffers; ++i) {
+		storage.push_back(std::unique_ptr<PipeBuffer>(new PipeBuffer(bufferSize)));
+		recycled.tryPush(storage.back().get());
+	}
+}
+
+PipeBuffer* BufferChannel::pop(SpscRing<PipeBuffer*>& ring) {
+	PipeBuffer* buffer;
+	// buffer usually comes soon when both sides are busy
+	for (unsigned spins = 0; spins < SPIN_COUNT; ++spins) {
+		if (ring.tryPop(buffer))
+			return buffer;
+		if (aborted.load(std::memory_order_acquire))
+			return nullptr;
+	}
+
+	// other side is most likely waiting for I/O, so sleep until it pushes
+	std::unique_lock<std::mutex> lock(mutex);
+	sleepers.fetch_add(1);
+	for (;;) {
+		// pairs with fence in push, either push sees sleeper or ring is seen with pushed buffer
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ring.tryPop(buffer))
+			break;
+		if (aborted.load(std::memory_order_acquire)) {
+			buffer = nullptr;
+			break;
+		}
+		pushed.wait_for(lock, WAIT_TIMEOUT);
+	}
+	sleepers.fetch_sub(1);
+	return buffer;
+}
+
+void BufferChannel::push(SpscRing<PipeBuffer*>& ring, PipeBuffer* buffer) {
+	// ring has room for every buffer so this spins only briefly
+	while (!ring.tryPush(buffer)) {
+		if (aborted.load(std::memory_order_acquire))
+			return;
+		std::this_thread::yield();
+	}
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleepers.load(std::memory_order_relaxed) != 0)
+		wake();
+}
+
+void BufferChannel::wake() {
+	// sleeper checks ring under mutex, so notify can't come between its check and wait
+	std::lock_guard<std::mutex> lock(mutex);
+	pushed.notify_all();
+}
+
+void BufferChannel::abort() {
+	aborted.store(true, std::memory_order_release);
+	wake();
+}
+
+PipeBuffer* BufferChannel::acquire() {
+	auto buffer = pop(recycled);
+	if (buffer != nullptr)
+		buffer->size = 0;
+	return buffer;
+}
+
+void BufferChannel::submit(PipeBuffer* buffer) {
+	push(filled, buffer);
+}
+
+void BufferChannel::finish() {
+	if (!finished)
+		push(filled, nullptr);
+	finished = true;
+}
+
+PipeBuffer* BufferChannel::receive() {
+	return pop(filled);
+}
+
+void BufferChannel::release(PipeBuffer* buffer) {
+	push(recycled, buffer);
+}
+
+ChannelInputBuf::int_type ChannelInputBuf::underflow() {
+	if (gptr() < egptr())
+		return traits_type::to_int_type(*gptr());
+
+	if (current != nullptr)
+		channel->release(current);
+
+	current = channel->receive();
+	if (current == nullptr) {
+		setg(nullptr, nullptr, nullptr);
+		return traits_type::eof();
+	}
+
+	char* begin = current->data.data();
+	setg(begin, begin, begin + current->size);
+	return current->size > 0 ? traits_type::to_int_type(*begin) : underflow();
+}
+
+void ChannelOutputBuf::submitCurrent() {
+	if (current == nullptr)
+		return;
+
+	current->size = pptr() - pbase();
+	channel->submit(current);
+	current = nullptr;
+	setp(nullptr, nullptr);
+}
+
+ChannelOutputBuf::int_type ChannelOutputBuf::overflow(int_type c) {
+	submitCurrent();
+
+	current = channel->acquire();
+	if (current == nullptr)
+		return traits_type::eof();
+
+	char* begin = current->data.data();
+	setp(begin, begin + current->data.size());
+
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+		return sputc(traits_type::to_char_type(c));
+	return traits_type::not_eof(c);
+}
+
+int ChannelOutputBuf::sync() {
+	// partial buffers are submitted only on explicit flush
+	if (current != nullptr && pptr() > pbase())
+		submitCurrent();
+	return 0;
+}
+
+void ChannelOutputBuf::close() {
+	if (current != nullptr && pptr() > pbase())
+		submitCurrent();
+	channel->finish();
+}
+
+IoPipeline::IoPipeline(std::istream& in, std::ostream& out, std::size_t bufferSize, std::size_t numBuffers)
+	: inChannel(bufferSize, numBuffers), outChannel(bufferSize, numBuffers),
+	inBuf(&inChannel), outBuf(&outChannel), inputStream(&inBuf), outputStream(&outBuf) {
+	reader = std::thread(&IoPipeline::readLoop, this, std::ref(in));
+	writer = std::thread(&IoPipeline::writeLoop, this, std::ref(out));
+}
+
+IoPipeline::~IoPipeline() {
+	inChannel.abort();
+	outChannel.abort();
+	join();
+}
+
+void IoPipeline::readLoop(std::istream& in) {
+	try {
+		for (;;) {
+			auto buffer = inChannel.acquire();
+			if (buffer == nullptr)
+				break;
+
+			in.read(buffer->data.data(), buffer->data.size());
+			// failed read isn't end of input, output would be silently truncated
+			if (in.bad())
+				throw std::runtime_error("IoPipeline: unable to read input stream");
+			buffer->size = static_cast<std::size_t>(in.gcount());
+			if (buffer->size == 0)
+				break;
+
+			inChannel.submit(buffer);
+			if (!in)
+				break;
+		}
+	} catch (...) {
+		readerError = std::current_exception();
+	}
+	inChannel.finish();
+}
+
+void IoPipeline::writeLoop(std::ostream& out) {
+	bool failed = false;
+	try {
+		while (auto buffer = outChannel.receive()) {
+			// after failure keep draining so codec thread doesn't block
+			if (!failed && !out.write(buffer->data.data(), buffer->size))
+				failed = true;
+			outChannel.release(buffer);
+		}
+		out.flush();
+	} catch (...) {
+		writerError = std::current_exception();
+		// keep recycling buffers until codec finishes
+		while (auto buffer = outChannel.receive())
+			outChannel.release(buffer);
+	}
+
+	if (failed && !writerError)
+		writerError = std::make_exception_ptr(std::runtime_error("IoPipeline: unable to write to output stream"));
+}
+
+void IoPipeline::join() {
+	if (writer.joinable())
+		writer.join();
+	if (reader.joinable())
+		reader.join();
+}
+
+void IoPipeline::finish() {
+	outputStream.flush();
+	outBuf.close();
+	if (writer.joinable())
+		writer.join();
+
+	// codec doesn't need to consume whole input, so stop reader
+	inChannel.abort();
+	if (reader.joinable())
+		reader.join();
+
+	if (readerError)
+		std::rethrow_exception(readerError);
+	if (writerError)
+		std::rethrow_exception(writerError);
+}
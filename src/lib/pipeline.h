@@ -0,0 +1,229 @@
+/**
+ * @file pipeline.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+/**
+ * Bounded lock-free single producer single consumer ring.
+ * Exactly one thread may push and exactly one other thread may pop.
+ * @param T trivially copyable element type
+ */
+template <typename T>
+class SpscRing
+{
+public:
+	/**
+	 * Creates ring.
+	 * @param capacity maximal number of elements, rounded up to power of two
+	 */
+	explicit SpscRing(std::size_t capacity) : head(0), tail(0) {
+		std::size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+		items.resize(size);
+		mask = size - 1;
+	}
+
+	/**
+	 * Pushes value to ring. Called only by producer.
+	 * @return false when ring is full
+	 */
+	bool tryPush(const T& value) {
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == items.size())
+			return false;
+
+		items[t & mask] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Pops value from ring. Called only by consumer.
+	 * @return false when ring is empty
+	 */
+	bool tryPop(T& value) {
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+			return false;
+
+		value = items[h & mask];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	std::vector<T> items;
+	std::size_t mask;
+
+	// head and tail are on separate cache lines so producer and consumer don't share them
+	char pad0[64];
+	std::atomic<std::size_t> head;		/// next position to pop, written by consumer
+	char pad1[64];
+	std::atomic<std::size_t> tail;		/// next position to push, written by producer
+	char pad2[64];
+};
+
+/**
+ * Buffer passed between pipeline stages.
+ */
+struct PipeBuffer
+{
+	explicit PipeBuffer(std::size_t capacity) : data(capacity), size(0) { }
+
+	std::vector<char> data;
+	std::size_t size;		/// number of valid bytes in data
+};
+
+/**
+ * One directional channel between two threads.
+ * Filled buffers go from producer to consumer, consumed ones are recycled
+ * back through second ring, so no allocation happens while streaming.
+ * Side waiting for buffer spins shortly and then sleeps until other side
+ * pushes one, so stalled input or output doesn't burn CPU.
+ */
+class BufferChannel
+{
+public:
+	/// Number of failed pops before waiting side sleeps
+	static const unsigned SPIN_COUNT = 64;
+
+	BufferChannel(std::size_t bufferSize, std::size_t numBuffers);
+
+	/// Gets empty buffer for producer, waits until some is recycled. Returns nullptr on abort.
+	PipeBuffer* acquire();
+	/// Passes filled buffer to consumer
+	void submit(PipeBuffer* buffer);
+	/// Signals consumer that no more buffers will come
+	void finish();
+
+	/// Gets next filled buffer for consumer. Returns nullptr at end of data or on abort.
+	PipeBuffer* receive();
+	/// Returns consumed buffer to producer
+	void release(PipeBuffer* buffer);
+
+	/// Wakes up both sides, all waiting calls return nullptr
+	void abort();
+private:
+	PipeBuffer* pop(SpscRing<PipeBuffer*>& ring);
+	void push(SpscRing<PipeBuffer*>& ring, PipeBuffer* buffer);
+	/// Wakes up side sleeping in pop
+	void wake();
+
+	std::vector<std::unique_ptr<PipeBuffer> > storage;
+	SpscRing<PipeBuffer*> filled;
+	SpscRing<PipeBuffer*> recycled;
+	std::atomic<bool> aborted;
+	bool finished;
+
+	/// Number of sides sleeping in pop, push takes mutex only when there are some
+	std::atomic<unsigned> sleepers;
+	std::mutex mutex;
+	std::condition_variable pushed;
+};
+
+/**
+ * Input stream buffer reading from consumer side of channel.
+ */
+class ChannelInputBuf : public std::streambuf
+{
+public:
+	explicit ChannelInputBuf(BufferChannel* channel) : channel(channel), current(nullptr) { }
+protected:
+	virtual int_type underflow();
+private:
+	BufferChannel* channel;
+	PipeBuffer* current;
+};
+
+/**
+ * Output stream buffer writing to producer side of channel.
+ */
+class ChannelOutputBuf : public std::streambuf
+{
+public:
+	explicit ChannelOutputBuf(BufferChannel* channel) : channel(channel), current(nullptr) { }
+
+	/// Submits pending data and signals end of data to consumer
+	void close();
+protected:
+	virtual int_type overflow(int_type c);
+	virtual int sync();
+private:
+	void submitCurrent();
+
+	BufferChannel* channel;
+	PipeBuffer* current;
+};
+
+/**
+ * Three stage pipeline: reader thread -> codec (calling thread) -> writer thread.
+ * Codec works with streams returned by {@link input} and {@link output},
+ * disk reads and writes happen concurrently in background threads.
+ */
+class IoPipeline
+{
+public:
+	static const std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+	static const std::size_t DEFAULT_NUM_BUFFERS = 4;
+
+	/**
+	 * Starts reader and writer threads.
+	 * @param in stream read by reader thread
+	 * @param out stream written by writer thread
+	 */
+	IoPipeline(std::istream& in, std::ostream& out,
+		std::size_t bufferSize = DEFAULT_BUFFER_SIZE, std::size_t numBuffers = DEFAULT_NUM_BUFFERS);
+
+	/// Stops threads without waiting for pending output
+	~IoPipeline();
+
+	/// Stream with data from reader thread
+	std::istream& input() {
+		return inputStream;
+	}
+
+	/// Stream with data for writer thread
+	std::ostream& output() {
+		return outputStream;
+	}
+
+	/**
+	 * Flushes output, waits for background threads.
+	 * @throws std::runtime_error when reading or writing failed
+	 */
+	void finish();
+private:
+	void readLoop(std::istream& in);
+	void writeLoop(std::ostream& out);
+	void join();
+
+	BufferChannel inChannel;
+	BufferChannel outChannel;
+	ChannelInputBuf inBuf;
+	ChannelOutputBuf outBuf;
+	std::istream inputStream;
+	std::ostream outputStream;
+
+	std::thread reader;
+	std::thread writer;
+	std::exception_ptr readerError;
+	std::exception_ptr writerError;
+};
+
+#endif // !PIPELINE_H
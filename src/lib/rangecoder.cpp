@@ -0,0 +1,94 @@
+/**
+ * @file rangecoder.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "rangecoder.h"
+
+#include <stdexcept>
+
+namespace {
+
+const size_t ENCODER_BUFFER_SIZE = 1 << 16;
+/// Encoder state is flushed by this number of bytes, decoder starts by reading them
+const int STATE_BYTES = 5;
+
+}
+
+const unsigned BitProbability::PROB_BITS;
+const uint32_t BitProbability::PROB_ONE;
+const unsigned BitProbability::MOVE_BITS;
+
+BinaryRangeEncoder::BinaryRangeEncoder(std::ostream* stream)
+	: stream(stream), low(0), range(UINT32_MAX), cache(0), cacheSize(1), closed(false) {
+	buffer.reserve(ENCODER_BUFFER_SIZE);
+}
+
+void BinaryRangeEncoder::close() {
+	if (closed)
+		return;
+	closed = true;
+
+	for (int i = 0; i < STATE_BYTES; ++i)
+		shiftLow();
+	writeBuffer();
+}
+
+void BinaryRangeEncoder::reset() {
+	close();
+
+	low = 0;
+	range = UINT32_MAX;
+	cache = 0;
+	cacheSize = 1;
+	closed = false;
+}
+
+void BinaryRangeEncoder::shiftLow() {
+	// byte can be written when carry can't change it anymore
+	if (static_cast<uint32_t>(low) < 0xFF000000U || (low >> 32) != 0) {
+		auto carry = static_cast<uint8_t>(low >> 32);
+		uint8_t byte = cache;
+		do {
+			buffer.push_back(static_cast<char>(byte + carry));
+			byte = 0xFF;
+		} while (--cacheSize != 0);
+		cache = static_cast<uint8_t>(low >> 24);
+	}
+	cacheSize++;
+	low = (low & 0x00FFFFFFU) << 8;
+
+	// state is complete, so write error leaves encoder consistent for close
+	if (buffer.size() >= ENCODER_BUFFER_SIZE)
+		writeBuffer();
+}
+
+void BinaryRangeEncoder::writeBuffer() {
+	if (!buffer.empty() && !stream->write(buffer.data(), buffer.size()))
+		throw std::runtime_error("BinaryRangeEncoder: unable to write to stream");
+	buffer.clear();
+}
+
+BinaryRangeDecoder::BinaryRangeDecoder(std::istream* stream) : buffer(BUFFER_SIZE) {
+	reset(stream);
+}
+
+void BinaryRangeDecoder::reset(std::istream* stream) {
+	this->stream = stream;
+	position = end = overrun = 0;
+	range = UINT32_MAX;
+	code = 0;
+	for (int i = 0; i < STATE_BYTES; ++i)
+		code = (code << 8) | nextByte();
+}
+
+bool BinaryRangeDecoder::fill() {
+	stream->read(buffer.data(), buffer.size());
+	end = static_cast<size_t>(stream->gcount());
+	position = 0;
+	if (stream->bad())
+		throw std::runtime_error("BinaryRangeDecoder: unable to read from stream");
+	return end > 0;
+}
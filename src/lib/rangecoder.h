@@ -0,0 +1,191 @@
+/**
+ * @file rangecoder.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef RANGE_CODER_H
+#define RANGE_CODER_H
+
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * Adaptive probability of zero bit for binary range coder.
+ * Probability is updated by shifts, so coding needs no division.
+ */
+class BitProbability
+{
+public:
+	static const unsigned PROB_BITS = 11;
+	static const uint32_t PROB_ONE = 1U << PROB_BITS;
+	/// Adaptation speed, larger is slower
+	static const unsigned MOVE_BITS = 5;
+
+	BitProbability() : prob(PROB_ONE / 2) { }
+
+	uint32_t value() const {
+		return prob;
+	}
+
+	void update(bool bit) {
+		if (bit)
+			prob -= prob >> MOVE_BITS;
+		else
+			prob += (PROB_ONE - prob) >> MOVE_BITS;
+	}
+private:
+	uint16_t prob;
+};
+
+/**
+ * Binary range encoder with carry propagation, bytes are written directly to stream.
+ */
+class BinaryRangeEncoder
+{
+public:
+	explicit BinaryRangeEncoder(std::ostream* stream);
+
+	/// Closes coded data, write errors are dropped, call close to get them
+	~BinaryRangeEncoder() {
+		try {
+			close();
+		} catch (std::exception&) {
+			// destructor may run during unwinding of earlier write error
+		}
+	}
+
+	/**
+	 * Encodes bit and updates its probability.
+	 */
+	void encode(BitProbability& prob, bool bit) {
+		uint32_t bound = (range >> BitProbability::PROB_BITS) * prob.value();
+		if (bit) {
+			low += bound;
+			range -= bound;
+		} else
+			range = bound;
+		prob.update(bit);
+
+		while (range < TOP) {
+			range <<= 8;
+			shiftLow();
+		}
+	}
+
+	/**
+	 * Encodes n low bits of value from MSB, each bit with its own probability.
+	 * @param probs probabilities of bit tree, 1 << n of them, first one is unused
+	 */
+	void encodeTree(BitProbability* probs, unsigned n, uint32_t value) {
+		uint32_t node = 1;
+		for (unsigned i = n; i-- > 0; ) {
+			bool bit = ((value >> i) & 1) != 0;
+			encode(probs[node], bit);
+			node = (node << 1) | (bit ? 1 : 0);
+		}
+	}
+
+	/**
+	 * Writes remaining state and buffered bytes to stream.
+	 * @throws std::runtime_error when writing to stream fails
+	 */
+	void close();
+
+	/**
+	 * Closes coded data and starts new independent data on the same stream,
+	 * decoder reads it after BinaryRangeDecoder::reset. Probabilities are not part of coder.
+	 */
+	void reset();
+private:
+	static const uint32_t TOP = 1U << 24;
+
+	void shiftLow();
+	void writeBuffer();
+
+	std::ostream* stream;
+	std::vector<char> buffer;
+
+	uint64_t low;
+	uint32_t range;
+	uint8_t cache;			/// last byte which may still be changed by carry
+	uint64_t cacheSize;		/// number of pending bytes, cache followed by 0xFF bytes
+	bool closed;
+};
+
+/**
+ * Binary range decoder for data written by BinaryRangeEncoder.
+ * Stream is read ahead, so decoder has to be the last one reading it.
+ */
+class BinaryRangeDecoder
+{
+public:
+	explicit BinaryRangeDecoder(std::istream* stream);
+
+	/**
+	 * Starts decoding data of new stream, buffer is reused.
+	 */
+	void reset(std::istream* stream);
+
+	/**
+	 * Decodes bit and updates its probability.
+	 */
+	bool decode(BitProbability& prob) {
+		uint32_t bound = (range >> BitProbability::PROB_BITS) * prob.value();
+		bool bit = code >= bound;
+		if (bit) {
+			code -= bound;
+			range -= bound;
+		} else
+			range = bound;
+		prob.update(bit);
+
+		while (range < TOP) {
+			range <<= 8;
+			code = (code << 8) | nextByte();
+		}
+		return bit;
+	}
+
+	/**
+	 * Decodes n bits coded by BinaryRangeEncoder::encodeTree.
+	 */
+	uint32_t decodeTree(BitProbability* probs, unsigned n) {
+		uint32_t node = 1;
+		for (unsigned i = 0; i < n; ++i)
+			node = (node << 1) | (decode(probs[node]) ? 1 : 0);
+		return node - (1U << n);
+	}
+
+	/// True when decoder needed more bytes than stream has, so stream is truncated
+	bool exhausted() const {
+		return overrun > 0;
+	}
+private:
+	static const uint32_t TOP = 1U << 24;
+	static const size_t BUFFER_SIZE = 1 << 16;
+
+	uint8_t nextByte() {
+		if (position == end && !fill()) {
+			overrun++;
+			return 0;
+		}
+		return static_cast<uint8_t>(buffer[position++]);
+	}
+
+	bool fill();
+
+	std::istream* stream;
+	std::vector<char> buffer;
+	size_t position;
+	size_t end;
+	size_t overrun;			/// number of bytes read past end of stream
+
+	uint32_t range;
+	uint32_t code;
+};
+
+#endif // !RANGE_CODER_H
@@ -0,0 +1,148 @@
+/**
+ * @file threadpool.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// waits are always in predicate loops, timeout only bounds how long a missed
+// notification could delay worker
+const std::chrono::milliseconds WAIT_TIMEOUT(100);
+
+}
+
+ThreadPool::ThreadPool(std::size_t numThreads) : nextWorker(0), queued(0), unfinished(0), stopping(false) {
+	if (numThreads == 0)
+		numThreads = std::max(1U, std::thread::hardware_concurrency());
+
+	for (std::size_t i = 0; i < numThreads; ++i)
+		workers.push_back(std::unique_ptr<Worker>(new Worker()));
+
+	// ids are assigned under lock so workers see all of them before taking first task
+	std::lock_guard<std::mutex> lock(stateMutex);
+	for (std::size_t i = 0; i < numThreads; ++i) {
+		threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+		workers[i]->id = threads.back().get_id();
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(stateMutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+std::size_t ThreadPool::currentWorker() const {
+	auto id = std::this_thread::get_id();
+	for (std::size_t i = 0; i < workers.size(); ++i) {
+		if (workers[i]->id == id)
+			return i;
+	}
+	return workers.size();
+}
+
+void ThreadPool::submit(Task task) {
+	auto index = currentWorker();
+
+	std::unique_lock<std::mutex> lock(stateMutex);
+	unfinished++;
+	if (index == workers.size())
+		index = nextWorker++ % workers.size();
+	lock.unlock();
+
+	{
+		std::lock_guard<std::mutex> workerLock(workers[index]->mutex);
+		workers[index]->tasks.push_back(std::move(task));
+	}
+
+	lock.lock();
+	queued++;
+	lock.unlock();
+	workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(stateMutex);
+	while (unfinished > 0)
+		allDone.wait_for(lock, WAIT_TIMEOUT);
+
+	if (error) {
+		auto e = error;
+		error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+bool ThreadPool::takeTask(std::size_t index, Task& task) {
+	// own tasks first, newest one
+	{
+		auto& own = *workers[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// steal oldest task of someone else
+	for (std::size_t i = 1; i < workers.size(); ++i) {
+		auto& victim = *workers[(index + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(std::size_t index) {
+	{
+		// wait until constructor publishes worker ids
+		std::lock_guard<std::mutex> lock(stateMutex);
+	}
+
+	for (;;) {
+		Task task;
+		if (!takeTask(index, task)) {
+			std::unique_lock<std::mutex> lock(stateMutex);
+			while (queued <= 0 && !stopping)
+				workAvailable.wait_for(lock, WAIT_TIMEOUT);
+			if (stopping)
+				return;
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(stateMutex);
+			queued--;
+		}
+
+		std::exception_ptr taskError;
+		try {
+			task();
+		} catch (...) {
+			taskError = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(stateMutex);
+		if (taskError && !error)
+			error = taskError;
+		if (--unfinished == 0)
+			allDone.notify_all();
+	}
+}
@@ -0,0 +1,80 @@
+/**
+ * @file threadpool.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Thread pool with work stealing.
+ * Every worker has its own task deque. Tasks submitted from worker go to its own deque
+ * and it takes them from back (LIFO, good locality), idle workers steal from front
+ * of other deques, so a task spawning many subtasks doesn't keep them on one thread.
+ */
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	/**
+	 * Starts workers.
+	 * @param numThreads number of workers, 0 means number of hardware threads
+	 */
+	explicit ThreadPool(std::size_t numThreads = 0);
+
+	/// Waits for running tasks and stops workers. Tasks not started yet are dropped.
+	~ThreadPool();
+
+	/**
+	 * Queues task. May be called from tasks.
+	 */
+	void submit(Task task);
+
+	/**
+	 * Waits until all submitted tasks including those submitted by tasks are done.
+	 * @throws first exception thrown by some task
+	 */
+	void wait();
+
+	/// Number of workers
+	std::size_t size() const {
+		return workers.size();
+	}
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::thread::id id;
+	};
+
+	void workerLoop(std::size_t index);
+	bool takeTask(std::size_t index, Task& task);
+	std::size_t currentWorker() const;
+
+	std::vector<std::unique_ptr<Worker> > workers;
+	std::vector<std::thread> threads;
+	std::size_t nextWorker;		/// round robin target for submits from outside of pool
+
+	std::mutex stateMutex;
+	std::condition_variable workAvailable;
+	std::condition_variable allDone;
+	long queued;				/// tasks in deques, can go negative for short time
+	std::size_t unfinished;		/// tasks submitted and not finished
+	bool stopping;
+	std::exception_ptr error;
+};
+
+#endif // !THREAD_POOL_H
@@ -7,6 +7,9 @@
 
 #include "utils.h"
 
+#include <cctype>
+#include <cerrno>
+#include <limits>
 #include <stdexcept>
 #include <string>
 
@@ -47,4 +50,33 @@ std::vector<std::string> parseCmdline(int argc, char* argv[], OptionsMap& option
 	}
 
 	return leftovers;
-}
\ No newline at end of file
+}
+
+LzwMethod selectedMethod(OptionsMap& options) {
+	if (options["-auto"].isPresent)
+		return LZW_METHOD_AUTO;
+	if (options["a"].isPresent) {
+		if (options["w"].isPresent)
+			return options["f"].isPresent ? LZW_METHOD_ARITHMETIC_POW2_64 : LZW_METHOD_ARITHMETIC_64;
+		return options["f"].isPresent ? LZW_METHOD_ARITHMETIC_POW2 : LZW_METHOD_ARITHMETIC;
+	}
+	if (options["h"].isPresent)
+		return LZW_METHOD_HUFFMAN;
+	if (options["r"].isPresent)
+		return LZW_METHOD_BITTREE;
+	return LZW_METHOD_VARIABLE;
+}
+
+size_t memoryLimit(OptionsMap& options) {
+	auto& argument = options["m"].argument;
+	char* end;
+	errno = 0;
+	auto mib = std::strtoull(argument.c_str(), &end, 10);
+	// strtoull accepts sign and leading spaces, limit has to be plain number
+	if (argument.empty() || !std::isdigit(static_cast<unsigned char>(argument[0])) || *end != '\0'
+		|| errno == ERANGE || mib > (std::numeric_limits<size_t>::max() >> 20))
+		throw std::runtime_error("Invalid memory limit: " + argument);
+	if (mib == 0)
+		return MemoryBudget::UNLIMITED;
+	return static_cast<size_t>(mib) << 20;
+}
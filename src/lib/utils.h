@@ -8,8 +8,11 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "lzwblock.h"
+
 #include <cstdlib>
 #include <map>
+#include <string>
 #include <vector>
 
 /**
@@ -76,4 +79,16 @@ typedef std::map<std::string, Option> OptionsMap;
 void addOption(const std::string& option, const std::string& arg, OptionsMap& options);
 std::vector<std::string> parseCmdline(int argc, char* argv[], OptionsMap& options);
 
+/**
+ * Method of LZW coding from -a (with -f and -w), -h, -r and --auto options,
+ * variable length codes when none is given. Options not used by program are not present.
+ */
+LzwMethod selectedMethod(OptionsMap& options);
+
+/**
+ * Memory limit in bytes from -m option in mebibytes, 0 is unlimited.
+ * @throws std::runtime_error when argument isn't plain number or limit is too large
+ */
+size_t memoryLimit(OptionsMap& options);
+
 #endif // !UTILS_H
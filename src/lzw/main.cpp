@@ -6,117 +6,514 @@
  */
 
 #include "utils.h"
-#include "lzwdecoder.h"
-#include "lzwencoder.h"
+#include "lzwblock.h"
+#include "lzwestimate.h"
+#include "pipeline.h"
+#include "fdstream.h"
+#include "batchio.h"
+#include "lzwarchive.h"
+#ifndef _WIN32
+#include "lzwdaemon.h"
+#endif // !_WIN32
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <algorithm>
+
+/// Number of files read, coded and written together in batch mode
+const size_t BATCH_FILES = 256;
 
 void printUsage() {
-	std::cout << "lzw [-a] INPUT OUTPUT\n"
-		<< "lzw -d INPUT OUTPUT\n";
+	std::cout << "lzw [-1..-9|-a [-f] [-w]|-h|-r|--auto [--tolerance PERCENT]] [--dedup [--dedup-window MIB]] [--append] [--sync] [-m MIB] [-v] [-p] INPUT OUTPUT\n"
+		<< "lzw --estimate [--tolerance PERCENT] [-m MIB] INPUT\n"
+		<< "lzw -d [-m MIB] [-t THREADS] [-v] [-p] INPUT OUTPUT\n"
+		<< "lzw --concat OUTPUT INPUT...\n"
+		<< "lzw --daemon SOCKET [-d] INPUT OUTPUT\n"
+		<< "lzw -b [-d] [-a|-h|-r] [-m MIB] [-u] [-q DEPTH] FILE...\n"
+		<< "lzw -c ARCHIVE [-a|-h|-r] [-m MIB] [-t THREADS] FILE|DIR...\n"
+		<< "lzw -x ARCHIVE [-m MIB] [-t THREADS] [DIR]\n"
+		<< "lzw -l ARCHIVE\n\n"
+		<< "INPUT or OUTPUT can be - for standard input or output. Holes of sparse INPUT file are\n"
+		<< "stored without reading them and decompression to file creates them again.\n\n"
+		<< "    -1..-9  Compression level, -1 decodes fastest, -9 gives smallest output, level sets\n"
+		<< "          method, block size, dictionary reset and threads, it's stored in OUTPUT header,\n"
+		<< "          -7, -8 and -9 deduplicate within window of 16, 64 and 256 MiB like --dedup\n"
+		<< "    -a    Use arithmetic coding of LZW codes\n"
+		<< "    -f    With -a use data model with power of two total frequency, faster coding\n"
+		<< "    -w    With -a use 64bit interval in arithmetic coder\n"
+		<< "    -h    Use canonical Huffman coding of LZW codes\n"
+		<< "    -r    Use binary range coding of LZW codes with bit tree models\n"
+		<< "    -d    Decompression instead compression\n"
+		<< "    --auto       Select method by estimating coded size of samples of block, fastest method\n"
+		<< "                 within tolerance of the smallest result is used for next 8 MiB\n"
+		<< "    --tolerance  Allowed size increase of faster method in percent (default 5)\n"
+		<< "    --estimate   Print estimated coded size of INPUT for every method, no output is written\n"
+		<< "    --dedup      Replace chunks repeated within window by references before LZW coding\n"
+		<< "    --dedup-window  Size of deduplication window in mebibytes (default 256), it's cut so that\n"
+		<< "                 it fits to -m with dictionary, decompression needs the same -m or larger\n"
+		<< "    --append     Continue OUTPUT written with --append by INPUT, method and block settings\n"
+		<< "                 of OUTPUT are kept, OUTPUT is created when it doesn't exist\n"
+		<< "    --sync       Flush INPUT as it arrives, so OUTPUT decodes everything read so far,\n"
+		<< "                 dictionary is kept between flushes (for pipes and interactive use)\n"
+		<< "    --concat     Join compressed INPUT files to OUTPUT as members of one stream without\n"
+		<< "                 recompressing, decompression decodes members one after another\n"
+		<< "    --daemon     Compress or decompress by lzwd listening on SOCKET, method is set by lzwd\n"
+		<< "    -m    Limit memory of dictionary and deduplication window to MIB mebibytes, dictionary\n"
+		<< "          is reset when it's full, decompression fails on stream needing more\n"
+		<< "          (default 0 is unlimited)\n"
+		<< "    -v    Print peak dictionary memory, deduplication window included\n"
+		<< "    -p    Pipelined mode, read and write in background threads\n"
+		<< "    -b    Batch mode, FILE is coded to FILE.lzw, with -d FILE.lzw is decoded to FILE\n"
+		<< "    -u    Use io_uring for batch file I/O when available\n"
+		<< "    -q    Number of files with I/O in flight in batch mode (default 32)\n"
+		<< "    -c    Create archive from files and directories\n"
+		<< "    -x    Extract archive to DIR or current directory\n"
+		<< "    -l    List archive content\n"
+		<< "    -t    Number of threads for archive mode (default number of cores), with -d decoded\n"
+		<< "          strings are expanded on THREADS threads\n";
 }
 
-template <class CodeWriter>
-void compressData(std::istream& in, std::ostream& out) {
-	auto initSize = out.tellp();
+/// Compression level from -1 .. -9 options, 0 when none is given
+int selectedLevel(OptionsMap& options) {
+	int level = 0;
+	for (int i = LzwLevel::MIN; i <= LzwLevel::MAX; ++i) {
+		if (options[std::string(1, static_cast<char>('0' + i))].isPresent)
+			level = i;
+	}
+	return level;
+}
+
+/// Allowed size increase of faster method in automatic selection from --tolerance option
+double autoTolerance(OptionsMap& options) {
+	return std::strtod(options["-tolerance"].argument.c_str(), nullptr) / 100;
+}
 
-	LzwEncoder encoder(std::make_shared<CodeWriter>(&out));
+const char* methodName(LzwMethod method) {
+	switch (method) {
+	case LZW_METHOD_VARIABLE: return "variable";
+	case LZW_METHOD_ARITHMETIC: return "arithmetic";
+	case LZW_METHOD_HUFFMAN: return "huffman";
+	case LZW_METHOD_BITTREE: return "bittree";
+	case LZW_METHOD_ARITHMETIC_POW2: return "arithmetic-pow2";
+	case LZW_METHOD_ARITHMETIC_64: return "arithmetic-64";
+	case LZW_METHOD_ARITHMETIC_POW2_64: return "arithmetic-pow2-64";
+	case LZW_METHOD_AUTO: return "auto";
+	}
+	return "unknown";
+}
 
-	std::streamoff bytesWritten = 0;
-	size_t bytesRead = 0;
-	double oldRatio = 1.0;
-	int ratioIncreaseCounter = 0;
-	int c;
-	while ((c = in.get()) != std::char_traits<char>::eof()) {
-		encoder.encode(c);
+/// Dry run, prints estimated coded size of input for every method
+void estimate(std::istream& in, OptionsMap& options) {
+	uint64_t size;
+	// more windows than for one block, input may be large and varied
+	auto estimates = estimateLzwMethods(in, size, memoryLimit(options), 4 * LZW_ESTIMATE_WINDOWS);
 
-		/*bytesWritten = out.tellp() - initSize;
-		bytesRead++;
+	std::cout << "method\tsampled\tcoded\tratio\testimated size\n";
+	for (auto& e : estimates) {
+		std::cout << methodName(e.method) << "\t" << e.sampleSize << "\t" << e.codedSize << "\t"
+			<< e.ratio() << "\t" << static_cast<uint64_t>(e.ratio() * size) << "\n";
+	}
+	std::cout << "selected\t" << methodName(selectLzwMethod(estimates, autoTolerance(options))) << "\n";
+}
 
-		// erase encoder dictionary if compression ration has increased
-		// 10times in row. This could happen if encoder dictionary is full
-		double compressRatio = bytesWritten / (double)bytesRead;
-		if (compressRatio > oldRatio) {
-			if (ratioIncreaseCounter++ > 10)
-				encoder.eraseDictionary();
-		} else
-			ratioIncreaseCounter = 0;
+#ifndef _WIN32
+/// Codes whole input by lzwd, which saves building of codec for short inputs
+void runDaemon(std::istream& in, std::ostream& out, OptionsMap& options) {
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	LzwDaemonClient client(options["-daemon"].argument);
+	auto result = options["d"].isPresent ? client.decompress(data.data(), data.size())
+		: client.compress(data.data(), data.size());
+	out.write(result.data(), result.size());
+}
+#endif // !_WIN32
+
+/// Reads at least one byte and then only bytes input has already available, returns 0 at end of input
+size_t readAvailable(std::istream& in, char* data, size_t size) {
+	auto buf = in.rdbuf();
+	if (std::char_traits<char>::eq_int_type(buf->sgetc(), std::char_traits<char>::eof()))
+		return 0;
+	auto available = std::max<std::streamsize>(buf->in_avail(), 1);
+	return static_cast<size_t>(buf->sgetn(data, std::min<std::streamsize>(available, static_cast<std::streamsize>(size))));
+}
 
-		oldRatio = compressRatio;*/
+/// Writes whole input to writer and closes it, returns peak dictionary memory
+size_t writeAll(std::istream& in, LzwBlockWriter& writer, OptionsMap& options) {
+	std::vector<char> buffer(LzwBlockWriter::DEFAULT_BLOCK_SIZE);
+	if (options["-sync"].isPresent) {
+		// data are flushed when input has nothing more at the moment
+		while (auto n = readAvailable(in, buffer.data(), buffer.size())) {
+			writer.write(buffer.data(), n);
+			writer.flush();
+		}
+	} else {
+		while (in) {
+			in.read(buffer.data(), buffer.size());
+			writer.write(buffer.data(), static_cast<size_t>(in.gcount()));
+		}
+		// read error isn't end of input, output would be truncated
+		if (in.bad())
+			throw std::runtime_error("Unable to read input");
 	}
+	writer.close();
+	return writer.peakMemory();
+}
+
+/// Creates writer of compressed stream with settings of options
+std::unique_ptr<LzwBlockWriter> createWriter(std::ostream& out, LzwMethod method, OptionsMap& options) {
+	auto level = selectedLevel(options);
+	std::unique_ptr<LzwBlockWriter> writer(level != 0
+		? new LzwBlockWriter(&out, lzwLevel(level), memoryLimit(options))
+		: new LzwBlockWriter(&out, method, LzwBlockWriter::DEFAULT_BLOCK_SIZE, memoryLimit(options)));
+	// level has its own tolerance of automatic selection
+	if (level == 0 || options["-tolerance"].isPresent)
+		writer->setAutoTolerance(autoTolerance(options));
+	writer->setCheckpoint(options["-append"].isPresent);
+	if (options["-dedup"].isPresent)
+		writer->setDedupWindow(static_cast<size_t>(std::strtoul(options["-dedup-window"].argument.c_str(), nullptr, 10)) << 20);
+	return writer;
+}
+
+size_t compress(std::istream& in, std::ostream& out, LzwMethod method, OptionsMap& options) {
+	return writeAll(in, *createWriter(out, method, options), options);
+}
+
+/// Compresses sparse file, only its data are read and holes are written as hole blocks
+size_t compressSparse(const std::string& path, const std::vector<FileExtent>& extents, uint64_t size,
+		std::ostream& out, OptionsMap& options) {
+	std::ifstream in(path.c_str(), std::ios_base::binary);
+	if (!in)
+		throw std::runtime_error("Unable to open input file: " + path);
+
+	auto writer = createWriter(out, selectedMethod(options), options);
+	std::vector<char> buffer(LzwBlockWriter::DEFAULT_BLOCK_SIZE);
+	uint64_t position = 0;
+	for (auto& extent : extents) {
+		writer->writeHole(extent.offset - position);
+		in.seekg(static_cast<std::streamoff>(extent.offset));
+		for (auto remaining = extent.length; remaining > 0; ) {
+			auto n = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+			if (!in.read(buffer.data(), n))
+				throw std::runtime_error("Unable to read input file: " + path);
+			writer->write(buffer.data(), n);
+			remaining -= n;
+		}
+		position = extent.offset + extent.length;
+	}
+	writer->writeHole(size - position);
+	writer->close();
+	return writer->peakMemory();
+}
+
+/**
+ * Continues stream in output file from its checkpoint, only last block which isn't full is read again.
+ * New tail is written to temporary file first and output is cut only when it's complete,
+ * so failed compression leaves output as it was.
+ */
+size_t append(std::istream& in, const std::string& output, OptionsMap& options) {
+	std::ifstream existing(output.c_str(), std::ios_base::binary);
+	if (!existing) {
+		auto out = openOutputStream(output);
+		if (!*out)
+			throw std::runtime_error("Unable to open output file: " + output);
+		auto peak = compress(in, *out, selectedMethod(options), options);
+		if (!out->flush())
+			throw std::runtime_error("Unable to write output file: " + output);
+		return peak;
+	}
+
+	auto checkpoint = LzwCheckpoint::read(existing);
+	auto lastBlock = checkpoint.readLastBlock(existing, memoryLimit(options));
+	// old tail is put back when new one can't be copied to output
+	existing.clear();
+	existing.seekg(static_cast<std::streamoff>(checkpoint.resumeOffset()));
+	std::string oldTail((std::istreambuf_iterator<char>(existing)), std::istreambuf_iterator<char>());
+	existing.close();
+
+	auto tailPath = output + ".tmp";
+	size_t peak;
+	{
+		std::ofstream tail(tailPath.c_str(), std::ios_base::binary | std::ios_base::trunc);
+		if (!tail)
+			throw std::runtime_error("Unable to open temporary file: " + tailPath);
+		try {
+			LzwBlockWriter writer(&tail, checkpoint, memoryLimit(options));
+			writer.setAutoTolerance(autoTolerance(options));
+			writer.write(lastBlock.data(), lastBlock.size());
+			peak = writeAll(in, writer, options);
+			if (!tail.flush())
+				throw std::runtime_error("Unable to write temporary file: " + tailPath);
+		} catch (...) {
+			tail.close();
+			std::remove(tailPath.c_str());
+			throw;
+		}
+	}
+
+	std::ifstream tail(tailPath.c_str(), std::ios_base::binary);
+	auto out = openTruncatedStream(output, checkpoint.resumeOffset());
+	bool copied = tail && *out && (*out << tail.rdbuf()) && out->flush();
+	out.reset();
+	tail.close();
+	std::remove(tailPath.c_str());
+	if (!copied) {
+		auto restored = openTruncatedStream(output, checkpoint.resumeOffset());
+		restored->write(oldTail.data(), oldTail.size());
+		restored->flush();
+		throw std::runtime_error("Unable to write output file: " + output);
+	}
+	return peak;
+}
+
+void run(std::istream& in, std::ostream& out, OptionsMap& options) {
+	size_t peak;
+	if (options["d"].isPresent) {
+		std::unique_ptr<ThreadPool> pool;
+		if (options["t"].isPresent)
+			pool.reset(new ThreadPool(std::strtoul(options["t"].argument.c_str(), nullptr, 10)));
+		peak = decompressLzwStream(in, out, memoryLimit(options), pool.get());
+	} else
+		peak = compress(in, out, selectedMethod(options), options);
+
+	if (options["v"].isPresent)
+		std::cerr << "Peak dictionary memory: " << peak << " bytes\n";
 }
 
-void compressVariableLength(std::istream& in, std::ostream& out) {
-	const char* header = "LZW\x00";
-	out.write(header, 4);
+/// Joins compressed files as members of one stream
+void concat(const std::vector<std::string>& inputs, const std::string& output) {
+	auto out = openOutputStream(output);
+	if (!*out)
+		throw std::runtime_error("Unable to open output file: " + output);
 
-	compressData<VariableCodeWriter>(in, out);
+	uint64_t offset = 0;
+	for (auto& input : inputs) {
+		std::ifstream member(input.c_str(), std::ios_base::binary);
+		if (!member)
+			throw std::runtime_error("Unable to open input file: " + input);
+		try {
+			offset += appendLzwMember(member, *out, offset);
+		} catch (std::runtime_error& e) {
+			throw std::runtime_error(input + ": " + e.what());
+		}
+	}
+	if (!out->flush())
+		throw std::runtime_error("Unable to write output file: " + output);
 }
 
-void compressWithArithmeticCoding(std::istream& in, std::ostream& out) {
-	const char* header = "LZW\x01";
-	out.write(header, 4);
+std::string batchOutputName(const std::string& input, bool decompress) {
+	const std::string suffix = ".lzw";
+	if (!decompress)
+		return input + suffix;
 
-	compressData<ArithmeticCodeWriter>(in, out);
+	if (input.size() <= suffix.size() || input.compare(input.size() - suffix.size(), suffix.size(), suffix) != 0)
+		throw std::runtime_error("Input file doesn't have .lzw suffix: " + input);
+	return input.substr(0, input.size() - suffix.size());
 }
 
-template <class CodeReader>
-void decompressData(std::istream& in, std::ostream& out) {
-	LzwDecoder decoder(std::make_shared<CodeReader>(&in));
-	decoder.decode(out);
+void runBatch(const std::vector<std::string>& files, OptionsMap& options) {
+	auto queueDepth = std::strtoul(options["q"].argument.c_str(), nullptr, 10);
+	if (queueDepth == 0)
+		throw std::runtime_error("Invalid queue depth: " + options["q"].argument);
+
+	auto io = createBatchFileIo(options["u"].isPresent, static_cast<unsigned>(queueDepth));
+
+	std::vector<std::string> inputs, outputs, contents, results;
+	for (size_t first = 0; first < files.size(); first += BATCH_FILES) {
+		auto last = std::min(first + BATCH_FILES, files.size());
+		inputs.assign(files.begin() + first, files.begin() + last);
+		outputs.clear();
+		for (auto& input : inputs)
+			outputs.push_back(batchOutputName(input, options["d"].isPresent));
+
+		io->readFiles(inputs, contents);
+
+		results.resize(contents.size());
+		for (size_t i = 0; i < contents.size(); ++i) {
+			std::istringstream in(contents[i]);
+			std::ostringstream out;
+			run(in, out, options);
+			results[i] = out.str();
+		}
+
+		io->writeFiles(outputs, results);
+	}
 }
 
-void decompress(std::istream& in, std::ostream& out) {
-	char header[5] = {0};
-	in.read(header, 4);
-	if (header[0] != 'L' || header[1] != 'Z' || header[2] != 'W')
-		throw std::runtime_error("Bad input header magic string.");
+void runArchive(const std::vector<std::string>& files, OptionsMap& options) {
+	if (options["l"].isPresent) {
+		auto entries = LzwArchive::readIndex(options["l"].argument);
+		for (auto& entry : entries) {
+			uint64_t stored = 0;
+			for (auto& part : entry.parts)
+				stored += part.storedSize;
+			std::cout << entry.size << "\t" << stored << "\t" << entry.path << "\n";
+		}
+		return;
+	}
 
-	if (header[3] == '\x00')
-		decompressData<VariableCodeReader>(in, out);
-	else if (header[3] == '\x01')
-		decompressData<ArithmeticCodeReader>(in, out);
-	else
-		throw std::runtime_error("Invalid header value.");
+	ThreadPool pool(std::strtoul(options["t"].argument.c_str(), nullptr, 10));
+	if (options["c"].isPresent) {
+		LzwArchive::create(options["c"].argument, files, selectedMethod(options), pool, memoryLimit(options));
+	} else
+		LzwArchive::extract(options["x"].argument, files.empty() ? "" : files[0], pool, memoryLimit(options));
 }
 
 int main(int argc, char* argv[]) {
 	std::string input, output;
+	std::vector<std::string> lefovers;
+	bool archiveMode = false;
 	OptionsMap options = create_map<OptionsMap::key_type, OptionsMap::mapped_type>
-		("d", Option())("a", Option());
+		("d", Option())("a", Option())("h", Option())("r", Option())("f", Option())("w", Option())("m", Option("0"))("v", Option())("-auto", Option())("-tolerance", Option("5"))("-estimate", Option())("-dedup", Option())("-dedup-window", Option("256"))("-append", Option())("-sync", Option())("-concat", Option(""))("-daemon", Option(""))("p", Option())("b", Option())("u", Option())("q", Option("32"))
+		("c", Option(""))("x", Option(""))("l", Option(""))("t", Option("0"))
+		("1", Option())("2", Option())("3", Option())("4", Option())("5", Option())("6", Option())("7", Option())("8", Option())("9", Option());
 	try {
-		auto lefovers = parseCmdline(argc, argv, options);
-		if (lefovers.size() != 2)
-			throw std::runtime_error("Missing leftover args");
-		input = lefovers[0];
-		output = lefovers[1];
+		lefovers = parseCmdline(argc, argv, options);
+		archiveMode = options["c"].isPresent || options["x"].isPresent || options["l"].isPresent;
+		memoryLimit(options);
+		if (selectedLevel(options) != 0 && (options["a"].isPresent || options["h"].isPresent
+			|| options["r"].isPresent || options["-auto"].isPresent))
+			throw std::runtime_error("Compression level can't be combined with method options");
+		if (options["-daemon"].isPresent && (selectedLevel(options) != 0 || options["a"].isPresent
+			|| options["h"].isPresent || options["r"].isPresent || options["-auto"].isPresent))
+			throw std::runtime_error("Method of daemon can't be changed by client");
+		if (options["c"].isPresent) {
+			if (lefovers.empty())
+				throw std::runtime_error("Missing files to archive");
+		} else if (options["x"].isPresent) {
+			if (lefovers.size() > 1)
+				throw std::runtime_error("Too many leftover args");
+		} else if (options["l"].isPresent) {
+			if (!lefovers.empty())
+				throw std::runtime_error("Too many leftover args");
+		} else if (options["-concat"].isPresent) {
+			if (lefovers.empty())
+				throw std::runtime_error("Missing input files");
+		} else if (options["-estimate"].isPresent) {
+			if (lefovers.size() != 1)
+				throw std::runtime_error("Missing input file");
+			input = lefovers[0];
+		} else if (options["b"].isPresent) {
+			if (lefovers.empty())
+				throw std::runtime_error("Missing input files");
+		} else {
+			if (lefovers.size() != 2)
+				throw std::runtime_error("Missing leftover args");
+			input = lefovers[0];
+			output = lefovers[1];
+		}
 	} catch (std::exception& e) {
 		std::cerr << "Error: " << e.what() << std::endl;
 		printUsage();
 		return 2;
 	}
 
-	std::ifstream ifile(input.c_str(), std::ios_base::binary);
-	if (!ifile) {
+	if (archiveMode) {
+		try {
+			runArchive(lefovers, options);
+		} catch (std::exception& e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (options["-concat"].isPresent) {
+		try {
+			concat(lefovers, options["-concat"].argument);
+		} catch (std::exception& e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (options["b"].isPresent) {
+		try {
+			runBatch(lefovers, options);
+		} catch (std::exception& e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	auto ifile = openInputStream(input);
+	if (!*ifile) {
 		std::cerr << "Error: Unable to open input file: " << input << std::endl;
 		return 1;
 	}
 
-	std::ofstream ofile(output.c_str(), std::ios_base::binary);
-	if (!ofile) {
+	if (options["-estimate"].isPresent) {
+		try {
+			estimate(*ifile, options);
+		} catch (std::exception& e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (options["-append"].isPresent) {
+		try {
+			if (output == "-")
+				throw std::runtime_error("Standard output can't be appended to");
+			auto peak = append(*ifile, output, options);
+			if (options["v"].isPresent)
+				std::cerr << "Peak dictionary memory: " << peak << " bytes\n";
+		} catch (std::exception& e) {
+			std::cerr << "Error: " << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	auto ofile = openOutputStream(output);
+	if (!*ofile) {
 		std::cerr << "Error: Unable to open output file: " << output << std::endl;
 		return 1;
 	}
 
-	if (options["d"].isPresent) {
-		decompress(ifile, ofile);
-	} else {
-		if (options["a"].isPresent) {
-			compressWithArithmeticCoding(ifile, ofile);
-		} else {
-			compressVariableLength(ifile, ofile);
+	// fast levels run input and output in background threads like -p
+	auto level = selectedLevel(options);
+	bool pipelined = options["p"].isPresent || (!options["d"].isPresent && level != 0 && lzwLevel(level).threads > 1);
+	try {
+		// holes of sparse input file aren't read, they are stored as hole blocks
+		uint64_t inputSize = 0, dataSize = 0;
+		std::vector<FileExtent> extents;
+		if (!options["d"].isPresent && !options["-sync"].isPresent && !options["-daemon"].isPresent && input != "-") {
+			// zeros of holes shorter than block are cheap runs, hole block would cut block short
+			extents = findDataExtents(input, inputSize, LzwBlockWriter::DEFAULT_BLOCK_SIZE);
+			for (auto& extent : extents)
+				dataSize += extent.length;
 		}
+
+		if (options["-daemon"].isPresent) {
+#ifndef _WIN32
+			runDaemon(*ifile, *ofile, options);
+#else
+			throw std::runtime_error("Daemon isn't supported on this system");
+#endif // !_WIN32
+		} else if (dataSize < inputSize) {
+			auto peak = compressSparse(input, extents, inputSize, *ofile, options);
+			if (options["v"].isPresent)
+				std::cerr << "Peak dictionary memory: " << peak << " bytes\n";
+		} else if (pipelined) {
+			IoPipeline pipeline(*ifile, *ofile);
+			run(pipeline.input(), pipeline.output(), options);
+			pipeline.finish();
+		} else
+			run(*ifile, *ofile, options);
+
+		if (!ofile->flush())
+			throw std::runtime_error("Unable to write output file: " + output);
+	} catch (std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
 	}
 
 	return 0;
@@ -0,0 +1,67 @@
+/**
+ * @file main.cpp
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#include "utils.h"
+#include "lzwdaemon.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <csignal>
+
+namespace {
+
+LzwDaemon* runningDaemon = nullptr;
+
+extern "C" void stopDaemon(int) {
+	if (runningDaemon)
+		runningDaemon->stop();
+}
+
+}
+
+void printUsage() {
+	std::cout << "lzwd [-a|-h|-r|--auto] [-t THREADS] [-m MIB] SOCKET\n\n"
+		<< "Serves compression and decompression requests of lzw --daemon on Unix socket SOCKET\n"
+		<< "until it gets SIGINT or SIGTERM. Requests arriving together are coded as one batch.\n\n"
+		<< "    -a    Use arithmetic coding of LZW codes\n"
+		<< "    -h    Use canonical Huffman coding of LZW codes\n"
+		<< "    -r    Use binary range coding of LZW codes with bit tree models\n"
+		<< "    --auto  Select method of every block by estimating coded size of samples\n"
+		<< "    -t    Number of coding threads (default number of cores)\n"
+		<< "    -m    Limit dictionary memory of every thread to MIB mebibytes (default 0 is unlimited)\n";
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> lefovers;
+	size_t limit;
+	OptionsMap options = create_map<OptionsMap::key_type, OptionsMap::mapped_type>
+		("a", Option())("h", Option())("r", Option())("-auto", Option())("t", Option("0"))("m", Option("0"));
+	try {
+		lefovers = parseCmdline(argc, argv, options);
+		if (lefovers.size() != 1)
+			throw std::runtime_error("Missing socket path");
+		limit = memoryLimit(options);
+	} catch (std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		printUsage();
+		return 2;
+	}
+
+	try {
+		LzwDaemon daemon(lefovers[0], std::strtoul(options["t"].argument.c_str(), nullptr, 10),
+			selectedMethod(options), limit);
+		runningDaemon = &daemon;
+		std::signal(SIGINT, stopDaemon);
+		std::signal(SIGTERM, stopDaemon);
+		daemon.run();
+		runningDaemon = nullptr;
+	} catch (std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -37,4 +37,154 @@ TEST_F(TestAC, DynamicDataModel) {
 		auto decoded = ad.decode(&dataModel);
 		EXPECT_EQ(simpleData[i], decoded);
 	}
-}
\ No newline at end of file
+}
+
+TEST_F(TestAC, PowerOfTwoDataModel) {
+	// skewed data so model rescales to unequal frequencies
+	std::vector<unsigned> data;
+	for (int i = 0; i < 20000; ++i)
+		data.push_back(rand() % 7 == 0 ? rand() % 257 : rand() % 4);
+
+	std::ostringstream os;
+	PowerOfTwoDataModel dataModel(257, 16);
+	EXPECT_EQ(1u << 16, dataModel.getCumulativeFreq(256));
+
+	auto ae = ArithmeticEncoder(std::make_shared<BitStreamWriter>(&os));
+	for (auto val : data)
+		ae.encode(val, &dataModel);
+	ae.reset();
+
+	// total frequency stays power of two
+	EXPECT_EQ(1u << 16, dataModel.getCumulativeFreq(256));
+	EXPECT_LT(os.str().size(), data.size());
+	dataModel.reset();
+
+	std::istringstream is(os.str());
+	auto ad = ArithmeticDecoder(std::make_shared<BitStreamReader>(&is));
+	for (size_t i = 0; i < data.size(); ++i)
+		ASSERT_EQ(data[i], ad.decode(&dataModel));
+}
+
+TEST_F(TestAC, Precision64) {
+	std::ostringstream os;
+
+	AdaptiveDataModel dataModel(4);
+
+	auto ae = ArithmeticEncoder64(std::make_shared<BitStreamWriter>(&os));
+	for (auto val : simpleData) {
+		ae.encode(val, &dataModel);
+	}
+	ae.reset();
+	dataModel.reset();
+
+	std::istringstream is(os.str());
+	auto ad = ArithmeticDecoder64(std::make_shared<BitStreamReader>(&is));
+	for (size_t i = 0; i < simpleData.size(); ++i)
+		EXPECT_EQ(simpleData[i], ad.decode(&dataModel));
+}
+
+TEST_F(TestAC, Segments64) {
+	// mostly last symbols push low bound up, so 0xFF runs wait for carries
+	std::vector<unsigned> data;
+	for (int i = 0; i < 100000; ++i)
+		data.push_back(rand() % 5 == 0 ? rand() % 257 : 256 - rand() % 2);
+
+	std::ostringstream os;
+	PowerOfTwoDataModel dataModel(257, 16);
+	auto ae = ArithmeticEncoder64(std::make_shared<BitStreamWriter>(&os));
+	for (size_t i = 0; i < data.size(); ++i) {
+		ae.encode(data[i], &dataModel);
+		if (i == data.size() / 2)
+			ae.reset();
+	}
+	ae.close();
+	dataModel.reset();
+
+	std::istringstream is(os.str());
+	auto ad = ArithmeticDecoder64(std::make_shared<BitStreamReader>(&is));
+	for (size_t i = 0; i < data.size(); ++i) {
+		ASSERT_EQ(data[i], ad.decode(&dataModel)) << i;
+		if (i == data.size() / 2)
+			ad.reset();
+	}
+	EXPECT_FALSE(ad.exhausted());
+
+	// decoder notices it reads past end of truncated stream
+	dataModel.reset();
+	std::istringstream truncated(os.str().substr(0, 100));
+	ArithmeticDecoder64 truncatedDecoder(std::make_shared<BitStreamReader>(&truncated));
+	for (size_t i = 0; i < data.size() && !truncatedDecoder.exhausted(); ++i)
+		truncatedDecoder.decode(&dataModel);
+	EXPECT_TRUE(truncatedDecoder.exhausted());
+}
+
+TEST_F(TestAC, ThreeQuartersBound) {
+	// symbols and models found by search, after the fifth symbol interval high bound is
+	// exactly three quarters which encoder doesn't scale as middle interval, decoder
+	// which did decoded the last symbol wrong
+	std::vector<std::vector<unsigned> > freqs = {
+		{6, 17}, {16, 1, 16}, {20, 19, 19}, {6, 6, 17, 8}, {1, 39112, 14098},
+		{9849, 54473, 12795, 44122}, {470, 23297}, {59739, 5932},
+		{32223, 32543, 8832, 18783}, {17674, 23709, 2006, 24318}, {12522, 575, 59380, 7060}
+	};
+	std::vector<unsigned> data = {1, 0, 1, 0, 1, 2, 0, 1, 0, 3, 3};
+
+	std::ostringstream os;
+	{
+		ArithmeticEncoder encoder(std::make_shared<BitStreamWriter>(&os));
+		for (size_t i = 0; i < data.size(); ++i) {
+			StaticDataModel dataModel(freqs[i]);
+			encoder.encode(data[i], &dataModel);
+		}
+	}
+
+	std::istringstream is(os.str());
+	ArithmeticDecoder decoder(std::make_shared<BitStreamReader>(&is));
+	for (size_t i = 0; i < data.size(); ++i) {
+		StaticDataModel dataModel(freqs[i]);
+		ASSERT_EQ(data[i], decoder.decode(&dataModel)) << i;
+	}
+}
+
+TEST_F(TestAC, StaticLookup) {
+	// zero frequencies and large total so lookup buckets span several symbols
+	std::vector<unsigned> freqs(300);
+	for (size_t i = 0; i < freqs.size(); ++i)
+		freqs[i] = i % 3 == 0 ? 0 : static_cast<unsigned>(i * i * 97 + 1);
+
+	StaticDataModel dataModel(freqs);
+	AdaptiveDataModel reference(freqs);
+	auto total = dataModel.getCumulativeFreq(static_cast<unsigned>(freqs.size() - 1));
+	for (unsigned c = 0; c < total; c += 37)
+		ASSERT_EQ(reference.findSymbol(c), dataModel.findSymbol(c)) << c;
+	EXPECT_EQ(reference.findSymbol(total - 1), dataModel.findSymbol(total - 1));
+}
+
+TEST_F(TestAC, SemiAdaptiveDataModel) {
+	std::vector<unsigned> data;
+	for (int i = 0; i < 20000; ++i)
+		data.push_back(i < 10000 ? rand() % 8 : 100 + rand() % 50);
+
+	std::ostringstream os;
+	SemiAdaptiveDataModel dataModel(257, 1024);
+	auto ae = ArithmeticEncoder(std::make_shared<BitStreamWriter>(&os));
+	for (auto val : data)
+		ae.encode(val, &dataModel);
+	ae.reset();
+	dataModel.reset();
+
+	// ratio is close to fully adaptive model
+	std::ostringstream adaptive;
+	{
+		AdaptiveDataModel adaptiveModel(257);
+		ArithmeticEncoder encoder(std::make_shared<BitStreamWriter>(&adaptive));
+		for (auto val : data)
+			encoder.encode(val, &adaptiveModel);
+	}
+	EXPECT_LT(os.str().size(), adaptive.str().size() * 21 / 20);
+
+	std::istringstream is(os.str());
+	auto ad = ArithmeticDecoder(std::make_shared<BitStreamReader>(&is));
+	for (size_t i = 0; i < data.size(); ++i)
+		ASSERT_EQ(data[i], ad.decode(&dataModel));
+}
@@ -0,0 +1,45 @@
+#include <gtest/gtest.h>
+
+#include "batchio.h"
+#include "tempdir.h"
+
+#include <string>
+#include <vector>
+
+static void batchRoundTrip(IBatchFileIo* io) {
+	TempDir dir;
+	std::vector<std::string> paths, contents;
+	for (int i = 0; i < 40; ++i) {
+		paths.push_back(dir.path("batchio_test_" + std::to_string(i) + ".tmp"));
+		// sizes cross chunk boundaries of io_uring backend and include empty file
+		contents.push_back(std::string(i * 10007, static_cast<char>('a' + i % 26)));
+	}
+
+	io->writeFiles(paths, contents);
+
+	std::vector<std::string> read;
+	io->readFiles(paths, read);
+	ASSERT_EQ(contents.size(), read.size());
+	for (size_t i = 0; i < contents.size(); ++i)
+		EXPECT_EQ(contents[i], read[i]);
+}
+
+TEST(TestBatchIo, Streams) {
+	auto io = createBatchFileIo(false, 8);
+	batchRoundTrip(io.get());
+}
+
+TEST(TestBatchIo, Uring) {
+	// falls back to streams when io_uring isn't compiled in or kernel doesn't have it
+	auto io = createBatchFileIo(true, 8);
+	if (std::string(io->name()) != "io_uring")
+		GTEST_SKIP() << "io_uring isn't available, backend is " << io->name();
+	batchRoundTrip(io.get());
+}
+
+TEST(TestBatchIo, MissingFile) {
+	TempDir dir;
+	auto io = createBatchFileIo(true, 8);
+	std::vector<std::string> paths(1, dir.path("batchio_test_missing.tmp")), contents;
+	EXPECT_THROW(io->readFiles(paths, contents), std::runtime_error);
+}
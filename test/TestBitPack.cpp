@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "bitstream.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <climits>
+#include <vector>
+
+class TestBitPack : public ::testing::Test
+{
+protected:
+	/// Codes written bit by bit, same as writer did before packing
+	static std::string writeBitByBit(const std::vector<uint32_t>& codes, unsigned width, size_t offset) {
+		std::ostringstream oss;
+		{
+			BitStreamWriter writer(&oss);
+			for (size_t i = 0; i < offset; ++i)
+				writer.writeBit(true);
+			for (auto code : codes)
+				for (unsigned i = 0; i < width; ++i)
+					writer.writeBit(((code >> i) & 1) != 0);
+		}
+		return oss.str();
+	}
+
+	static std::vector<uint32_t> randomCodes(size_t count, unsigned width) {
+		std::vector<uint32_t> codes(count);
+		for (auto& code : codes)
+			code = static_cast<uint32_t>(rand()) & ((1U << width) - 1);
+		return codes;
+	}
+};
+
+TEST_F(TestBitPack, PackCodes) {
+	for (unsigned width = 1; width <= bitpack::MAX_WIDTH; ++width) {
+		for (size_t offset = 0; offset < 8; ++offset) {
+			auto codes = randomCodes(1000, width);
+
+			std::ostringstream oss;
+			{
+				BitStreamWriter writer(&oss);
+				for (size_t i = 0; i < offset; ++i)
+					writer.writeBit(true);
+				// uneven groups so SIMD and scalar tails are both used
+				for (size_t i = 0; i < codes.size(); i += 13)
+					writer.packCodes(width, codes.data() + i, std::min<size_t>(13, codes.size() - i));
+			}
+			EXPECT_EQ(writeBitByBit(codes, width, offset), oss.str()) << "width " << width;
+		}
+	}
+}
+
+TEST_F(TestBitPack, FullBufferThenBit) {
+	const unsigned width = 16;
+	// two packs fill write buffer exactly
+	auto codes = randomCodes(BitStreamWriter::BUFFER_SIZE * CHAR_BIT / width, width);
+	auto bits = randomCodes(3 * BitStreamWriter::BUFFER_SIZE * CHAR_BIT, 1);
+
+	std::ostringstream oss;
+	{
+		BitStreamWriter writer(&oss);
+		writer.packCodes(width, codes.data(), codes.size() / 2);
+		writer.packCodes(width, codes.data() + codes.size() / 2, codes.size() / 2);
+		// more bits than buffer holds, so writing past its end would show
+		for (auto bit : bits)
+			writer.writeBit(bit != 0);
+	}
+
+	std::ostringstream expected;
+	{
+		BitStreamWriter writer(&expected);
+		for (auto code : codes)
+			for (unsigned i = 0; i < width; ++i)
+				writer.writeBit(((code >> i) & 1) != 0);
+		for (auto bit : bits)
+			writer.writeBit(bit != 0);
+	}
+	EXPECT_EQ(expected.str(), oss.str());
+}
+
+TEST_F(TestBitPack, UnpackCodes) {
+	for (unsigned width = 1; width <= bitpack::MAX_WIDTH; ++width) {
+		for (size_t offset = 0; offset < 8; ++offset) {
+			auto codes = randomCodes(1000, width);
+			std::istringstream iss(writeBitByBit(codes, width, offset));
+
+			BitStreamReader reader(&iss);
+			for (size_t i = 0; i < offset; ++i) {
+				bool bit;
+				ASSERT_TRUE(reader.readBit(bit));
+			}
+
+			std::vector<uint32_t> decoded(codes.size());
+			size_t n = 0;
+			while (n < decoded.size()) {
+				size_t unpacked = reader.peekCodes(width, std::min<size_t>(17, decoded.size() - n), &decoded[n]);
+				ASSERT_GT(unpacked, 0u);
+				reader.skipBits(unpacked * width);
+				n += unpacked;
+			}
+			EXPECT_EQ(codes, decoded) << "width " << width;
+
+			// only padding of last byte remains
+			uint32_t code;
+			EXPECT_EQ(0u, reader.peekCodes(8, 1, &code));
+		}
+	}
+}
+
+TEST_F(TestBitPack, ReverseBits) {
+	std::vector<uint8_t> data(1000);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = static_cast<uint8_t>(i * 7);
+
+	bitpack::reverseBitsInBytes(data.data(), data.size());
+	for (size_t i = 0; i < data.size(); ++i) {
+		unsigned original = static_cast<uint8_t>(i * 7), reversed = 0;
+		for (unsigned b = 0; b < 8; ++b)
+			reversed |= ((original >> b) & 1) << (7 - b);
+		EXPECT_EQ(reversed, data[i]);
+	}
+}
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include "bytescan.h"
+
+#include <cstdlib>
+#include <vector>
+
+TEST(TestByteScan, RunLength) {
+	// every length and start offset, so wide kernels and their tails are both used
+	std::vector<uint8_t> data(200);
+	for (size_t start = 0; start < 40; ++start) {
+		for (size_t length = 1; length + start < data.size(); ++length) {
+			for (auto& byte : data)
+				byte = static_cast<uint8_t>(rand() % 256);
+			for (size_t i = start; i < start + length; ++i)
+				data[i] = 7;
+			data[start + length] = 8;
+			ASSERT_EQ(length, bytescan::runLength(data.data() + start, data.size() - start)) << "length " << length;
+		}
+	}
+	EXPECT_EQ(0u, bytescan::runLength(data.data(), 0));
+	EXPECT_LE(bytescan::runLength(data.data() + 10, 5), 5u);
+}
+
+TEST(TestByteScan, FindRun) {
+	const size_t probe = 64;
+	std::vector<uint8_t> data(10000);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = static_cast<uint8_t>(i % 250 + 1);
+
+	size_t length = 0;
+	EXPECT_EQ(data.size(), bytescan::findRun(data.data(), data.size(), probe, length));
+
+	// run of 2 * probe is found wherever it starts
+	for (size_t start = 1000; start < 1000 + probe; ++start) {
+		auto copy = data;
+		std::fill(copy.begin() + start, copy.begin() + start + 2 * probe, 0);
+		ASSERT_EQ(start, bytescan::findRun(copy.data(), copy.size(), probe, length));
+		EXPECT_EQ(2 * probe, length);
+	}
+
+	// run reaching end of data
+	std::fill(data.begin() + 9000, data.end(), 0xFF);
+	EXPECT_EQ(9000u, bytescan::findRun(data.data(), data.size(), probe, length));
+	EXPECT_EQ(1000u, length);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include "fdstream.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+#include <thread>
+
+#include <unistd.h>
+
+class TestFdStream : public ::testing::Test
+{
+protected:
+	void SetUp() {
+		ASSERT_EQ(0, pipe(fds));
+		data.resize(3 * FdInputBuf::BUFFER_SIZE + 12345);
+		for (auto& c : data)
+			c = static_cast<char>(rand() % 256);
+	}
+
+	void TearDown() {
+		if (fds[0] >= 0)
+			close(fds[0]);
+		if (fds[1] >= 0)
+			close(fds[1]);
+	}
+
+	void closeEnd(int i) {
+		close(fds[i]);
+		fds[i] = -1;
+	}
+
+	int fds[2];
+	std::string data;
+};
+
+TEST_F(TestFdStream, ShortReads) {
+	// writer trickles data, so reads return less than requested
+	std::thread writer([this] () {
+		size_t chunk = 1;
+		for (size_t pos = 0; pos < data.size(); pos += chunk, chunk = chunk * 3 + 1) {
+			auto size = std::min(chunk, data.size() - pos);
+			EXPECT_EQ(static_cast<ssize_t>(size), write(fds[1], data.data() + pos, size));
+			if (pos < 1000)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		closeEnd(1);
+	});
+
+	FdInputBuf buffer(fds[0]);
+	std::istream in(&buffer);
+	std::string read(data.size(), '\0');
+	read[0] = static_cast<char>(in.get());
+	ASSERT_TRUE(in.read(&read[1], 100));
+	// read larger than buffer goes directly to caller memory
+	ASSERT_TRUE(in.read(&read[101], static_cast<std::streamsize>(read.size() - 101)));
+	writer.join();
+
+	EXPECT_EQ(data, read);
+	EXPECT_EQ(std::char_traits<char>::eof(), in.get());
+	EXPECT_TRUE(in.eof());
+}
+
+TEST_F(TestFdStream, Write) {
+	std::string read;
+	std::thread reader([this, &read] () {
+		char chunk[4096];
+		ssize_t n;
+		while ((n = ::read(fds[0], chunk, sizeof(chunk))) > 0)
+			read.append(chunk, static_cast<size_t>(n));
+	});
+
+	{
+		FdOutputBuf buffer(fds[1]);
+		std::ostream out(&buffer);
+		out.put(data[0]);
+		out.write(&data[1], 100);
+		// write larger than buffer bypasses it after buffered bytes are written
+		out.write(&data[101], static_cast<std::streamsize>(data.size() - 1101));
+		out.write(&data[data.size() - 1000], 1000);
+		EXPECT_TRUE(out.flush());
+	}
+	closeEnd(1);
+	reader.join();
+
+	EXPECT_EQ(data, read);
+}
+
+TEST_F(TestFdStream, WriteError) {
+	closeEnd(0);
+	// reader is gone, so write fails instead of blocking
+	signal(SIGPIPE, SIG_IGN);
+	FdOutputBuf buffer(fds[1]);
+	std::ostream out(&buffer);
+	out.write(data.data(), static_cast<std::streamsize>(data.size()));
+	EXPECT_FALSE(out);
+}
+
+TEST_F(TestFdStream, ReadError) {
+	// write end of pipe can't be read, so read fails instead of reaching end
+	FdInputBuf buffer(fds[1]);
+	std::istream in(&buffer);
+	char c;
+	EXPECT_FALSE(in.read(&c, 1));
+	EXPECT_TRUE(in.bad());
+	EXPECT_THROW(buffer.sgetc(), std::runtime_error);
+}
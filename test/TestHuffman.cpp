@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "huffman.h"
+#include "lzwblock.h"
+
+#include <sstream>
+#include <cstdlib>
+
+class TestHuffman : public ::testing::Test
+{
+protected:
+	/// Codes symbols with code built from their frequencies and decodes them back
+	static std::vector<uint32_t> roundTrip(const std::vector<uint32_t>& symbols, size_t numSymbols) {
+		std::vector<uint32_t> freqs(numSymbols);
+		for (auto symbol : symbols)
+			freqs[symbol]++;
+		HuffmanCode code(HuffmanCode::buildLengths(freqs));
+
+		std::ostringstream oss;
+		{
+			BitStreamWriter writer(&oss);
+			code.writeLengths(writer);
+			for (auto symbol : symbols)
+				code.write(writer, symbol);
+		}
+
+		std::istringstream iss(oss.str());
+		BitStreamReader reader(&iss);
+		std::vector<uint8_t> lengths;
+		EXPECT_TRUE(HuffmanCode::readLengths(reader, lengths));
+		HuffmanDecoder decoder(lengths);
+
+		std::vector<uint32_t> decoded;
+		uint32_t buffer[2];
+		while (decoded.size() < symbols.size()) {
+			size_t n = decoder.decode(reader, buffer, symbols.size() - decoded.size());
+			if (n == 0)
+				break;
+			decoded.insert(decoded.end(), buffer, buffer + n);
+		}
+		return decoded;
+	}
+};
+
+TEST_F(TestHuffman, SkewedSymbols) {
+	// short codes resolved two per lookup together with long ones
+	std::vector<uint32_t> symbols;
+	for (int i = 0; i < 100000; ++i)
+		symbols.push_back(rand() % 4 == 0 ? rand() % 60000 : rand() % 3);
+	EXPECT_EQ(symbols, roundTrip(symbols, 65536));
+}
+
+TEST_F(TestHuffman, LengthLimit) {
+	// fibonacci frequencies give longest possible codes without limit
+	std::vector<uint32_t> freqs(40);
+	freqs[0] = freqs[1] = 1;
+	for (size_t i = 2; i < freqs.size(); ++i)
+		freqs[i] = freqs[i - 1] + freqs[i - 2];
+
+	auto lengths = HuffmanCode::buildLengths(freqs);
+	for (auto length : lengths) {
+		EXPECT_GT(length, 0);
+		EXPECT_LE(length, HuffmanCode::MAX_LENGTH);
+	}
+	EXPECT_NO_THROW(HuffmanCode code(lengths));
+}
+
+TEST_F(TestHuffman, SingleSymbol) {
+	std::vector<uint32_t> symbols(1000, 7);
+	EXPECT_EQ(symbols, roundTrip(symbols, 8));
+}
+
+TEST_F(TestHuffman, InvalidLengths) {
+	std::vector<uint8_t> lengths(3, 1);
+	EXPECT_THROW(HuffmanDecoder decoder(lengths), std::runtime_error);
+}
+
+TEST_F(TestHuffman, LargeSymbols) {
+	// symbols above 16 bits with short codes are resolved by lookup table,
+	// code lengths header has room for 2^17 - 1 symbols
+	std::vector<uint32_t> symbols;
+	for (int i = 0; i < 20000; ++i)
+		symbols.push_back(rand() % 2 == 0 ? 131070 - rand() % 3 : rand() % 131071);
+	EXPECT_EQ(symbols, roundTrip(symbols, 131071));
+}
+
+TEST_F(TestHuffman, MalformedLzwCodeLengths) {
+	// lengths of more symbols than LZW Huffman coding has, last one would have huge extra bits
+	std::vector<uint8_t> lengths(5000);
+	lengths[0] = lengths[4999] = 1;
+	HuffmanCode code(lengths);
+
+	std::ostringstream oss;
+	{
+		BitStreamWriter writer(&oss);
+		code.writeLengths(writer);
+		for (int i = 0; i < 100; ++i)
+			code.write(writer, 4999);
+	}
+
+	std::istringstream iss(oss.str());
+	auto reader = createCodeReader(LZW_METHOD_HUFFMAN, &iss);
+	ICodeReader::code_type codes[16];
+	EXPECT_THROW(reader->readCodes(codes, 16), std::runtime_error);
+}
+
+TEST_F(TestHuffman, LzwDistanceBeforeFirstCode) {
+	// code lengths are valid, but longest distance points before first dictionary code
+	std::vector<uint8_t> lengths(466);
+	lengths[0] = lengths[465] = 1;
+	HuffmanCode code(lengths);
+
+	std::ostringstream oss;
+	{
+		BitStreamWriter writer(&oss);
+		code.writeLengths(writer);
+		for (int i = 0; i < 100; ++i)
+			code.write(writer, 465);
+	}
+
+	std::istringstream iss(oss.str());
+	auto reader = createCodeReader(LZW_METHOD_HUFFMAN, &iss);
+	ICodeReader::code_type codes[16];
+	EXPECT_THROW(reader->readCodes(codes, 16), std::runtime_error);
+}
@@ -73,11 +73,47 @@ TEST_F(TestLzw, VariableDictReset) {
 	EXPECT_EQ(simpleTestStr, resultStr);
 }
 
+TEST_F(TestLzw, VariableCodeLengthJump) {
+	// short codes only, then code several bits longer than all codes before
+	std::vector<ICodeWriter::code_type> codes = {5, 300, 7, 2000, 40000, 9};
+	std::ostringstream oss;
+	{
+		VariableCodeWriter writer(&oss);
+		for (auto code : codes)
+			writer.writeCode(code);
+	}
+
+	std::istringstream iss(oss.str());
+	VariableCodeReader reader(&iss);
+	for (auto code : codes) {
+		ICodeReader::code_type read;
+		ASSERT_TRUE(reader.readNextCode(read));
+		EXPECT_EQ(code, read);
+	}
+}
+
 TEST_F(TestLzw, ArithmeticSimple) {
 	auto resultStr = lzwTest<ArithmeticCodeReader, ArithmeticCodeWriter>(simpleTestStr);
 	EXPECT_EQ(simpleTestStr, resultStr);
 }
 
+TEST_F(TestLzw, ArithmeticStopsAtEnd) {
+	std::ostringstream oss;
+	{
+		LzwEncoder encoder(std::make_shared<ArithmeticCodeWriter>(&oss));
+		for (auto c : simpleTestStr)
+			encoder.encode(c);
+		encoder.flush();
+	}
+	// more codes follow end, reader asked for next batch must not decode them
+	auto coded = oss.str();
+	std::istringstream iss(coded + coded);
+	LzwDecoder decoder(std::make_shared<ArithmeticCodeReader>(&iss));
+	std::ostringstream result;
+	decoder.decode(result);
+	EXPECT_EQ(simpleTestStr, result.str());
+}
+
 TEST_F(TestLzw, VariableLong) {
 	auto resultStr = lzwTest<VariableCodeReader, VariableCodeWriter>(longTestStr);
 	EXPECT_EQ(longTestStr, resultStr);
@@ -86,4 +122,62 @@ TEST_F(TestLzw, VariableLong) {
 TEST_F(TestLzw, ArithmeticLong) {
 	auto resultStr = lzwTest<ArithmeticCodeReader, ArithmeticCodeWriter>(longTestStr);
 	EXPECT_EQ(longTestStr, resultStr);
-}
\ No newline at end of file
+}
+TEST_F(TestLzw, ParallelDecode) {
+	// repeats make long strings, memory limit resets dictionary
+	std::string input;
+	while (input.size() < 8 * LzwDecoder::PARALLEL_CHUNK)
+		input += longTestStr.substr(rand() % 1000, 5000) + std::string(rand() % 3000, 'x') + simpleTestStr;
+
+	ThreadPool pool(4);
+	for (auto limit : { MemoryBudget::UNLIMITED, MemoryBudget::MIN_LZW_LIMIT }) {
+		std::ostringstream oss;
+		{
+			LzwEncoder encoder(std::make_shared<VariableCodeWriter>(&oss), limit);
+			for (auto c : input)
+				encoder.encode(static_cast<unsigned char>(c));
+		}
+
+		std::istringstream iss(oss.str());
+		LzwDecoder decoder(std::make_shared<VariableCodeReader>(&iss), limit);
+		std::ostringstream result;
+		decoder.decode(result, pool);
+		EXPECT_EQ(input, result.str());
+
+		// dictionary is parsed again from start after reset
+		std::istringstream again(oss.str());
+		decoder.reset(std::make_shared<VariableCodeReader>(&again));
+		std::ostringstream resultAgain;
+		decoder.decode(resultAgain, pool);
+		EXPECT_EQ(input, resultAgain.str());
+
+		// decoder with smaller limit refuses stream as serial one does
+		if (limit == MemoryBudget::UNLIMITED) {
+			std::istringstream limited(oss.str());
+			LzwDecoder limitedDecoder(std::make_shared<VariableCodeReader>(&limited), MemoryBudget::MIN_LZW_LIMIT);
+			std::ostringstream limitedResult;
+			EXPECT_THROW(limitedDecoder.decode(limitedResult, pool), std::runtime_error);
+		}
+	}
+}
+
+TEST_F(TestLzw, ParallelDecodeLong) {
+	// several windows, dictionary of reset before window end is dropped
+	std::string input;
+	while (input.size() < 3 * LzwDecoder::PARALLEL_WINDOW)
+		input += longTestStr.substr(rand() % 1000, 5000) + std::string(rand() % 3000, 'x') + simpleTestStr;
+
+	std::ostringstream oss;
+	{
+		LzwEncoder encoder(std::make_shared<HuffmanCodeWriter>(&oss), MemoryBudget::MIN_LZW_LIMIT);
+		for (auto c : input)
+			encoder.encode(static_cast<unsigned char>(c));
+	}
+
+	ThreadPool pool(4);
+	std::istringstream iss(oss.str());
+	LzwDecoder decoder(std::make_shared<HuffmanCodeReader>(&iss), MemoryBudget::MIN_LZW_LIMIT);
+	std::ostringstream result;
+	decoder.decode(result, pool);
+	EXPECT_EQ(input, result.str());
+}
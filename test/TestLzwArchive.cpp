@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include "lzwarchive.h"
+#include "tempdir.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <memory>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#define chdir _chdir
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+class TestLzwArchive : public ::testing::Test
+{
+protected:
+	static const std::string inputDir;
+	static const std::string outputDir;
+	static const std::string archivePath;
+
+	void SetUp() {
+		// archive stores relative paths, so test runs in its own directory
+		char cwd[4096];
+		ASSERT_NE(nullptr, getcwd(cwd, sizeof(cwd)));
+		previousDir = cwd;
+		dir.reset(new TempDir());
+		ASSERT_EQ(0, chdir(dir->path().c_str()));
+
+		mkdir(inputDir.c_str(), 0777);
+		mkdir((inputDir + "/sub").c_str(), 0777);
+
+		std::string text;
+		while (text.size() < 50000)
+			text += "archived line " + std::to_string(rand() % 100) + "\n";
+		files.clear();
+		files.push_back(std::make_pair(inputDir + "/a.txt", text));
+		files.push_back(std::make_pair(inputDir + "/empty", std::string()));
+		// more parts than one, mostly run so it's coded fast
+		files.push_back(std::make_pair(inputDir + "/sub/large", text + std::string(2 * LzwArchive::PART_SIZE, 'x')));
+		for (auto& file : files)
+			writeFile(file.first, file.second);
+	}
+
+	void TearDown() {
+		if (!previousDir.empty() && chdir(previousDir.c_str()) != 0)
+			ADD_FAILURE() << "unable to return to " << previousDir;
+		dir.reset();
+	}
+
+	static void writeFile(const std::string& path, const std::string& content) {
+		std::ofstream out(path.c_str(), std::ios_base::binary);
+		out.write(content.data(), content.size());
+	}
+
+	static std::string readFile(const std::string& path) {
+		std::ifstream in(path.c_str(), std::ios_base::binary);
+		std::ostringstream content;
+		content << in.rdbuf();
+		return content.str();
+	}
+
+	std::unique_ptr<TempDir> dir;
+	std::string previousDir;
+	std::vector<std::pair<std::string, std::string> > files;
+};
+
+const std::string TestLzwArchive::inputDir = "lzwarchive_test_in";
+const std::string TestLzwArchive::outputDir = "lzwarchive_test_out";
+const std::string TestLzwArchive::archivePath = "lzwarchive_test.lza";
+
+TEST_F(TestLzwArchive, RoundTrip) {
+	ThreadPool pool(4);
+	LzwArchive::create(archivePath, std::vector<std::string>(1, "./" + inputDir + "/"), LZW_METHOD_HUFFMAN, pool);
+	LzwArchive::extract(archivePath, outputDir, pool);
+
+	for (auto& file : files)
+		EXPECT_EQ(file.second, readFile(outputDir + "/" + file.first)) << file.first;
+}
+
+TEST_F(TestLzwArchive, List) {
+	ThreadPool pool(2);
+	LzwArchive::create(archivePath, std::vector<std::string>(1, inputDir), LZW_METHOD_VARIABLE, pool);
+
+	auto entries = LzwArchive::readIndex(archivePath);
+	ASSERT_EQ(files.size(), entries.size());
+	// directory is walked in sorted order
+	for (size_t i = 0; i < files.size(); ++i) {
+		EXPECT_EQ(files[i].first, entries[i].path);
+		EXPECT_EQ(files[i].second.size(), entries[i].size);
+
+		uint64_t rawSize = 0;
+		for (auto& part : entries[i].parts)
+			rawSize += part.rawSize;
+		EXPECT_EQ(entries[i].size, rawSize);
+	}
+	EXPECT_EQ(3u, entries[2].parts.size());
+}
+
+TEST_F(TestLzwArchive, MemoryLimit) {
+	ThreadPool pool(2);
+	LzwArchive::create(archivePath, std::vector<std::string>(1, inputDir), LZW_METHOD_VARIABLE, pool);
+	// unlimited dictionary of large part grows over limit
+	EXPECT_THROW(LzwArchive::extract(archivePath, outputDir, pool, 1 << 10), std::runtime_error);
+
+	LzwArchive::create(archivePath, std::vector<std::string>(1, inputDir), LZW_METHOD_VARIABLE, pool, 1 << 20);
+	LzwArchive::extract(archivePath, outputDir, pool, 1 << 20);
+	for (auto& file : files)
+		EXPECT_EQ(file.second, readFile(outputDir + "/" + file.first)) << file.first;
+}
+
+TEST_F(TestLzwArchive, InvalidPaths) {
+	ThreadPool pool(2);
+	// such paths couldn't be extracted, so they aren't archived
+	EXPECT_THROW(LzwArchive::create(archivePath, std::vector<std::string>(1, inputDir + "/../" + inputDir),
+		LZW_METHOD_VARIABLE, pool), std::runtime_error);
+	EXPECT_THROW(LzwArchive::create(archivePath, std::vector<std::string>(1, "../x"),
+		LZW_METHOD_VARIABLE, pool), std::runtime_error);
+}
+
+TEST_F(TestLzwArchive, MalformedIndex) {
+	ThreadPool pool(2);
+	LzwArchive::create(archivePath, std::vector<std::string>(1, inputDir + "/a.txt"), LZW_METHOD_VARIABLE, pool);
+	auto archive = readFile(archivePath);
+
+	// index is entry count, path length, path, size, part count and one part
+	auto indexOffset = archive.size() - 12 - (4 + 2 + files[0].first.size() + 8 + 4 + 24);
+	auto corrupt = [&] (size_t offset, const std::string& bytes) {
+		auto broken = archive;
+		broken.replace(offset, bytes.size(), bytes);
+		writeFile(archivePath, broken);
+		EXPECT_THROW(LzwArchive::readIndex(archivePath), std::runtime_error) << offset;
+	};
+
+	// huge entry count
+	corrupt(indexOffset, std::string(4, '\xFF'));
+	// huge part count
+	corrupt(indexOffset + 4 + 2 + files[0].first.size() + 8, std::string(4, '\xFF'));
+	// part stored size past index
+	corrupt(indexOffset + 4 + 2 + files[0].first.size() + 8 + 4 + 8, std::string(8, '\xFF'));
+	// index offset past trailer
+	corrupt(archive.size() - 12, std::string(8, '\xFF'));
+	// missing index mark
+	corrupt(archive.size() - 4, "XXXX");
+
+	writeFile(archivePath, archive.substr(0, 3));
+	EXPECT_THROW(LzwArchive::readIndex(archivePath), std::runtime_error);
+
+	writeFile(archivePath, archive);
+	EXPECT_EQ(1u, LzwArchive::readIndex(archivePath).size());
+}
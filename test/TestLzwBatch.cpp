@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include "lzwbatch.h"
+
+#include <sstream>
+#include <cstdlib>
+
+class TestLzwBatch : public ::testing::Test
+{
+protected:
+	void SetUp() {
+		records.clear();
+		for (int i = 0; i < 64; ++i) {
+			std::string record;
+			size_t size = 1024 + static_cast<size_t>(rand()) % (16 * 1024);
+			while (record.size() < size)
+				record += "record " + std::to_string(i) + " line " + std::to_string(rand() % 50) + "\n";
+			// every fourth record is incompressible, so it is stored
+			if (i % 4 == 3) {
+				for (auto& c : record)
+					c = static_cast<char>(rand() % 256);
+			}
+			records.push_back(record);
+		}
+		records.push_back(std::string());
+	}
+
+	static std::vector<LzwInputSpan> inputSpans(const std::vector<std::string>& data) {
+		std::vector<LzwInputSpan> spans;
+		for (auto& item : data)
+			spans.push_back(LzwInputSpan{item.data(), item.size()});
+		return spans;
+	}
+
+	static std::vector<LzwOutputSpan> outputSpans(std::vector<std::string>& data) {
+		std::vector<LzwOutputSpan> spans;
+		for (auto& item : data)
+			spans.push_back(LzwOutputSpan{&item[0], item.size()});
+		return spans;
+	}
+
+	std::vector<std::string> records;
+};
+
+TEST_F(TestLzwBatch, RoundTrip) {
+	ThreadPool pool(4);
+	for (auto method : {LZW_METHOD_VARIABLE, LZW_METHOD_HUFFMAN, LZW_METHOD_ARITHMETIC_POW2}) {
+		LzwBatchCodec codec(pool, method);
+
+		std::vector<std::string> compressed;
+		for (auto& record : records)
+			compressed.push_back(std::string(LzwBatchCodec::compressBound(record.size()), '\0'));
+		auto results = codec.compress(inputSpans(records), outputSpans(compressed));
+		ASSERT_EQ(records.size(), results.size());
+		for (size_t i = 0; i < results.size(); ++i) {
+			ASSERT_TRUE(results[i].ok) << results[i].error;
+			compressed[i].resize(results[i].size);
+		}
+
+		std::vector<std::string> decompressed;
+		for (auto& record : records)
+			decompressed.push_back(std::string(record.size(), '\0'));
+		results = codec.decompress(inputSpans(compressed), outputSpans(decompressed));
+		for (size_t i = 0; i < results.size(); ++i) {
+			ASSERT_TRUE(results[i].ok) << results[i].error;
+			EXPECT_EQ(records[i].size(), results[i].size);
+		}
+		EXPECT_EQ(records, decompressed);
+
+		// records are ordinary block streams
+		std::istringstream iss(compressed[0]);
+		std::ostringstream oss;
+		decompressLzwStream(iss, oss);
+		EXPECT_EQ(records[0], oss.str());
+	}
+}
+
+TEST_F(TestLzwBatch, SmallOutputSpan) {
+	ThreadPool pool(2);
+	LzwBatchCodec codec(pool);
+
+	std::vector<std::string> compressed(records.size());
+	for (size_t i = 0; i < records.size(); ++i)
+		compressed[i].resize(i % 2 == 0 ? 8 : LzwBatchCodec::compressBound(records[i].size()));
+	auto results = codec.compress(inputSpans(records), outputSpans(compressed));
+	for (size_t i = 0; i + 1 < results.size(); ++i) {
+		EXPECT_EQ(i % 2 != 0, results[i].ok) << i;
+		compressed[i].resize(results[i].ok ? results[i].size : 0);
+	}
+
+	// failed records don't affect next records of the same context
+	std::vector<std::string> decompressed;
+	for (size_t i = 0; i < records.size(); ++i)
+		decompressed.push_back(std::string(i % 3 == 0 ? records[i].size() / 2 : records[i].size(), '\0'));
+	results = codec.decompress(inputSpans(compressed), outputSpans(decompressed));
+	for (size_t i = 1; i + 1 < results.size(); i += 2) {
+		if (i % 3 == 0) {
+			EXPECT_FALSE(results[i].ok) << i;
+		} else {
+			ASSERT_TRUE(results[i].ok) << results[i].error;
+			EXPECT_EQ(records[i], decompressed[i]);
+		}
+	}
+	// empty input isn't block stream
+	EXPECT_FALSE(results[0].ok);
+}
@@ -0,0 +1,601 @@
+#include <gtest/gtest.h>
+
+#include "lzwblock.h"
+#include "fdstream.h"
+#include "tempdir.h"
+
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <vector>
+
+class TestLzwBlock : public ::testing::Test
+{
+protected:
+	void SetUp() {
+		textStr.clear();
+		for (int i = 0; i < 2000; ++i)
+			textStr += "Lorem ipsum dolor sit amet, consectetur adipisici elit. ";
+
+		randomStr.clear();
+		for (int i = 0; i < 100000; ++i)
+			randomStr += static_cast<char>(rand() % 256);
+	}
+
+	std::string textStr;
+	std::string randomStr;
+
+	static std::string compress(const std::string& str, LzwMethod method, size_t blockSize) {
+		std::ostringstream oss;
+		LzwBlockWriter writer(&oss, method, blockSize);
+		writer.write(str.data(), str.size());
+		writer.close();
+		return oss.str();
+	}
+
+	static std::string decompress(const std::string& str) {
+		std::istringstream iss(str);
+		std::ostringstream result;
+		decompressLzwStream(iss, result);
+		return result.str();
+	}
+};
+
+TEST_F(TestLzwBlock, Variable) {
+	auto compressed = compress(textStr, LZW_METHOD_VARIABLE, 10000);
+	EXPECT_LT(compressed.size(), textStr.size());
+	EXPECT_EQ(textStr, decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, Arithmetic) {
+	auto compressed = compress(textStr, LZW_METHOD_ARITHMETIC, 50000);
+	EXPECT_LT(compressed.size(), textStr.size());
+	EXPECT_EQ(textStr, decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, ArithmeticPowerOfTwo) {
+	auto compressed = compress(textStr, LZW_METHOD_ARITHMETIC_POW2, 50000);
+	EXPECT_LT(compressed.size(), textStr.size());
+	EXPECT_EQ(textStr, decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, Arithmetic64) {
+	for (auto method : { LZW_METHOD_ARITHMETIC_64, LZW_METHOD_ARITHMETIC_POW2_64 }) {
+		auto compressed = compress(textStr, method, 50000);
+		EXPECT_LT(compressed.size(), textStr.size());
+		EXPECT_EQ(textStr, decompress(compressed));
+	}
+}
+
+TEST_F(TestLzwBlock, Huffman) {
+	auto compressed = compress(textStr, LZW_METHOD_HUFFMAN, 50000);
+	EXPECT_LT(compressed.size(), textStr.size());
+	EXPECT_EQ(textStr, decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, BitTree) {
+	auto compressed = compress(textStr, LZW_METHOD_BITTREE, 50000);
+	EXPECT_LT(compressed.size(), textStr.size());
+	EXPECT_EQ(textStr, decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, MemoryLimit) {
+	// long repeats make long dictionary strings, runs of one byte would be written as runs
+	std::string repetitive;
+	while (repetitive.size() < 500000)
+		repetitive += "ab";
+	for (size_t i = 0; i < repetitive.size(); i += 1000)
+		repetitive[i] = static_cast<char>('b' + i % 7);
+
+	const size_t limit = 1 << 17;
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE, LzwBlockWriter::DEFAULT_BLOCK_SIZE, limit);
+	writer.write(repetitive.data(), repetitive.size());
+	writer.close();
+	EXPECT_LE(writer.peakMemory(), limit);
+
+	std::ostringstream unlimited;
+	LzwBlockWriter unlimitedWriter(&unlimited, LZW_METHOD_VARIABLE);
+	unlimitedWriter.write(repetitive.data(), repetitive.size());
+	unlimitedWriter.close();
+	EXPECT_GT(unlimitedWriter.peakMemory(), limit);
+
+	// decoder with the same limit decodes stream, it refuses stream coded without limit
+	std::istringstream iss(oss.str());
+	std::ostringstream decoded;
+	EXPECT_LE(decompressLzwStream(iss, decoded, limit), limit);
+	EXPECT_EQ(repetitive, decoded.str());
+
+	std::istringstream unlimitedIss(unlimited.str());
+	std::ostringstream unlimitedDecoded;
+	EXPECT_THROW(decompressLzwStream(unlimitedIss, unlimitedDecoded, limit), std::runtime_error);
+}
+
+TEST_F(TestLzwBlock, StoredIncompressible) {
+	const size_t blockSize = 40000;
+	auto compressed = compress(randomStr, LZW_METHOD_VARIABLE, blockSize);
+
+	// every block stored, overhead is only headers
+	size_t numBlocks = (randomStr.size() + blockSize - 1) / blockSize;
+	EXPECT_LE(compressed.size(), randomStr.size() + 4 + numBlocks * 10 + 1);
+	EXPECT_EQ(randomStr, decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, Empty) {
+	auto compressed = compress("", LZW_METHOD_VARIABLE, 1000);
+	EXPECT_EQ("", decompress(compressed));
+}
+
+TEST_F(TestLzwBlock, LegacyStream) {
+	std::ostringstream oss;
+	oss.write("LZW\x00", 4);
+	{
+		LzwEncoder encoder(createCodeWriter(LZW_METHOD_VARIABLE, &oss));
+		for (auto c : textStr)
+			encoder.encode(static_cast<unsigned char>(c));
+		encoder.flush();
+	}
+
+	EXPECT_EQ(textStr, decompress(oss.str()));
+}
+
+TEST_F(TestLzwBlock, Dedup) {
+	// repeated data is shifted against block boundaries, chunking finds it anyway
+	std::string random(300000, '\0');
+	for (auto& c : random)
+		c = static_cast<char>(rand() % 256);
+	auto input = random + textStr + std::string(17, 'x') + random;
+
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE, 100000);
+	writer.setDedupWindow(1 << 20);
+	writer.write(input.data(), input.size());
+	writer.close();
+
+	// most of second copy is replaced by references, chunks cut by shifted boundary are coded again
+	EXPECT_LT(oss.str().size() + random.size() / 2, compress(input, LZW_METHOD_VARIABLE, 100000).size());
+	EXPECT_EQ(input, decompress(oss.str()));
+
+	// reader needs whole window
+	std::istringstream iss(oss.str());
+	std::ostringstream decoded;
+	EXPECT_THROW(decompressLzwStream(iss, decoded, 1 << 17), std::runtime_error);
+}
+
+TEST_F(TestLzwBlock, DedupWindow) {
+	std::string random(200000, '\0');
+	for (auto& c : random)
+		c = static_cast<char>(rand() % 256);
+	auto input = random + random;
+
+	// first copy is out of window when second one comes
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_HUFFMAN, 50000);
+	writer.setDedupWindow(100000);
+	writer.write(input.data(), input.size());
+	writer.close();
+
+	EXPECT_GT(oss.str().size(), input.size());
+	EXPECT_EQ(input, decompress(oss.str()));
+}
+
+TEST_F(TestLzwBlock, DedupMemoryLimit) {
+	std::string random(400000, '\0');
+	for (auto& c : random)
+		c = static_cast<char>(rand() % 256);
+	auto input = random + random;
+
+	// window is cut to memory limit, so reader with the same limit decodes stream
+	const size_t limit = 1 << 18;
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE, 100000, limit);
+	writer.setDedupWindow(256 << 20);
+	writer.write(input.data(), input.size());
+	writer.close();
+
+	std::istringstream iss(oss.str());
+	std::ostringstream decoded;
+	LzwBlockReader reader(&iss, limit);
+	ASSERT_EQ(LZW_VERSION_BLOCKS, readLzwStreamHeader(iss));
+	reader.decode(decoded);
+	EXPECT_EQ(input, decoded.str());
+
+	// window and dictionary share one limit, peak counts both
+	const size_t window = limit - MemoryBudget::MIN_LZW_LIMIT;
+	EXPECT_GE(writer.peakMemory(), window - ContentChunker::MAX_CHUNK);
+	EXPECT_LE(writer.peakMemory(), limit);
+	EXPECT_GE(reader.peakMemory(), window - ContentChunker::MAX_CHUNK);
+	EXPECT_LE(reader.peakMemory(), limit);
+
+	// limit without room for window besides dictionary disables deduplication
+	const size_t smallLimit = MemoryBudget::MIN_LZW_LIMIT;
+	std::ostringstream small;
+	LzwBlockWriter smallWriter(&small, LZW_METHOD_VARIABLE, 100000, smallLimit);
+	smallWriter.setDedupWindow(1 << 20);
+	smallWriter.write(textStr.data(), textStr.size());
+	smallWriter.close();
+	EXPECT_EQ(textStr, decompress(small.str()));
+	EXPECT_LE(smallWriter.peakMemory(), smallLimit);
+}
+
+TEST_F(TestLzwBlock, Append) {
+	const size_t blockSize = 30000;
+	auto first = textStr + randomStr.substr(0, 20000);
+	auto second = randomStr.substr(20000) + textStr;
+
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_HUFFMAN, blockSize);
+	writer.setCheckpoint(true);
+	writer.write(first.data(), first.size());
+	writer.close();
+	EXPECT_EQ(first, decompress(oss.str()));
+
+	// full blocks stay, only last one is read again
+	std::istringstream iss(oss.str());
+	auto checkpoint = LzwCheckpoint::read(iss);
+	EXPECT_EQ(LZW_METHOD_HUFFMAN, checkpoint.method);
+	EXPECT_EQ(blockSize, checkpoint.blockSize);
+	auto lastBlock = checkpoint.readLastBlock(iss);
+	EXPECT_EQ(first.size() % blockSize, lastBlock.size());
+	EXPECT_EQ(first.substr(first.size() - lastBlock.size()), lastBlock);
+
+	std::ostringstream appended;
+	appended << oss.str().substr(0, static_cast<size_t>(checkpoint.resumeOffset()));
+	LzwBlockWriter appender(&appended, checkpoint);
+	appender.write(lastBlock.data(), lastBlock.size());
+	appender.write(second.data(), second.size());
+	appender.close();
+	EXPECT_EQ(first + second, decompress(appended.str()));
+
+	// stream can be continued again
+	std::istringstream appendedIss(appended.str());
+	EXPECT_NO_THROW(LzwCheckpoint::read(appendedIss));
+
+	// stream written without checkpoint can't be continued
+	std::istringstream plain(compress(textStr, LZW_METHOD_VARIABLE, blockSize));
+	EXPECT_THROW(LzwCheckpoint::read(plain), std::runtime_error);
+}
+
+TEST_F(TestLzwBlock, SyncFlush) {
+	// small messages like on interactive connection, with memory limit dictionary resets too
+	std::vector<std::string> messages;
+	for (size_t i = 0; i < 300; ++i)
+		messages.push_back(textStr.substr(i * 37 % 1000, 50 + i % 200) + randomStr.substr(i, i % 3));
+
+	for (auto method : { LZW_METHOD_VARIABLE, LZW_METHOD_ARITHMETIC_POW2, LZW_METHOD_ARITHMETIC_POW2_64,
+			LZW_METHOD_HUFFMAN, LZW_METHOD_BITTREE, LZW_METHOD_AUTO }) {
+		for (auto limit : { MemoryBudget::UNLIMITED, MemoryBudget::MIN_LZW_LIMIT }) {
+			std::ostringstream oss;
+			LzwBlockWriter writer(&oss, method, 10000, limit);
+			std::istringstream iss;
+			LzwBlockReader reader(&iss, limit);
+			std::string written;
+			size_t position = 4;
+			for (auto& message : messages) {
+				writer.write(message.data(), message.size());
+				writer.flush();
+				written += message;
+
+				// everything written so far is decoded from flushed part of stream
+				iss.str(oss.str());
+				iss.clear();
+				iss.seekg(static_cast<std::streamoff>(position));
+				std::ostringstream decoded;
+				while (static_cast<size_t>(iss.tellg()) < oss.str().size())
+					ASSERT_TRUE(reader.decodeBlock(decoded));
+				position = oss.str().size();
+				ASSERT_EQ(message, decoded.str()) << "method " << method;
+			}
+			writer.close();
+			EXPECT_EQ(written, decompress(oss.str())) << "method " << method;
+
+			// dictionary is kept, so flushed stream is close to one coded without flushes
+			if (limit == MemoryBudget::UNLIMITED && method != LZW_METHOD_AUTO && method != LZW_METHOD_HUFFMAN) {
+				EXPECT_LT(oss.str().size(), compress(written, method, 10000).size() * 2) << "method " << method;
+			}
+		}
+	}
+}
+
+TEST_F(TestLzwBlock, SyncFlushDedup) {
+	// counts flushes of reader's output
+	struct FlushCountingBuf : std::stringbuf {
+		FlushCountingBuf() : flushes(0) { }
+		virtual int sync() {
+			flushes++;
+			return 0;
+		}
+		unsigned flushes;
+	} decodedBuf;
+	std::ostream decoded(&decodedBuf);
+
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE, 100000);
+	writer.setDedupWindow(1 << 20);
+	std::istringstream iss;
+	LzwBlockReader reader(&iss);
+	size_t position = 4;
+	std::string written;
+	for (size_t i = 0; i < 20; ++i) {
+		// repeated messages are replaced by references
+		auto message = textStr.substr(i % 4 * 100, 3000);
+		writer.write(message.data(), message.size());
+		writer.flush();
+		written += message;
+
+		// flushed dedup block is decoded whole and flushed to output
+		iss.str(oss.str());
+		iss.clear();
+		iss.seekg(static_cast<std::streamoff>(position));
+		auto flushes = decodedBuf.flushes;
+		while (static_cast<size_t>(iss.tellg()) < oss.str().size())
+			ASSERT_TRUE(reader.decodeBlock(decoded));
+		position = oss.str().size();
+		EXPECT_EQ(written, decodedBuf.str());
+		EXPECT_GT(decodedBuf.flushes, flushes);
+	}
+	writer.close();
+	EXPECT_EQ(written, decompress(oss.str()));
+}
+
+TEST_F(TestLzwBlock, Concat) {
+	const size_t blockSize = 30000;
+	auto first = compress(textStr, LZW_METHOD_VARIABLE, blockSize);
+
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_HUFFMAN, blockSize);
+	writer.setCheckpoint(true);
+	writer.setDedupWindow(1 << 20);
+	writer.write(randomStr.data(), randomStr.size());
+	writer.close();
+	auto second = oss.str();
+
+	std::ostringstream joined;
+	std::istringstream firstIss(first), secondIss(second);
+	auto offset = appendLzwMember(firstIss, joined, 0);
+	EXPECT_EQ(first.size(), offset);
+	EXPECT_EQ(second.size(), appendLzwMember(secondIss, joined, offset));
+	EXPECT_EQ(textStr + randomStr, decompress(joined.str()));
+
+	// checkpoint of last member is moved, so joined stream can be appended to
+	std::istringstream joinedIss(joined.str());
+	auto checkpoint = LzwCheckpoint::read(joinedIss);
+	EXPECT_EQ(offset + second.size() - LzwCheckpoint::SIZE, checkpoint.offset);
+	auto lastBlock = checkpoint.readLastBlock(joinedIss);
+
+	std::ostringstream appended;
+	appended << joined.str().substr(0, static_cast<size_t>(checkpoint.resumeOffset()));
+	LzwBlockWriter appender(&appended, checkpoint);
+	appender.write(lastBlock.data(), lastBlock.size());
+	appender.write(textStr.data(), textStr.size());
+	appender.close();
+	EXPECT_EQ(textStr + randomStr + textStr, decompress(appended.str()));
+
+	// legacy stream and garbage after member are refused
+	std::istringstream legacy(std::string("LZW\x00", 4) + "abc");
+	EXPECT_THROW(appendLzwMember(legacy, joined, 0), std::runtime_error);
+	EXPECT_THROW(decompress(first + "garbage"), std::runtime_error);
+}
+
+TEST_F(TestLzwBlock, Runs) {
+	// zero pages between text, run crossing block boundary and runs too short to be found
+	std::string input = textStr.substr(0, 5000) + std::string(4096, '\0') + textStr.substr(0, 3000)
+		+ std::string(70000, '\xFF') + randomStr.substr(0, 1000) + std::string(100, 'z') + textStr.substr(0, 7000);
+	const size_t blockSize = 30000;
+
+	for (auto method : { LZW_METHOD_VARIABLE, LZW_METHOD_HUFFMAN, LZW_METHOD_AUTO }) {
+		auto compressed = compress(input, method, blockSize);
+		EXPECT_LT(compressed.size(), 4000u) << "method " << method;
+		EXPECT_EQ(input, decompress(compressed)) << "method " << method;
+	}
+
+	// block of one run costs only its entry
+	std::string zeros(LzwBlockWriter::DEFAULT_BLOCK_SIZE, '\0');
+	EXPECT_LT(compress(zeros, LZW_METHOD_VARIABLE, zeros.size()).size(), 32u);
+
+	// last runs block is reopened when stream is appended to
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE, blockSize);
+	writer.setCheckpoint(true);
+	writer.write(zeros.data(), 1000);
+	writer.close();
+	std::istringstream iss(oss.str());
+	auto checkpoint = LzwCheckpoint::read(iss);
+	EXPECT_EQ(std::string(1000, '\0'), checkpoint.readLastBlock(iss));
+}
+
+TEST_F(TestLzwBlock, Levels) {
+	auto data = textStr + randomStr.substr(0, 20000) + textStr;
+	for (int level = LzwLevel::MIN; level <= LzwLevel::MAX; ++level) {
+		std::ostringstream oss;
+		LzwBlockWriter writer(&oss, lzwLevel(level));
+		writer.setCheckpoint(true);
+		writer.write(data.data(), data.size());
+		writer.close();
+
+		auto compressed = oss.str();
+		ASSERT_GT(compressed.size(), 5u);
+		EXPECT_EQ(LZW_VERSION_LEVEL, static_cast<uint8_t>(compressed[3]));
+		EXPECT_EQ(level, compressed[4]);
+		EXPECT_LT(compressed.size(), data.size()) << "level " << level;
+		EXPECT_EQ(data, decompress(compressed)) << "level " << level;
+
+		// checkpoint offsets include level byte
+		std::istringstream iss(compressed);
+		auto checkpoint = LzwCheckpoint::read(iss);
+		EXPECT_EQ(data.substr(data.size() - checkpoint.readLastBlock(iss).size()),
+			checkpoint.readLastBlock(iss));
+	}
+
+	// incompressible start doesn't make block stored from level 6, repeats are deduplicated from level 7
+	auto mixed = randomStr + textStr + randomStr.substr(0, 50000);
+	std::vector<size_t> sizes;
+	for (int level = LzwLevel::MIN; level <= LzwLevel::MAX; ++level) {
+		std::ostringstream oss;
+		LzwBlockWriter writer(&oss, lzwLevel(level));
+		writer.write(mixed.data(), mixed.size());
+		writer.close();
+		sizes.push_back(oss.str().size());
+		EXPECT_EQ(mixed, decompress(oss.str())) << "level " << level;
+	}
+	EXPECT_LT(sizes[5], sizes[4]);
+	EXPECT_LT(sizes[6], sizes[5]);
+	EXPECT_LE(sizes[7], sizes[6]);
+	EXPECT_LE(sizes[8], sizes[7]);
+
+	EXPECT_THROW(lzwLevel(0), std::runtime_error);
+	EXPECT_THROW(lzwLevel(10), std::runtime_error);
+
+	auto compressed = compress(data, LZW_METHOD_VARIABLE, 50000);
+	compressed.insert(3, 1, static_cast<char>(LZW_VERSION_LEVEL));
+	compressed[4] = 0;
+	EXPECT_THROW(decompress(compressed), std::runtime_error);
+}
+
+TEST_F(TestLzwBlock, ResetWidth) {
+	auto data = textStr + randomStr.substr(0, 5000) + textStr;
+	auto frozen = compress(data, LZW_METHOD_BITTREE, data.size());
+
+	// dictionary of 10 bit codes is reset many times within block
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_BITTREE, data.size(), 1 << 20);
+	writer.setResetWidth(10);
+	writer.write(data.data(), data.size());
+	writer.close();
+	EXPECT_NE(frozen, oss.str());
+
+	// reset is in stream, so decoder with the same memory limit needs no setting
+	std::istringstream iss(oss.str());
+	std::ostringstream result;
+	decompressLzwStream(iss, result, 1 << 20);
+	EXPECT_EQ(data, result.str());
+}
+
+TEST_F(TestLzwBlock, Holes) {
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_HUFFMAN, 50000);
+	writer.write(textStr.data(), textStr.size());
+	writer.writeHole(300000);
+	writer.writeHole(0);
+	writer.write(randomStr.data(), 1000);
+	writer.flush();
+	// hole ends run of sync blocks
+	writer.writeHole(70000);
+	writer.write(textStr.data(), 100);
+	writer.writeHole(5);
+	writer.close();
+
+	auto expected = textStr + std::string(300000, '\0') + randomStr.substr(0, 1000)
+		+ std::string(70000, '\0') + textStr.substr(0, 100) + std::string(5, '\0');
+	EXPECT_EQ(expected, decompress(oss.str()));
+	EXPECT_LT(oss.str().size(), compress(textStr, LZW_METHOD_HUFFMAN, 50000).size() + 2000);
+}
+
+TEST_F(TestLzwBlock, WriteError) {
+	// buffer without storage fails every write, like full disk
+	struct FailingBuf : std::streambuf { } failing;
+	std::ostream out(&failing);
+
+	// buffered data before hole, writer destroyed while error unwinds
+	EXPECT_THROW({
+		LzwBlockWriter writer(&out, LZW_METHOD_VARIABLE, 50000);
+		writer.write(textStr.data(), 1000);
+		writer.writeHole(1 << 20);
+	}, std::runtime_error);
+
+	{
+		LzwBlockWriter writer(&out, LZW_METHOD_HUFFMAN, 50000);
+		EXPECT_THROW(writer.write(textStr.data(), textStr.size()), std::runtime_error);
+		// failed block isn't written again
+		writer.write(textStr.data(), 10);
+		EXPECT_THROW(writer.close(), std::runtime_error);
+		EXPECT_NO_THROW(writer.close());
+	}
+}
+
+TEST_F(TestLzwBlock, DecodedSize) {
+	std::ostringstream oss;
+	{
+		LzwBlockWriter writer(&oss, LZW_METHOD_HUFFMAN, 30000);
+		writer.setCheckpoint(true);
+		writer.setDedupWindow(1 << 20);
+		writer.write(textStr.data(), textStr.size());
+		writer.write(std::string(100000, 'x').data(), 100000);
+		writer.writeHole(1ULL << 33);
+		writer.write(textStr.data(), textStr.size());
+	}
+	auto first = oss.str();
+	auto second = compress(randomStr, LZW_METHOD_VARIABLE, 30000);
+
+	std::istringstream iss(first + second);
+	EXPECT_EQ(2 * textStr.size() + 100000 + (1ULL << 33) + randomStr.size(), lzwDecodedSize(iss));
+
+	std::istringstream legacy(std::string("LZW\x00", 4) + "abc");
+	EXPECT_THROW(lzwDecodedSize(legacy), std::runtime_error);
+	std::istringstream truncated(second.substr(0, second.size() / 2));
+	EXPECT_THROW(lzwDecodedSize(truncated), std::runtime_error);
+}
+
+TEST_F(TestLzwBlock, HoleFile) {
+	// file of its own, so test can run in parallel with others
+	TempDir dir;
+	const std::string path = dir.path("hole.tmp");
+	const uint64_t largeHole = 8 << 20, smallHole = 64 << 10;
+
+	// hole larger than 32bit sizes takes only its block, it isn't decoded here
+	{
+		std::ostringstream oss;
+		{
+			LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE);
+			writer.write("start", 5);
+			writer.writeHole(5ULL << 30);
+			writer.write("end", 3);
+		}
+		std::istringstream iss(oss.str());
+		EXPECT_EQ(5 + (5ULL << 30) + 3, lzwDecodedSize(iss));
+	}
+
+	std::ostringstream oss;
+	{
+		LzwBlockWriter writer(&oss, LZW_METHOD_VARIABLE);
+		writer.write("start", 5);
+		writer.writeHole(largeHole);
+		writer.write(textStr.data(), textStr.size());
+		writer.writeHole(smallHole);
+		writer.write("end", 3);
+	}
+	const uint64_t expectedSize = 5 + largeHole + textStr.size() + smallHole + 3;
+
+	{
+		std::istringstream iss(oss.str());
+		std::ofstream out(path.c_str(), std::ios_base::binary);
+		decompressLzwStream(iss, out);
+	}
+
+	std::ifstream in(path.c_str(), std::ios_base::binary | std::ios_base::ate);
+	EXPECT_EQ(expectedSize, static_cast<uint64_t>(in.tellg()));
+	char tail[4] = {0};
+	in.seekg(-4, std::ios_base::end);
+	in.read(tail, 4);
+	EXPECT_EQ(std::string("\0end", 4), std::string(tail, 4));
+	in.close();
+
+	// data ranges are in order and cover both ends
+	uint64_t size;
+	auto extents = findDataExtents(path, size);
+	EXPECT_EQ(expectedSize, size);
+	ASSERT_FALSE(extents.empty());
+	EXPECT_EQ(0u, extents.front().offset);
+	EXPECT_EQ(size, extents.back().offset + extents.back().length);
+	for (size_t i = 1; i < extents.size(); ++i)
+		EXPECT_LE(extents[i - 1].offset + extents[i - 1].length, extents[i].offset);
+	if (extents.size() < 3)
+		GTEST_SKIP() << "file system doesn't have holes";
+
+	// small hole is joined with data around it
+	auto joined = findDataExtents(path, size, 1 << 20);
+	ASSERT_EQ(2u, joined.size());
+	EXPECT_EQ(0u, joined[0].offset);
+	EXPECT_GE(joined[1].offset, 5 + largeHole - (1 << 20));
+	EXPECT_EQ(size, joined[1].offset + joined[1].length);
+}
@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+
+#include "lzwdaemon.h"
+#include "tempdir.h"
+
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+class TestLzwDaemon : public ::testing::Test
+{
+protected:
+	void SetUp() {
+		// socket of its own, so test can run in parallel with others
+		socketPath = dir.path("daemon.sock");
+		daemon.reset(new LzwDaemon(socketPath, 4, LZW_METHOD_HUFFMAN));
+		server = std::thread([this] () { daemon->run(); });
+	}
+
+	void TearDown() {
+		// daemon is missing when SetUp failed
+		if (daemon)
+			daemon->stop();
+		if (server.joinable())
+			server.join();
+		daemon.reset();
+	}
+
+	static std::string text(size_t size, unsigned seed = 1) {
+		std::mt19937 random(seed);
+		std::string str;
+		while (str.size() < size)
+			str += "line " + std::to_string(random() % 200) + " of daemon test\n";
+		return str;
+	}
+
+	/// Connects to daemon without client, so test can send partial messages
+	int connectRaw() {
+		sockaddr_un address;
+		std::memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		std::strcpy(address.sun_path, socketPath.c_str());
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		EXPECT_EQ(0, connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+		return fd;
+	}
+
+	static std::string decompress(const std::string& str) {
+		std::istringstream iss(str);
+		std::ostringstream result;
+		decompressLzwStream(iss, result);
+		return result.str();
+	}
+
+	TempDir dir;
+	std::string socketPath;
+	std::unique_ptr<LzwDaemon> daemon;
+	std::thread server;
+};
+
+TEST_F(TestLzwDaemon, RoundTrip) {
+	LzwDaemonClient client(socketPath);
+	// empty, inline and memory file payloads, the large one has more blocks
+	for (size_t size : {size_t(0), size_t(1000), size_t(LzwDaemon::INLINE_LIMIT + 1), size_t(3 << 20)}) {
+		auto data = text(size).substr(0, size);
+		auto compressed = client.compress(data.data(), data.size());
+		EXPECT_EQ(data, decompress(compressed)) << size;
+		if (size > 1000) {
+			EXPECT_LT(compressed.size(), data.size() / 2);
+		}
+		EXPECT_EQ(data, client.decompress(compressed.data(), compressed.size())) << size;
+	}
+}
+
+TEST_F(TestLzwDaemon, StreamsOfOtherWriters) {
+	auto data = text(1 << 20);
+	std::ostringstream oss;
+	{
+		LzwBlockWriter writer(&oss, lzwLevel(9));
+		writer.write(data.data(), data.size());
+		writer.writeHole(1 << 20);
+	}
+	auto member = oss.str();
+	auto joined = member + member;
+
+	LzwDaemonClient client(socketPath);
+	auto expected = data + std::string(1 << 20, '\0');
+	EXPECT_EQ(expected + expected, client.decompress(joined.data(), joined.size()));
+}
+
+TEST_F(TestLzwDaemon, ConcurrentClients) {
+	const size_t clients = 8, requests = 20;
+	std::vector<std::thread> threads;
+	std::vector<int> failures(clients);
+	for (size_t i = 0; i < clients; ++i) {
+		threads.push_back(std::thread([this, i, &failures] () {
+			std::mt19937 random(static_cast<unsigned>(i));
+			LzwDaemonClient client(socketPath);
+			for (size_t j = 0; j < requests; ++j) {
+				auto data = text(100 + random() % 20000, static_cast<unsigned>(random()));
+				auto compressed = client.compress(data.data(), data.size());
+				if (client.decompress(compressed.data(), compressed.size()) != data)
+					failures[i]++;
+			}
+		}));
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto failed : failures)
+		EXPECT_EQ(0, failed);
+	daemon->stop();
+	server.join();
+	EXPECT_EQ(2 * clients * requests, daemon->requestCount());
+	// requests of clients waiting together are served by one batch
+	EXPECT_GT(daemon->maxBatchSize(), 1u);
+}
+
+TEST_F(TestLzwDaemon, SlowClient) {
+	// client stalled in middle of header doesn't hold requests of others
+	int slow = connectRaw();
+	ASSERT_EQ(1, write(slow, "C", 1));
+	auto start = std::chrono::steady_clock::now();
+	LzwDaemonClient client(socketPath);
+	auto data = text(1000);
+	auto compressed = client.compress(data.data(), data.size());
+	EXPECT_EQ(data, client.decompress(compressed.data(), compressed.size()));
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+
+	// rest of message completes request
+	char rest[9] = { 0, 3, 0, 0, 0, 0, 0, 0, 0 };
+	ASSERT_EQ(9, write(slow, rest, sizeof(rest)));
+	ASSERT_EQ(3, write(slow, "abc", 3));
+	char header[10];
+	EXPECT_EQ(10, recv(slow, header, sizeof(header), MSG_WAITALL));
+	EXPECT_EQ('O', header[0]);
+	close(slow);
+}
+
+TEST_F(TestLzwDaemon, InlineSizeLimit) {
+#if !defined(SYS_memfd_create) || !defined(F_SEAL_SHRINK)
+	GTEST_SKIP() << "large payloads are inline without memory files";
+#endif
+	// large payload has to come in memory file, so size in header doesn't make daemon allocate it
+	int fd = connectRaw();
+	char header[10] = { 'C', 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	uint64_t size = LzwDaemon::MAX_PAYLOAD;
+	for (size_t i = 0; i < 8; ++i)
+		header[2 + i] = static_cast<char>(size >> (8 * i));
+	ASSERT_EQ(10, write(fd, header, sizeof(header)));
+	char reply;
+	// connection is closed instead of reply
+	EXPECT_EQ(0, recv(fd, &reply, 1, 0));
+	close(fd);
+}
+
+TEST_F(TestLzwDaemon, Errors) {
+	LzwDaemonClient client(socketPath);
+	auto garbage = text(1000);
+	EXPECT_THROW(client.decompress(garbage.data(), garbage.size()), std::runtime_error);
+
+	auto compressed = client.compress(garbage.data(), garbage.size());
+	auto truncated = compressed.substr(0, compressed.size() - 10);
+	EXPECT_THROW(client.decompress(truncated.data(), truncated.size()), std::runtime_error);
+
+	// failed request leaves connection usable
+	EXPECT_EQ(garbage, client.decompress(compressed.data(), compressed.size()));
+
+	EXPECT_THROW(LzwDaemon other(socketPath), std::runtime_error);
+	EXPECT_THROW(LzwDaemonClient("lzwdaemon_test_missing.sock"), std::runtime_error);
+}
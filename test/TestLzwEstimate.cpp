@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include "lzwestimate.h"
+
+#include <sstream>
+#include <cstdlib>
+
+class TestLzwEstimate : public ::testing::Test
+{
+protected:
+	void SetUp() {
+		textStr.clear();
+		for (int i = 0; i < 4000; ++i)
+			textStr += "Lorem ipsum dolor sit amet, consectetur adipisici elit. " + std::to_string(i % 97);
+
+		randomStr.clear();
+		for (int i = 0; i < 100000; ++i)
+			randomStr += static_cast<char>(rand() % 256);
+	}
+
+	std::string textStr;
+	std::string randomStr;
+};
+
+TEST_F(TestLzwEstimate, CountingStreamBuf) {
+	CountingStreamBuf counter;
+	std::ostream out(&counter);
+	for (int i = 0; i < 10000; ++i)
+		out.put('x');
+	out.write(randomStr.data(), randomStr.size());
+	EXPECT_EQ(10000u + randomStr.size(), counter.count());
+}
+
+TEST_F(TestLzwEstimate, Estimates) {
+	auto estimates = estimateLzwMethods(textStr.data(), textStr.size(), MemoryBudget::UNLIMITED, 4, 1 << 14);
+	ASSERT_EQ(sizeof(LZW_AUTO_METHODS) / sizeof(*LZW_AUTO_METHODS), estimates.size());
+	for (auto& estimate : estimates) {
+		EXPECT_EQ(4u << 14, estimate.sampleSize);
+		EXPECT_LT(estimate.ratio(), 0.5);
+	}
+
+	// large tolerance gives fastest method, no tolerance the smallest result
+	EXPECT_EQ(LZW_AUTO_METHODS[0], selectLzwMethod(estimates, 10.0));
+	auto smallest = selectLzwMethod(estimates, 0.0);
+	for (auto& estimate : estimates) {
+		if (estimate.method == smallest) {
+			for (auto& other : estimates)
+				EXPECT_LE(estimate.codedSize, other.codedSize);
+		}
+	}
+}
+
+namespace {
+
+/// Stream buffer of string which can't seek, like pipe
+class PipeStreamBuf : public std::streambuf
+{
+public:
+	explicit PipeStreamBuf(std::string& str) {
+		setg(&str[0], &str[0], &str[0] + str.size());
+	}
+};
+
+}
+
+TEST_F(TestLzwEstimate, Streams) {
+	auto data = textStr + randomStr + textStr;
+	auto expected = estimateLzwMethods(data.data(), data.size(), MemoryBudget::UNLIMITED, 4, 1 << 14);
+
+	// seekable stream reads the same windows
+	uint64_t size = 0;
+	std::istringstream iss(data);
+	auto estimates = estimateLzwMethods(iss, size, MemoryBudget::UNLIMITED, 4, 1 << 14);
+	EXPECT_EQ(data.size(), size);
+	ASSERT_EQ(expected.size(), estimates.size());
+	for (size_t i = 0; i < estimates.size(); ++i) {
+		EXPECT_EQ(expected[i].sampleSize, estimates[i].sampleSize);
+		EXPECT_EQ(expected[i].codedSize, estimates[i].codedSize);
+	}
+
+	// other stream keeps from 4 to 8 windows
+	PipeStreamBuf pipe(data);
+	std::istream in(&pipe);
+	estimates = estimateLzwMethods(in, size, MemoryBudget::UNLIMITED, 4, 1 << 14);
+	EXPECT_EQ(data.size(), size);
+	for (auto& estimate : estimates) {
+		EXPECT_GE(estimate.sampleSize, 4u << 14);
+		EXPECT_LE(estimate.sampleSize, 8u << 14);
+	}
+
+	// small input is coded whole either way
+	auto small = textStr.substr(0, 10000);
+	expected = estimateLzwMethods(small.data(), small.size(), MemoryBudget::UNLIMITED, 4, 1 << 14);
+	PipeStreamBuf smallPipe(small);
+	std::istream smallIn(&smallPipe);
+	estimates = estimateLzwMethods(smallIn, size, MemoryBudget::UNLIMITED, 4, 1 << 14);
+	EXPECT_EQ(small.size(), size);
+	for (size_t i = 0; i < estimates.size(); ++i)
+		EXPECT_EQ(expected[i].codedSize, estimates[i].codedSize);
+}
+
+TEST_F(TestLzwEstimate, IncompressibleSelectsFastest) {
+	auto estimates = estimateLzwMethods(randomStr.data(), randomStr.size());
+	EXPECT_EQ(LZW_AUTO_METHODS[0], selectLzwMethod(estimates, 0.0));
+}
+
+TEST_F(TestLzwEstimate, AutoBlockWriter) {
+	std::ostringstream oss;
+	LzwBlockWriter writer(&oss, LZW_METHOD_AUTO, 50000);
+	writer.setAutoTolerance(0.0);
+	writer.write(textStr.data(), textStr.size());
+	writer.write(randomStr.data(), randomStr.size());
+	writer.close();
+
+	std::istringstream iss(oss.str());
+	std::ostringstream decoded;
+	decompressLzwStream(iss, decoded);
+	EXPECT_EQ(textStr + randomStr, decoded.str());
+}
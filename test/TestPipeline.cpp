@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include "pipeline.h"
+
+#include <chrono>
+#include <ctime>
+#include <sstream>
+#include <thread>
+
+TEST(TestPipeline, SpscRing) {
+	SpscRing<int> ring(16);
+	const int count = 100000;
+
+	std::thread producer([&ring] () {
+		for (int i = 0; i < count; ++i) {
+			while (!ring.tryPush(i))
+				std::this_thread::yield();
+		}
+	});
+
+	for (int i = 0; i < count; ++i) {
+		int value;
+		while (!ring.tryPop(value))
+			std::this_thread::yield();
+		ASSERT_EQ(i, value);
+	}
+
+	producer.join();
+}
+
+TEST(TestPipeline, CopyThrough) {
+	std::string data;
+	for (int i = 0; i < 100000; ++i)
+		data += static_cast<char>('a' + i % 26);
+
+	std::istringstream in(data);
+	std::ostringstream out;
+	{
+		// small buffers so they have to be recycled many times
+		IoPipeline pipeline(in, out, 1000, 3);
+		std::string chunk(777, '\0');
+		while (pipeline.input().read(&chunk[0], chunk.size()) || pipeline.input().gcount() > 0)
+			pipeline.output().write(chunk.data(), pipeline.input().gcount());
+		pipeline.finish();
+	}
+
+	EXPECT_EQ(data, out.str());
+}
+
+TEST(TestPipeline, WaitingSleeps) {
+	BufferChannel channel(16, 2);
+	std::thread producer([&channel] () {
+		// consumer waits meanwhile, like for slow input
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		auto buffer = channel.acquire();
+		buffer->size = 1;
+		channel.submit(buffer);
+		channel.finish();
+	});
+
+	auto start = std::clock();
+	auto buffer = channel.receive();
+	auto cpu = static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+	ASSERT_NE(nullptr, buffer);
+	EXPECT_EQ(1u, buffer->size);
+	channel.release(buffer);
+	EXPECT_EQ(nullptr, channel.receive());
+	producer.join();
+	// process time of both threads, spinning consumer would take whole wait
+	EXPECT_LT(cpu, 0.1);
+
+	// abort wakes up sleeping consumer
+	BufferChannel aborted(16, 2);
+	std::thread aborter([&aborted] () {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		aborted.abort();
+	});
+	EXPECT_EQ(nullptr, aborted.receive());
+	aborter.join();
+}
+
+TEST(TestPipeline, ReadError) {
+	// input fails after some data, like disk read error
+	struct FailingBuf : std::streambuf {
+		FailingBuf() : calls(0) { }
+		int_type underflow() {
+			if (++calls > 3)
+				throw std::runtime_error("read error");
+			setg(data, data, data + sizeof(data));
+			return traits_type::to_int_type(data[0]);
+		}
+		char data[1000];
+		int calls;
+	} failing;
+	std::istream in(&failing);
+	std::ostringstream out;
+
+	IoPipeline pipeline(in, out, 1000, 3);
+	std::string chunk(777, '\0');
+	while (pipeline.input().read(&chunk[0], chunk.size()) || pipeline.input().gcount() > 0)
+		pipeline.output().write(chunk.data(), pipeline.input().gcount());
+	EXPECT_THROW(pipeline.finish(), std::runtime_error);
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "rangecoder.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <vector>
+
+TEST(TestRangeCoder, SkewedBits) {
+	std::vector<bool> bits;
+	for (int i = 0; i < 100000; ++i)
+		bits.push_back(rand() % 10 == 0);
+
+	std::ostringstream oss;
+	{
+		BinaryRangeEncoder encoder(&oss);
+		BitProbability prob;
+		for (auto bit : bits)
+			encoder.encode(prob, bit);
+	}
+	// adaptive probability gets close to entropy of 0.47 bits per bit
+	EXPECT_LT(oss.str().size(), bits.size() / 8 / 2);
+
+	std::istringstream iss(oss.str());
+	BinaryRangeDecoder decoder(&iss);
+	BitProbability prob;
+	for (size_t i = 0; i < bits.size(); ++i)
+		ASSERT_EQ(bits[i], decoder.decode(prob)) << "bit " << i;
+	EXPECT_FALSE(decoder.exhausted());
+}
+
+TEST(TestRangeCoder, BitTree) {
+	std::vector<uint32_t> values;
+	for (int i = 0; i < 10000; ++i)
+		values.push_back(rand() % 2 ? rand() % 256 : 42);
+
+	std::ostringstream oss;
+	{
+		BinaryRangeEncoder encoder(&oss);
+		std::vector<BitProbability> tree(256);
+		for (auto value : values)
+			encoder.encodeTree(tree.data(), 8, value);
+	}
+
+	std::istringstream iss(oss.str());
+	BinaryRangeDecoder decoder(&iss);
+	std::vector<BitProbability> tree(256);
+	for (auto value : values)
+		ASSERT_EQ(value, decoder.decodeTree(tree.data(), 8));
+	EXPECT_FALSE(decoder.exhausted());
+
+	// truncated stream is detected
+	std::istringstream truncated(oss.str().substr(0, oss.str().size() / 2));
+	BinaryRangeDecoder truncatedDecoder(&truncated);
+	std::vector<BitProbability> truncatedTree(256);
+	for (size_t i = 0; i < values.size(); ++i)
+		truncatedDecoder.decodeTree(truncatedTree.data(), 8);
+	EXPECT_TRUE(truncatedDecoder.exhausted());
+}
+
+TEST(TestRangeCoder, WriteError) {
+	// buffer without storage fails every write, like full disk
+	struct FailingBuf : std::streambuf { } failing;
+	std::ostream out(&failing);
+
+	// encoder destroyed while error unwinds doesn't throw again
+	EXPECT_THROW({
+		BinaryRangeEncoder encoder(&out);
+		BitProbability prob;
+		for (int i = 0; i < 1 << 20; ++i)
+			encoder.encode(prob, rand() % 2 == 0);
+		encoder.close();
+	}, std::runtime_error);
+}
@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+
+#include "threadpool.h"
+
+#include <atomic>
+#include <stdexcept>
+
+TEST(TestThreadPool, NestedTasks) {
+	ThreadPool pool(4);
+	std::atomic<int> counter(0);
+
+	// tasks spawning subtasks, like archive files spawning parts
+	for (int i = 0; i < 50; ++i) {
+		pool.submit([&pool, &counter] () {
+			for (int j = 0; j < 20; ++j)
+				pool.submit([&counter] () { counter++; });
+		});
+	}
+	pool.wait();
+
+	EXPECT_EQ(50 * 20, counter.load());
+}
+
+TEST(TestThreadPool, Exception) {
+	ThreadPool pool(2);
+	pool.submit([] () { throw std::runtime_error("task failed"); });
+	EXPECT_THROW(pool.wait(), std::runtime_error);
+
+	// pool is usable after failure
+	std::atomic<int> counter(0);
+	pool.submit([&counter] () { counter++; });
+	pool.wait();
+	EXPECT_EQ(1, counter.load());
+}
@@ -0,0 +1,126 @@
+/**
+ * @file tempdir.h
+ *
+ * @author Jan Dusek <xdusek17@stud.fit.vutbr.cz>
+ * @date 2013
+ */
+
+#ifndef TEMP_DIR_H
+#define TEMP_DIR_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif // _WIN32
+
+/**
+ * Unique temporary directory of test, so tests running in parallel don't share files.
+ * Directory is removed with its content by destructor.
+ */
+class TempDir
+{
+public:
+	/// @throws std::runtime_error when directory can't be created
+	TempDir() {
+#ifdef _WIN32
+		char base[MAX_PATH + 1];
+		if (GetTempPathA(sizeof(base), base) == 0)
+			throw std::runtime_error("TempDir: unable to get temporary path");
+		for (unsigned i = 0; ; ++i) {
+			dir = std::string(base) + "lzwtest_" + std::to_string(_getpid()) + "_" + std::to_string(i);
+			if (_mkdir(dir.c_str()) == 0)
+				break;
+			if (errno != EEXIST)
+				throw std::runtime_error("TempDir: unable to create " + dir);
+		}
+#else
+		const char* base = std::getenv("TMPDIR");
+		std::string pattern = std::string(base != nullptr && *base != '\0' ? base : "/tmp") + "/lzwtest_XXXXXX";
+		std::vector<char> name(pattern.begin(), pattern.end());
+		name.push_back('\0');
+		if (mkdtemp(name.data()) == nullptr)
+			throw std::runtime_error("TempDir: unable to create " + pattern);
+		dir = name.data();
+#endif // _WIN32
+	}
+
+	~TempDir() {
+		removeTree(dir);
+	}
+
+	/// Directory path
+	const std::string& path() const {
+		return dir;
+	}
+
+	/// Path of file in directory
+	std::string path(const std::string& name) const {
+		return dir + "/" + name;
+	}
+private:
+	TempDir(const TempDir&);
+	TempDir& operator=(const TempDir&);
+
+	static void removeTree(const std::string& path) {
+		struct stat st;
+#ifdef _WIN32
+		bool directory = stat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+#else
+		// links are removed, not followed
+		bool directory = lstat(path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+#endif // _WIN32
+		if (directory) {
+			for (auto& name : listDirectory(path))
+				removeTree(path + "/" + name);
+#ifdef _WIN32
+			_rmdir(path.c_str());
+#else
+			rmdir(path.c_str());
+#endif // _WIN32
+		} else
+			std::remove(path.c_str());
+	}
+
+	static std::vector<std::string> listDirectory(const std::string& path) {
+		std::vector<std::string> names;
+#ifdef _WIN32
+		WIN32_FIND_DATAA data;
+		HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+		if (handle == INVALID_HANDLE_VALUE)
+			return names;
+		do {
+			names.push_back(data.cFileName);
+		} while (FindNextFileA(handle, &data));
+		FindClose(handle);
+#else
+		DIR* d = opendir(path.c_str());
+		if (d == nullptr)
+			return names;
+		while (dirent* entry = readdir(d))
+			names.push_back(entry->d_name);
+		closedir(d);
+#endif // _WIN32
+		std::vector<std::string> result;
+		for (auto& name : names) {
+			if (name != "." && name != "..")
+				result.push_back(name);
+		}
+		return result;
+	}
+
+	std::string dir;
+};
+
+#endif // !TEMP_DIR_H